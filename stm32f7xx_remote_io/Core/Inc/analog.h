@@ -0,0 +1,201 @@
+#ifndef __ANALOG_H
+#define __ANALOG_H
+
+#include <stdint.h>
+#include "stm32f7xx_hal.h"
+
+/**
+ * @brief Scan of the analog inputs
+ * @note ADC1 converts all analog inputs of the pin map in one scan at every TRGO of
+ *       the trigger timer, and the DMA writes the scans to a pool of blocks. The DMA
+ *       runs in double buffer mode, and the idle memory register is pointed at a
+ *       free block whenever a block completes, so a completed block stays intact
+ *       until it is released, whatever the rate.
+ *       Every completed block is averaged and calibrated in the DMA interrupt, which
+ *       gives the latest value of every input. The ADC of the F7 has no hardware
+ *       oversampler, hence the averaging is done in software, a few hundred cycles
+ *       per block.
+ */
+#define ANALOG_SCAN_RATE 10000  // default scans per second, 78 values per second
+#define ANALOG_BLOCK_SCANS 128  // scans of a block, averaged into one value
+#define ANALOG_BLOCK_SIZE (ANALOG_BLOCK_SCANS * NUMBER_OF_ANALOG_INPUTS)
+#define ANALOG_BLOCKS 32        // blocks of the pool, two of them are written by the DMA
+
+#define ANALOG_MIN_SCAN_RATE 1000
+#define ANALOG_MAX_SCAN_RATE 100000
+
+// the ADC runs at PCLK2 / 4, and a conversion takes the sampling time plus 12 cycles
+#define ANALOG_ADC_CLOCK 24000000
+#define ANALOG_CONVERSION_CYCLES 12
+
+/**
+ * @brief Streaming of the raw scans
+ * @note While streaming, every completed block is queued to the sender task instead
+ *       of being reused right away, and sent through the data socket which listens
+ *       at the API port plus ANALOG_STREAM_PORT_OFFSET. If the client cannot keep up
+ *       and the pool runs out of free blocks, the completed block is overwritten and
+ *       counted as dropped, its sequence number is skipped.
+ */
+#define ANALOG_STREAM_PORT_OFFSET 3
+
+// magic number at the beginning of a block sent through the data socket, "ASTR"
+#define ANALOG_STREAM_MAGIC 0x52545341
+
+// transmit buffer of the data socket, several blocks
+#define ANALOG_STREAM_TX_BUFFER_SIZE 8192
+
+// period of the throughput and CPU measurement
+#define ANALOG_STREAM_STATS_PERIOD_MS 1000
+
+// time to wait for room in the data socket before trying again
+#define ANALOG_STREAM_RETRY_MS 1
+
+/**
+ * @brief Delta encoding of a block
+ * @note Each sample is sent as the signed 8-bit difference to the previous sample
+ *       of the same input, or as ANALOG_DELTA_ESCAPE followed by the 16-bit sample
+ *       if the difference does not fit. The previous samples are 0 at the start of
+ *       each block, so every block is decoded on its own.
+ */
+#define ANALOG_DELTA_ESCAPE 0x80
+#define ANALOG_DELTA_MAX_SIZE (3 * ANALOG_BLOCK_SIZE)
+
+/**
+ * @brief Triggered capture of the analog inputs
+ * @note While a capture is armed, every completed block is kept in a ring instead of
+ *       being reused, and the DMA continues with a free block or the oldest block of
+ *       the ring, so the scans before the trigger are still there when it fires.
+ *       A level is watched by the analog watchdog of the ADC and a digital edge by
+ *       the EXTI line of the input, both in hardware at every conversion. A slope is
+ *       evaluated once per block in the DMA interrupt. Once the post-trigger scans
+ *       are complete, the window is frozen until it has been sent through the data
+ *       socket of the stream, once. A window spans at most ANALOG_BLOCKS - 3 blocks,
+ *       which leaves the DMA its two blocks and a spare.
+ */
+#define ANALOG_CAPTURE_MAX_SCANS ((ANALOG_BLOCKS - 4) * ANALOG_BLOCK_SCANS)
+
+// limit of a level in microvolts or a slope in microvolts per millisecond
+#define ANALOG_MAX_LEVEL_UV 1000000000
+
+// magic number at the beginning of a capture sent through the data socket, "ACAP"
+#define ANALOG_CAPTURE_MAGIC 0x50414341
+
+// the IDs of the analog inputs start at 100, i.e. analog input 0 is pin 100
+#define ANALOG_INPUT_ID_OFFSET 100
+
+// full scale of the 12-bit ADC in microvolts, VREF+ is 3.3V on the NUCLEO-F767ZI
+#define ANALOG_FULL_SCALE_CODE 4095
+#define ANALOG_REFERENCE_UV 3300000
+
+/**
+ * @brief Calibration of an analog input, setting 124
+ * @note value_uv = raw_uv * gain / 65536 + offset_uv, where the gain is Q16.16.
+ */
+#define ANALOG_UNITY_GAIN 65536
+#define ANALOG_MAX_GAIN (4 * ANALOG_UNITY_GAIN)
+#define ANALOG_MAX_OFFSET_UV ANALOG_REFERENCE_UV
+
+/* user-defined type */
+typedef enum
+{
+    ANALOG_ENCODING_RAW = 0,   // 16-bit little-endian samples
+    ANALOG_ENCODING_DELTA = 1, // see ANALOG_DELTA_ESCAPE
+} analog_encoding_t;
+
+typedef enum
+{
+    ANALOG_CAPTURE_IDLE = 0,
+    ANALOG_CAPTURE_ARMED = 1,     // scanning, waiting for the trigger
+    ANALOG_CAPTURE_TRIGGERED = 2, // scanning the post-trigger scans
+    ANALOG_CAPTURE_DONE = 3,      // capture is ready to be sent
+} analog_capture_state_t;
+
+typedef enum
+{
+    ANALOG_TRIGGER_NONE = 0,            // trigger at the first scan
+    ANALOG_TRIGGER_RISING = 1,          // the analog input rises above the level
+    ANALOG_TRIGGER_FALLING = 2,         // the analog input falls below the level
+    ANALOG_TRIGGER_SLOPE = 3,           // the analog input changes by the slope from one scan to the next
+    ANALOG_TRIGGER_DIGITAL_RISING = 4,  // rising edge of a digital input
+    ANALOG_TRIGGER_DIGITAL_FALLING = 5, // falling edge of a digital input
+} analog_trigger_t;
+
+typedef struct
+{
+    uint32_t scan_rate;   // scans per second
+    uint32_t depth;       // total number of scans to capture
+    uint32_t pre_trigger; // number of scans before the trigger, included in depth
+    analog_trigger_t trigger;
+    uint8_t source;       // pin ID of the analog or digital input of the trigger
+    int32_t level_uv;     // level in microvolts, or slope in microvolts per millisecond
+} analog_capture_config_t;
+
+// a completed block queued to the sender task
+typedef struct
+{
+    uint32_t sequence;
+    uint8_t index; // index of the block in the pool, or ANALOG_BLOCK_CAPTURE_DONE
+} analog_block_t;
+
+// index of the item queued to wake the sender task once a capture is done
+#define ANALOG_BLOCK_CAPTURE_DONE UINT8_MAX
+
+typedef struct
+{
+    uint32_t scan_rate;          // achieved scans per second, 0 if not streaming
+    analog_encoding_t encoding;
+    uint32_t blocks;             // blocks completed since the start of the stream
+    uint32_t dropped;            // blocks dropped since the start of the stream
+    uint32_t bytes_per_second;   // throughput of the data socket
+    uint32_t cpu_permille;       // CPU time of the DMA interrupt and the sender task
+} analog_stream_stats_t;
+
+/**
+ * @brief Header sent before every block
+ * @note The samples follow in the order of the scans, the inputs of a scan are
+ *       adjacent, encoded as set by encoding.
+ */
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint32_t sequence;  // number of the block since the start of the stream
+    uint32_t dropped;   // blocks dropped since the start of the stream
+    uint32_t scan_rate; // scans per second
+    uint8_t inputs;     // analog inputs in a scan
+    uint8_t encoding;   // analog_encoding_t
+    uint16_t scans;     // scans in the block
+    uint16_t length;    // bytes of encoded samples which follow
+} analog_stream_header_t;
+
+/**
+ * @brief Header sent before the scans of a capture
+ * @note The raw samples follow like in a block of the stream, scans * inputs 16-bit
+ *       little-endian samples.
+ */
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint32_t scan_rate;
+    uint32_t scans;       // total number of scans in the capture
+    uint32_t pre_trigger; // index of the trigger scan
+    uint8_t inputs;       // analog inputs in a scan
+    uint8_t trigger;      // analog_trigger_t
+    uint16_t source;      // pin ID of the input of the trigger
+} analog_capture_header_t;
+
+/* Function Prototype */
+void analog_init(TIM_HandleTypeDef *_htim, DMA_HandleTypeDef *_hdma);
+void analog_start_task(void);
+int32_t analog_read(uint8_t input);
+HAL_StatusTypeDef analog_set_calibration(uint8_t input, int32_t gain, int32_t offset_uv);
+HAL_StatusTypeDef analog_stream_start(uint32_t scan_rate, analog_encoding_t encoding);
+void analog_stream_stop(void);
+void analog_stream_get_stats(analog_stream_stats_t *stats);
+HAL_StatusTypeDef analog_capture_start(analog_capture_config_t *config);
+void analog_capture_abort(void);
+analog_capture_state_t analog_capture_get_state(void);
+uint32_t analog_capture_get_length(void);
+void analog_irq_handler(void);
+void analog_exti_callback(uint16_t GPIO_Pin);
+
+#endif
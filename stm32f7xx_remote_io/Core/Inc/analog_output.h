@@ -0,0 +1,89 @@
+#ifndef __ANALOG_OUTPUT_H
+#define __ANALOG_OUTPUT_H
+
+#include <stdint.h>
+#include "stm32f7xx_hal.h"
+
+/**
+ * @brief Generator of the DAC outputs
+ * @note Each DAC channel converts at the TRGO of its own timer, TIM4 for output 100
+ *       and TIM5 for output 101, fed by its own DMA stream in circular mode, so the
+ *       output is updated at an exact rate without the CPU. A table is played
+ *       straight from RAM. A ramp or a shape is computed one half of a short buffer
+ *       ahead, in the half and full transfer interrupts of the DMA.
+ */
+#define ANALOG_OUTPUT_RAMP_RATE 1000    // updates per second of a ramp
+#define ANALOG_OUTPUT_RAMP_CHUNK 4      // samples computed per interrupt of a ramp, a setpoint applies within 8 ms
+#define ANALOG_OUTPUT_SHAPE_RATE 100000 // updates per second of a shape
+#define ANALOG_OUTPUT_SHAPE_CHUNK 64    // samples computed per interrupt of a shape
+#define ANALOG_OUTPUT_BUFFER_SIZE (2 * ANALOG_OUTPUT_SHAPE_CHUNK)
+
+// frequency of a shape in millihertz, up to a tenth of the update rate
+#define ANALOG_OUTPUT_MIN_FREQUENCY_MHZ 1
+#define ANALOG_OUTPUT_MAX_FREQUENCY_MHZ (ANALOG_OUTPUT_SHAPE_RATE * 100U)
+
+// samples of the table of each output, and the rates at which it is played
+#define ANALOG_OUTPUT_TABLE_SIZE 4096
+#define ANALOG_OUTPUT_MIN_TABLE_RATE 1
+#define ANALOG_OUTPUT_MAX_TABLE_RATE 1000000
+
+// the IDs of the analog outputs start at 100, i.e. analog output 0 is pin 100
+#define ANALOG_OUTPUT_ID_OFFSET 100
+
+/**
+ * @brief Slew rate of an analog output, setting 125
+ * @note In microvolts per millisecond, i.e. millivolts per second. 0 jumps to a new
+ *       setpoint at the next update, and so does any rate of a full scale per update.
+ */
+#define ANALOG_OUTPUT_MAX_SLEW_RATE (ANALOG_REFERENCE_UV * 1000U / ANALOG_OUTPUT_RAMP_RATE)
+
+/* user-defined type */
+typedef enum
+{
+    ANALOG_OUTPUT_LEVEL = 0,    // ramp to the setpoint of W08 at the slew rate
+    ANALOG_OUTPUT_SINE = 1,
+    ANALOG_OUTPUT_TRIANGLE = 2,
+    ANALOG_OUTPUT_SQUARE = 3,
+    ANALOG_OUTPUT_TABLE = 4,    // play the table in a loop
+} analog_output_mode_t;
+
+typedef struct
+{
+    analog_output_mode_t mode;
+    uint32_t frequency_mhz; // frequency of a shape in millihertz
+    int32_t amplitude_uv;   // peak amplitude of a shape in microvolts
+    int32_t offset_uv;      // center of a shape in microvolts
+    uint32_t rate;          // samples per second of the table
+    uint16_t length;        // samples of the table to play
+} analog_output_config_t;
+
+typedef struct
+{
+    TIM_HandleTypeDef *htim;
+    DMA_HandleTypeDef *hdma;
+    volatile uint32_t *dhr;    // 12-bit right aligned data holding register of the channel
+    volatile uint32_t *dor;    // data output register of the channel
+    uint32_t shift;            // position of the bits of the channel in DAC->CR
+    analog_output_config_t config;
+    uint16_t chunk;            // samples computed per interrupt
+    int32_t code;              // present output of a ramp, Q16.16 code
+    int32_t target;            // setpoint of a ramp, Q16.16 code
+    int32_t step;              // change of a ramp per update, Q16.16 code, 0 to jump
+    uint32_t phase;            // phase of a shape, a full turn is 2^32
+    uint32_t phase_step;       // phase increment per update
+    int32_t amplitude;         // peak amplitude of a shape in codes
+    int32_t offset;            // center of a shape in codes
+    uint16_t buffer[ANALOG_OUTPUT_BUFFER_SIZE];
+} analog_output_channel_t;
+
+/* Function Prototype */
+void analog_output_init(TIM_HandleTypeDef *htim_1, DMA_HandleTypeDef *hdma_1,
+                        TIM_HandleTypeDef *htim_2, DMA_HandleTypeDef *hdma_2);
+HAL_StatusTypeDef analog_output_write(uint8_t output, int32_t value_uv);
+int32_t analog_output_read(uint8_t output);
+HAL_StatusTypeDef analog_output_start(uint8_t output, analog_output_config_t *config);
+void analog_output_get_config(uint8_t output, analog_output_config_t *config);
+HAL_StatusTypeDef analog_output_write_table(uint8_t output, uint16_t index, uint16_t code);
+HAL_StatusTypeDef analog_output_set_slew_rate(uint8_t output, uint32_t slew_rate);
+
+#endif
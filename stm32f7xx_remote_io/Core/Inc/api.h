@@ -6,6 +6,66 @@
 #define API_RX_BUFFER_SIZE 128 // 1 ~ 254
 #define API_TX_BUFFER_SIZE 128 // 1 ~ 254
 
+// longest value of a reply with its leading space, formatted in place in the tx buffer
+#define API_VALUE_SIZE (UTILS_FORMAT_SIZE + 1)
+
+/* ID of services */
+#define API_ID_STATUS 1
+#define API_ID_INPUT 2
+#define API_ID_OUTPUT 3
+#define API_ID_SUBSCRIBE 4
+#define API_ID_SERIAL 5
+#define API_ID_WS28XX 6
+#define API_ID_ANALOG_INPUT 7
+#define API_ID_ANALOG_OUTPUT 8
+#define API_ID_LOGIC_CAPTURE 9
+#define API_ID_SEQUENCE 10
+#define API_ID_SEQUENCE_PLAYBACK 11
+#define API_ID_OUTPUT_MASKED 12
+#define API_ID_SERIAL_TRANSACTION 13
+#define API_ID_MODBUS_POLL 14
+#define API_ID_MODBUS_IMAGE 15
+#define API_ID_MODBUS_STATS 16
+#define API_ID_ANALOG_STREAM 17
+#define API_ID_ANALOG_CAPTURE 18
+#define API_ID_ANALOG_WAVEFORM 19
+#define API_ID_ANALOG_TABLE 20
+#define API_ID_BOOT_TIME 21
+#define API_ID_FIRMWARE 22
+
+/* ID of settings */
+#define API_ID_SETTINGS_BASE 100 // the IDs of settings start here, a change of any is saved to flash
+#define API_ID_IP_ADDRESS 101
+#define API_ID_TCP_PORT 102
+#define API_ID_NETMASK 103
+#define API_ID_GATEWAY 104
+#define API_ID_SERIAL_BAUD_RATE 105
+#define API_ID_SERIAL_DATA_BITS 106
+#define API_ID_SERIAL_PARITY 107
+#define API_ID_SERIAL_STOP_BITS 108
+#define API_ID_SERIAL_FLOW_CONTROL 109
+#define API_ID_WS28XX_LED_COUNT 110
+#define API_ID_DEBOUNCE_PERIOD 112
+#define API_ID_DEBOUNCE_TIME 113
+#define API_ID_SERIAL_HIGH_WATERMARK 114
+#define API_ID_SERIAL_LOW_WATERMARK 115
+#define API_ID_SERIAL_FRAME_MODE 116
+#define API_ID_SERIAL_FRAME_DELIMITER 117
+#define API_ID_SERIAL_FRAME_LENGTH 118
+#define API_ID_SERIAL_FRAME_TIMEOUT 119
+#define API_ID_SERIAL_TRANSACTION_TIMEOUT 120
+#define API_ID_MODBUS_BAUD_RATE 121
+#define API_ID_MODBUS_PARITY 122
+#define API_ID_MODBUS_TIMEOUT 123
+#define API_ID_ANALOG_CALIBRATION 124
+#define API_ID_ANALOG_SLEW_RATE 125
+
+/* Error code */
+#define API_ERROR_HARD_FAULT 1
+#define API_ERROR_FORMAT 2
+#define API_ERROR_UNSUPPORTED 3
+#define API_ERROR_TIMEOUT 4
+
 /* Macros */
 #define API_INCREMENT_BUFFER_HEAD(HEAD, TAIL, SIZE) \
     do { \
@@ -28,9 +88,37 @@
         return STATUS_FAIL; \
     } while (0)
 
+/* user-defined type */
+typedef struct
+{
+    char type;            // 'R' or 'W'
+    uint16_t id;          // ID of the function
+    char *line;           // the whole command line, null-terminated
+    uint8_t char_counter; // index of the next character to be parsed in line
+} api_command_t;
+
+typedef io_status_t (*api_handler_t)(api_command_t *command);
+
+typedef struct
+{
+    uint16_t id;
+    api_handler_t read;  // NULL if the function is not readable
+    api_handler_t write; // NULL if the function is not writable
+} api_function_t;
+
 /* Function prototypes */
 void api_init(Socket_t socket);
 void api_process_data(char *rx_data, BaseType_t len, Socket_t socket);
+io_status_t api_read_uint(api_command_t *command, uint32_t *value);
+io_status_t api_read_micro(api_command_t *command, int32_t *value);
+io_status_t api_read_milli(api_command_t *command, int32_t *value);
+io_status_t api_read_q16(api_command_t *command, int32_t *value);
+uint8_t api_read_uint_list(api_command_t *command, uint32_t *values, uint8_t size);
+bool api_has_argument(api_command_t *command);
+void api_reply_uint(uint32_t value);
+void api_reply_int(int32_t value);
+void api_reply_decimal(int32_t value, uint8_t decimals);
+void api_reply_text(const char *text);
 io_status_t api_append_data(uint8_t *data, BaseType_t len);
 io_status_t api_increment_rx_buffer_head();
 io_status_t api_increment_rx_buffer_tail();
@@ -41,4 +129,4 @@ io_status_t api_increment_tx_buffer_tail();
 io_status_t api_is_tx_buffer_empty();
 io_status_t api_is_tx_buffer_full();
 
-#endif
\ No newline at end of file
+#endif
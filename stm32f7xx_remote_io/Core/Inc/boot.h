@@ -0,0 +1,35 @@
+#ifndef __BOOT_H
+#define __BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Phases of the boot, each timestamped once in microseconds
+ * @note The time counts from the entry of main(), the reset handler before it is
+ *       not measured. LINK is when the network interface has come up with the PHY
+ *       link, LISTENING when the listener of the commands is ready, and ACCEPT
+ *       when its first client has connected. They are read by R21.
+ */
+#define BOOT_PHASE_RESET 0
+#define BOOT_PHASE_CLOCKS 1
+#define BOOT_PHASE_SETTINGS 2
+#define BOOT_PHASE_SCHEDULER 3
+#define BOOT_PHASE_LINK 4
+#define BOOT_PHASE_LISTENING 5
+#define BOOT_PHASE_ACCEPT 6
+#define BOOT_PHASES 7
+
+/**
+ * @brief Longest interval measured by the cycle counter
+ * @note The counter wraps after 44 s at 96 MHz, e.g. while the cable is
+ *       unplugged, so a longer interval is measured by the tick count instead.
+ */
+#define BOOT_CYCLE_INTERVAL_MS 30000
+
+/* Function prototypes */
+void boot_init(void);
+void boot_mark(uint8_t phase);
+bool boot_get_time(uint8_t phase, uint32_t *time_us);
+
+#endif
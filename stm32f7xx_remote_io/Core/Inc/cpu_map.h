@@ -1,6 +1,265 @@
 #ifndef __CPU_MAP_H
 #define __CPU_MAP_H
 
+#include <stdint.h>
+#include "stm32f7xx.h"
 
+/**
+ * @brief Pin map of the NUCLEO-F767ZI
+ * @note Every I/O is declared once in the X-macro lists below, as X(ctx, PORT, PIN)
+ *       where PORT is the letter of the GPIO port, e.g. X(ctx, E, 0) is PE0.
+ *       The lookup tables, port masks and EXTI configuration used by the firmware
+ *       are all generated from these lists, so porting to another board only
+ *       takes editing this section.
+ */
 
-#endif
\ No newline at end of file
+// Digital inputs, in the order of their IDs
+#define INPUT_PIN_MAP(X, ctx) \
+    X(ctx, E, 0)  /* input 00 */ \
+    X(ctx, E, 1)  /* input 01 */ \
+    X(ctx, E, 2)  /* input 02 */ \
+    X(ctx, E, 3)  /* input 03 */ \
+    X(ctx, E, 4)  /* input 04 */ \
+    X(ctx, E, 5)  /* input 05 */ \
+    X(ctx, E, 6)  /* input 06 */ \
+    X(ctx, E, 7)  /* input 07 */ \
+    X(ctx, F, 8)  /* input 08 */ \
+    X(ctx, F, 9)  /* input 09 */ \
+    X(ctx, F, 10) /* input 10 */ \
+    X(ctx, F, 11) /* input 11 */
+
+// Ports of the digital inputs, as X(ctx, INDEX, PORT), a logic capture samples one of them
+#define INPUT_PORT_MAP(X, ctx) \
+    X(ctx, 0, E) \
+    X(ctx, 1, F)
+
+// Digital outputs, in the order of their IDs
+#define OUTPUT_PIN_MAP(X, ctx) \
+    X(ctx, D, 0)  /* output 00 */ \
+    X(ctx, D, 1)  /* output 01 */ \
+    X(ctx, D, 2)  /* output 02 */ \
+    X(ctx, D, 3)  /* output 03 */ \
+    X(ctx, D, 4)  /* output 04 */ \
+    X(ctx, D, 5)  /* output 05 */ \
+    X(ctx, D, 6)  /* output 06 */ \
+    X(ctx, D, 7)  /* output 07 */ \
+    X(ctx, F, 12) /* output 08 */ \
+    X(ctx, F, 13) /* output 09 */ \
+    X(ctx, F, 14) /* output 10 */ \
+    X(ctx, F, 15) /* output 11 */
+
+// Ports of the digital outputs, as X(ctx, INDEX, PORT)
+#define OUTPUT_PORT_MAP(X, ctx) \
+    X(ctx, 0, D) \
+    X(ctx, 1, F)
+
+// Analog inputs, in the order of their IDs from 100, as X(ctx, PORT, PIN, CHANNEL)
+// where CHANNEL is the ADC123_INx input of the pin, they are scanned by ADC1
+#define ANALOG_INPUT_MAP(X, ctx) \
+    X(ctx, A, 3, 3)  /* analog input 100, A0 */ \
+    X(ctx, C, 0, 10) /* analog input 101, A1 */
+
+// Pins owned by peripherals, which must never be mapped as I/O
+#define RESERVED_PIN_MAP(X, ctx) \
+    X(ctx, A, 1)  /* RMII_REF_CLK */ \
+    X(ctx, A, 2)  /* RMII_MDIO */ \
+    X(ctx, A, 4)  /* DAC_OUT1, analog output 100 */ \
+    X(ctx, A, 5)  /* DAC_OUT2, analog output 101 */ \
+    X(ctx, A, 6)  /* PWM_WS28XX, TIM3_CH1 */ \
+    X(ctx, A, 7)  /* RMII_CRS_DV */ \
+    X(ctx, A, 8)  /* USB_SOF */ \
+    X(ctx, A, 9)  /* USB_VBUS */ \
+    X(ctx, A, 10) /* USB_ID */ \
+    X(ctx, A, 11) /* USB_DM */ \
+    X(ctx, A, 12) /* USB_DP */ \
+    X(ctx, A, 13) /* TMS */ \
+    X(ctx, A, 14) /* TCK */ \
+    X(ctx, B, 0)  /* LD1 */ \
+    X(ctx, B, 3)  /* SWO */ \
+    X(ctx, B, 7)  /* LD2 */ \
+    X(ctx, B, 13) /* RMII_TXD1 */ \
+    X(ctx, B, 14) /* LD3 */ \
+    X(ctx, C, 1)  /* RMII_MDC */ \
+    X(ctx, C, 4)  /* RMII_RXD0 */ \
+    X(ctx, C, 5)  /* RMII_RXD1 */ \
+    X(ctx, C, 13) /* USER_Btn */ \
+    X(ctx, D, 8)  /* STLK_RX */ \
+    X(ctx, D, 9)  /* STLK_TX */ \
+    X(ctx, D, 11) /* SERIAL_CTS, USART3_CTS */ \
+    X(ctx, D, 12) /* SERIAL_RTS, USART3_RTS */ \
+    X(ctx, E, 9)  /* SEQUENCE_TRIGGER, TIM1_CH1 */ \
+    X(ctx, G, 6)  /* USB_PowerSwitchOn */ \
+    X(ctx, G, 7)  /* USB_OverCurrent */ \
+    X(ctx, G, 8)  /* MODBUS_DE, USART6_DE */ \
+    X(ctx, G, 9)  /* MODBUS_RX, USART6_RX */ \
+    X(ctx, G, 11) /* RMII_TX_EN */ \
+    X(ctx, G, 13) /* RMII_TXD0 */ \
+    X(ctx, G, 14) /* MODBUS_TX, USART6_TX */ \
+    X(ctx, H, 0)  /* MCO, HSE bypass clock input */
+
+// hardware flow control of the serial bridge, USART3 on STLK_RX/STLK_TX
+#define SERIAL_CTS_Pin GPIO_PIN_11
+#define SERIAL_CTS_GPIO_Port GPIOD
+#define SERIAL_RTS_Pin GPIO_PIN_12
+#define SERIAL_RTS_GPIO_Port GPIOD
+
+// RS-485 port of the Modbus RTU master, USART6 with the driver enable output
+#define MODBUS_TX_Pin GPIO_PIN_14
+#define MODBUS_TX_GPIO_Port GPIOG
+#define MODBUS_RX_Pin GPIO_PIN_9
+#define MODBUS_RX_GPIO_Port GPIOG
+#define MODBUS_DE_Pin GPIO_PIN_8
+#define MODBUS_DE_GPIO_Port GPIOG
+
+// analog outputs of the DAC, in the order of their IDs from 100
+#define NUMBER_OF_ANALOG_OUTPUTS 2
+#define DAC_OUT1_Pin GPIO_PIN_4
+#define DAC_OUT1_GPIO_Port GPIOA
+#define DAC_OUT2_Pin GPIO_PIN_5
+#define DAC_OUT2_GPIO_Port GPIOA
+
+// external trigger of the output sequence, TIM1_CH1
+#define SEQUENCE_TRIGGER_Pin GPIO_PIN_9
+#define SEQUENCE_TRIGGER_GPIO_Port GPIOE
+
+/**
+ * @brief GPIO ports referred to by letter in the pin maps
+ */
+#define CPU_MAP_PORT_A 0
+#define CPU_MAP_PORT_B 1
+#define CPU_MAP_PORT_C 2
+#define CPU_MAP_PORT_D 3
+#define CPU_MAP_PORT_E 4
+#define CPU_MAP_PORT_F 5
+#define CPU_MAP_PORT_G 6
+#define CPU_MAP_PORT_H 7
+#define CPU_MAP_PORT_I 8
+#define CPU_MAP_PORT_J 9
+#define CPU_MAP_PORT_K 10
+
+// the GPIO ports are evenly spaced on AHB1
+#define CPU_MAP_GPIO(ID) ((GPIO_TypeDef *)(GPIOA_BASE + (ID) * (GPIOB_BASE - GPIOA_BASE)))
+
+/* user-defined type */
+typedef struct
+{
+    uint8_t port;  // index of the port in the port map
+    uint16_t mask; // GPIO_PIN_x of the pin
+} cpu_map_pin_t;
+
+/**
+ * @brief Generators over the pin maps
+ * @note They expand to constant expressions, so the tables below are placed in
+ *       flash and indexing them costs a single load.
+ */
+#define __CPU_MAP_COUNT(ctx, ...) +1
+#define __CPU_MAP_PIN_MASK(ID, PORT, PIN, ...) | ((CPU_MAP_PORT_##PORT == (ID)) ? (1U << (PIN)) : 0U)
+#define __CPU_MAP_PIN_SUM(ID, PORT, PIN, ...) + ((CPU_MAP_PORT_##PORT == (ID)) ? (1U << (PIN)) : 0U)
+#define __CPU_MAP_PORT_INDEX(ID, INDEX, PORT) + ((CPU_MAP_PORT_##PORT == (ID)) ? (INDEX) : 0)
+#define __CPU_MAP_PORT_MATCH(ID, INDEX, PORT) + (CPU_MAP_PORT_##PORT == (ID))
+#define __CPU_MAP_PORT_ID(INDEX, _INDEX, PORT) + (((_INDEX) == (INDEX)) ? CPU_MAP_PORT_##PORT : 0)
+#define __CPU_MAP_PIN_ENTRY(PORT_MAP, PORT, PIN) \
+    {.port = (0 PORT_MAP(__CPU_MAP_PORT_INDEX, CPU_MAP_PORT_##PORT)), .mask = (1U << (PIN))},
+#define __CPU_MAP_PORT_GPIO(ctx, INDEX, PORT) CPU_MAP_GPIO(CPU_MAP_PORT_##PORT),
+#define __CPU_MAP_PORT_MASK(PIN_MAP, INDEX, PORT) CPU_MAP_PORT_MASK(PIN_MAP, CPU_MAP_PORT_##PORT),
+#define __CPU_MAP_EXTI_LINE(ctx, PORT, PIN) | (1U << (PIN))
+#define __CPU_MAP_EXTI_SUM(ctx, PORT, PIN) + (1U << (PIN))
+#define __CPU_MAP_EXTICR(n, PORT, PIN) + (((PIN) / 4 == (n)) ? (CPU_MAP_PORT_##PORT << (4 * ((PIN) % 4))) : 0U)
+#define __CPU_MAP_UNDECLARED(PORT_MAP, PORT, PIN) + ((0 PORT_MAP(__CPU_MAP_PORT_MATCH, CPU_MAP_PORT_##PORT)) != 1)
+#define __CPU_MAP_INVALID_PIN(ctx, PORT, PIN, ...) + ((PIN) > 15)
+#define __CPU_MAP_ANALOG_CHANNEL(ctx, PORT, PIN, CHANNEL) CHANNEL,
+#define __CPU_MAP_INVALID_CHANNEL(ctx, PORT, PIN, CHANNEL) + ((CHANNEL) > 15)
+
+// pins of a pin map on the port with ID
+#define CPU_MAP_PORT_MASK(PIN_MAP, ID) ((uint16_t)(0U PIN_MAP(__CPU_MAP_PIN_MASK, ID)))
+#define __CPU_MAP_PORT_SUM(PIN_MAP, ID) (0U PIN_MAP(__CPU_MAP_PIN_SUM, ID))
+
+/**
+ * @brief Digital inputs
+ * @note INPUT_PIN_TABLE and INPUT_PORT_TABLE/INPUT_PORT_MASK_TABLE are initializers
+ *       of arrays of cpu_map_pin_t, GPIO_TypeDef * and uint16_t respectively.
+ */
+#define NUMBER_OF_INPUTS (0 INPUT_PIN_MAP(__CPU_MAP_COUNT, ))
+#define NUMBER_OF_INPUT_PORTS (0 INPUT_PORT_MAP(__CPU_MAP_COUNT, ))
+#define INPUT_PORT_ID(INDEX) (0 INPUT_PORT_MAP(__CPU_MAP_PORT_ID, INDEX))
+#define INPUT_PORT(INDEX) CPU_MAP_GPIO(INPUT_PORT_ID(INDEX))
+#define INPUT_PORT_MASK(INDEX) CPU_MAP_PORT_MASK(INPUT_PIN_MAP, INPUT_PORT_ID(INDEX))
+#define INPUT_PIN_TABLE {INPUT_PIN_MAP(__CPU_MAP_PIN_ENTRY, INPUT_PORT_MAP)}
+#define INPUT_PORT_TABLE {INPUT_PORT_MAP(__CPU_MAP_PORT_GPIO, )}
+#define INPUT_PORT_MASK_TABLE {INPUT_PORT_MAP(__CPU_MAP_PORT_MASK, INPUT_PIN_MAP)}
+
+/**
+ * @brief EXTI lines of the digital inputs
+ * @note INPUT_EXTICR(n) is the value of SYSCFG->EXTICR[n] which routes every
+ *       EXTI line used by an input to the port of that input.
+ */
+#define INPUT_EXTI_LINES (0U INPUT_PIN_MAP(__CPU_MAP_EXTI_LINE, ))
+#define INPUT_EXTICR(n) (0U INPUT_PIN_MAP(__CPU_MAP_EXTICR, n))
+
+/**
+ * @brief Digital outputs
+ * @note Same as the digital inputs.
+ */
+#define NUMBER_OF_OUTPUTS (0 OUTPUT_PIN_MAP(__CPU_MAP_COUNT, ))
+#define NUMBER_OF_OUTPUT_PORTS (0 OUTPUT_PORT_MAP(__CPU_MAP_COUNT, ))
+#define OUTPUT_PORT_ID(INDEX) (0 OUTPUT_PORT_MAP(__CPU_MAP_PORT_ID, INDEX))
+#define OUTPUT_PORT(INDEX) CPU_MAP_GPIO(OUTPUT_PORT_ID(INDEX))
+#define OUTPUT_PORT_MASK(INDEX) CPU_MAP_PORT_MASK(OUTPUT_PIN_MAP, OUTPUT_PORT_ID(INDEX))
+#define OUTPUT_PIN_TABLE {OUTPUT_PIN_MAP(__CPU_MAP_PIN_ENTRY, OUTPUT_PORT_MAP)}
+#define OUTPUT_PORT_TABLE {OUTPUT_PORT_MAP(__CPU_MAP_PORT_GPIO, )}
+#define OUTPUT_PORT_MASK_TABLE {OUTPUT_PORT_MAP(__CPU_MAP_PORT_MASK, OUTPUT_PIN_MAP)}
+
+/**
+ * @brief Analog inputs
+ * @note ANALOG_INPUT_CHANNEL_TABLE is an initializer of an array of uint8_t, the
+ *       ADC channel of every analog input. The pins are configured port by port
+ *       with CPU_MAP_PORT_MASK(ANALOG_INPUT_MAP, ID).
+ */
+#define NUMBER_OF_ANALOG_INPUTS (0 ANALOG_INPUT_MAP(__CPU_MAP_COUNT, ))
+#define ANALOG_INPUT_CHANNEL_TABLE {ANALOG_INPUT_MAP(__CPU_MAP_ANALOG_CHANNEL, )}
+
+/**
+ * @brief Compile-time checks of the pin maps
+ * @note A pin must be declared once, on a declared port, and must not be owned by
+ *       a peripheral. Two inputs cannot share an EXTI line, i.e. a pin number.
+ */
+_Static_assert((0 INPUT_PIN_MAP(__CPU_MAP_INVALID_PIN, )) == 0, "input pin number out of range");
+_Static_assert((0 OUTPUT_PIN_MAP(__CPU_MAP_INVALID_PIN, )) == 0, "output pin number out of range");
+_Static_assert((0 INPUT_PIN_MAP(__CPU_MAP_UNDECLARED, INPUT_PORT_MAP)) == 0, "input on a port missing in INPUT_PORT_MAP");
+_Static_assert((0 OUTPUT_PIN_MAP(__CPU_MAP_UNDECLARED, OUTPUT_PORT_MAP)) == 0, "output on a port missing in OUTPUT_PORT_MAP");
+_Static_assert((0 ANALOG_INPUT_MAP(__CPU_MAP_INVALID_PIN, )) == 0, "analog input pin number out of range");
+_Static_assert((0 ANALOG_INPUT_MAP(__CPU_MAP_INVALID_CHANNEL, )) == 0, "analog input on an ADC channel without a pin");
+_Static_assert(NUMBER_OF_ANALOG_INPUTS >= 1 && NUMBER_OF_ANALOG_INPUTS <= 16, "the ADC scans 1 ~ 16 channels");
+_Static_assert(NUMBER_OF_INPUTS <= 32 && NUMBER_OF_OUTPUTS <= 32, "I/O bitmaps are limited to 32 bits");
+_Static_assert(INPUT_EXTI_LINES == (0U INPUT_PIN_MAP(__CPU_MAP_EXTI_SUM, )), "inputs sharing an EXTI line");
+
+#define __CPU_MAP_CHECK_PORT(ID)                                                                                \
+    _Static_assert(CPU_MAP_PORT_MASK(INPUT_PIN_MAP, ID) == __CPU_MAP_PORT_SUM(INPUT_PIN_MAP, ID),              \
+                   "input declared twice on port " #ID);                                                       \
+    _Static_assert(CPU_MAP_PORT_MASK(OUTPUT_PIN_MAP, ID) == __CPU_MAP_PORT_SUM(OUTPUT_PIN_MAP, ID),            \
+                   "output declared twice on port " #ID);                                                      \
+    _Static_assert((CPU_MAP_PORT_MASK(INPUT_PIN_MAP, ID) & CPU_MAP_PORT_MASK(OUTPUT_PIN_MAP, ID)) == 0,        \
+                   "pin mapped as input and output on port " #ID);                                             \
+    _Static_assert(CPU_MAP_PORT_MASK(ANALOG_INPUT_MAP, ID) == __CPU_MAP_PORT_SUM(ANALOG_INPUT_MAP, ID),        \
+                   "analog input declared twice on port " #ID);                                                \
+    _Static_assert(((CPU_MAP_PORT_MASK(INPUT_PIN_MAP, ID) | CPU_MAP_PORT_MASK(OUTPUT_PIN_MAP, ID))             \
+                    & CPU_MAP_PORT_MASK(ANALOG_INPUT_MAP, ID)) == 0,                                           \
+                   "pin mapped as digital and analog I/O on port " #ID);                                       \
+    _Static_assert(((CPU_MAP_PORT_MASK(INPUT_PIN_MAP, ID) | CPU_MAP_PORT_MASK(OUTPUT_PIN_MAP, ID)              \
+                     | CPU_MAP_PORT_MASK(ANALOG_INPUT_MAP, ID))                                                \
+                    & CPU_MAP_PORT_MASK(RESERVED_PIN_MAP, ID)) == 0,                                           \
+                   "I/O mapped on a peripheral pin of port " #ID)
+
+__CPU_MAP_CHECK_PORT(CPU_MAP_PORT_A);
+__CPU_MAP_CHECK_PORT(CPU_MAP_PORT_B);
+__CPU_MAP_CHECK_PORT(CPU_MAP_PORT_C);
+__CPU_MAP_CHECK_PORT(CPU_MAP_PORT_D);
+__CPU_MAP_CHECK_PORT(CPU_MAP_PORT_E);
+__CPU_MAP_CHECK_PORT(CPU_MAP_PORT_F);
+__CPU_MAP_CHECK_PORT(CPU_MAP_PORT_G);
+__CPU_MAP_CHECK_PORT(CPU_MAP_PORT_H);
+__CPU_MAP_CHECK_PORT(CPU_MAP_PORT_I);
+__CPU_MAP_CHECK_PORT(CPU_MAP_PORT_J);
+__CPU_MAP_CHECK_PORT(CPU_MAP_PORT_K);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef __DEBOUNCE_H
+#define __DEBOUNCE_H
+
+#include <stdint.h>
+#include "stm32f7xx_hal.h"
+
+/**
+ * @brief Number of bits of the vertical counters
+ * @note Each input owns one bit in every counter plane, so a port of 16 pins
+ *       is counted by DEBOUNCE_COUNTER_BITS 16-bit words in parallel.
+ *       4 bits allow up to 15 consecutive samples before a change is accepted.
+ */
+#define DEBOUNCE_COUNTER_BITS 4
+#define DEBOUNCE_MAX_SAMPLES ((1 << DEBOUNCE_COUNTER_BITS) - 1)
+
+#define DEBOUNCE_DEFAULT_PERIOD_US 1000 // sampling period, 1kHz
+#define DEBOUNCE_DEFAULT_TIME_MS 5      // debounce time of each input
+#define DEBOUNCE_MIN_PERIOD_US 50
+#define DEBOUNCE_MAX_PERIOD_US 10000
+
+/* user-defined type */
+typedef struct
+{
+    GPIO_TypeDef *gpio;
+    uint16_t mask;                               // pins of the port mapped as inputs
+    uint16_t state;                              // debounced state
+    uint16_t changed;                            // pins toggled since the last debounce_take_changes()
+    uint16_t counter[DEBOUNCE_COUNTER_BITS];     // vertical counter, bit plane 0 is the LSB
+    uint16_t threshold[DEBOUNCE_COUNTER_BITS];   // per-pin number of samples, stored vertically
+} debounce_port_t;
+
+/* Function Prototype */
+void debounce_init(TIM_HandleTypeDef *_htim);
+HAL_StatusTypeDef debounce_set_period(uint16_t period_us);
+uint16_t debounce_get_period(void);
+HAL_StatusTypeDef debounce_set_time(uint8_t input, uint16_t time_ms);
+void debounce_sample(void);
+uint16_t debounce_get_port_state(uint8_t port);
+uint16_t debounce_take_changes(uint8_t port);
+int8_t debounce_read_input(uint8_t input);
+
+#endif
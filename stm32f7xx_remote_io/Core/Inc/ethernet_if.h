@@ -18,7 +18,7 @@ static uint8_t MACAddr[6] = {0x00, 0x80, 0xE1, 0x01, 0x02, 0x03};
  * failed.
  */
 // static uint8_t IPAddr[4] = {172, 16, 0, 10};
-static uint8_t NetMask[4] = {255, 240, 0, 0};
+// static uint8_t NetMask[4] = {255, 240, 0, 0};
 // static uint8_t GatewayAddr[4] = {172, 16, 0, 1};
 static uint8_t DNSAddr[4] = {8, 8, 8, 8};
 
@@ -28,7 +28,30 @@ static uint8_t DNSAddr[4] = {8, 8, 8, 8};
 /* Listening Port */
 #define LISTENING_PORT 8500
 
+/**
+ * @brief Longest time a listener waits for a client before it checks the port
+ * @note A change of the port, setting 102, takes effect at every listener within
+ *       this time, or once the client of the API listener disconnects.
+ */
+#define LISTENING_PORT_POLL_MS 500
+
+// longest time to wait for the client to acknowledge the reply before the address changes
+#define ADDRESS_CHANGE_TIMEOUT_MS 1000
+
+/**
+ * @brief Recovery of the default address and port by the USER button
+ * @note The button has to be pressed at reset and held for FACTORY_RESET_HOLD_MS.
+ *       It is watched by a task of its own, so the network comes up meanwhile at
+ *       the address in settings and moves to the default one once held long enough.
+ */
+#define FACTORY_RESET_HOLD_MS 5000
+#define FACTORY_RESET_POLL_MS 50
+
 BaseType_t tcp_server_init();
+void tcp_server_configure_port(void);
+void tcp_server_configure_address(void);
+Socket_t tcp_server_accept(Socket_t *pxListeningSocket, uint16_t usOffset, BaseType_t xSendBufferSize,
+                           BaseType_t xReceiveBufferSize);
 void vStartSimpleTCPServerTasks(uint16_t usStackSize, UBaseType_t uxPriority);
 
 #endif // __ETHERNET_IF_H__
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef __LOGIC_CAPTURE_H
+#define __LOGIC_CAPTURE_H
+
+#include <stdint.h>
+#include "stm32f7xx_hal.h"
+
+/**
+ * @brief Size of the capture buffer
+ * @note The capture buffer is a ring of segments. The DMA runs in double buffer mode,
+ *       and the address of the idle memory register is moved to the next segment
+ *       whenever a segment completes, so the DMA walks through the whole ring.
+ *       Each sample is the 16-bit input data register of the port at a timer update.
+ *       While a segment is written, the two segments before it stay intact. Hence,
+ *       the pre- and post-trigger samples together may span at most half of the ring,
+ *       which also leaves one full segment of time to stop the DMA after the capture.
+ */
+#define LOGIC_CAPTURE_SEGMENT_SIZE 16384 // samples, < 65536 for the 16-bit DMA counter
+#define LOGIC_CAPTURE_SEGMENTS 4
+#define LOGIC_CAPTURE_BUFFER_SIZE (LOGIC_CAPTURE_SEGMENT_SIZE * LOGIC_CAPTURE_SEGMENTS)
+#define LOGIC_CAPTURE_MAX_DEPTH (LOGIC_CAPTURE_BUFFER_SIZE / 2)
+
+#define LOGIC_CAPTURE_MAX_SAMPLE_RATE 4000000 // 4MHz
+#define LOGIC_CAPTURE_MIN_SAMPLE_RATE 1000    // 1kHz
+
+// the data socket listens at the API port plus this offset
+#define LOGIC_CAPTURE_PORT_OFFSET 1
+
+// magic number at the beginning of a capture sent through the data socket, "LCAP"
+#define LOGIC_CAPTURE_MAGIC 0x5041434C
+
+// size of the chunks of run-length encoded data handed to the socket
+#define LOGIC_CAPTURE_SEND_BUFFER_SIZE 512
+
+/* user-defined type */
+typedef enum
+{
+    LOGIC_CAPTURE_IDLE = 0,
+    LOGIC_CAPTURE_ARMED = 1,     // sampling, waiting for the trigger
+    LOGIC_CAPTURE_TRIGGERED = 2, // sampling the post-trigger samples
+    LOGIC_CAPTURE_DONE = 3,      // capture is ready to be sent
+    LOGIC_CAPTURE_SENDING = 4,   // capture is being sent, the buffer is in use
+} logic_capture_state_t;
+
+typedef enum
+{
+    LOGIC_CAPTURE_TRIGGER_NONE = 0,    // trigger at the first sample
+    LOGIC_CAPTURE_TRIGGER_PATTERN = 1, // trigger once (sample & mask) becomes equal to value
+    LOGIC_CAPTURE_TRIGGER_CHANGE = 2,  // trigger once any pin in mask changes
+} logic_capture_trigger_t;
+
+typedef struct
+{
+    uint8_t port;         // index of the input port to sample
+    uint32_t sample_rate; // samples per second
+    uint32_t depth;       // total number of samples to capture
+    uint32_t pre_trigger; // number of samples before the trigger, included in depth
+    logic_capture_trigger_t trigger;
+    uint16_t mask;
+    uint16_t value;
+} logic_capture_config_t;
+
+/**
+ * @brief Header sent before the run-length encoded samples
+ * @note The samples follow as pairs of 16-bit little-endian words, [VALUE] [COUNT],
+ *       which means VALUE was sampled COUNT times in a row.
+ */
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint32_t sample_rate;
+    uint32_t samples;     // total number of samples in the capture
+    uint32_t pre_trigger; // index of the trigger sample
+    uint16_t mask;        // pins of the port which are mapped as inputs
+    uint16_t records;     // number of [VALUE] [COUNT] pairs which follow
+} logic_capture_header_t;
+
+/* Function Prototype */
+void logic_capture_init(TIM_HandleTypeDef *_htim, DMA_HandleTypeDef *_hdma);
+void logic_capture_start_task(void);
+HAL_StatusTypeDef logic_capture_start(logic_capture_config_t *config);
+void logic_capture_abort(void);
+logic_capture_state_t logic_capture_get_state(void);
+uint32_t logic_capture_get_length(void);
+
+#endif
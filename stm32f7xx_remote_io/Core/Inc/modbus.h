@@ -0,0 +1,73 @@
+#ifndef __MODBUS_H
+#define __MODBUS_H
+
+#include <stdint.h>
+#include "stm32f7xx_hal.h"
+
+/**
+ * @brief Number of entries of the poll list
+ * @note Every entry reads a block of registers of a slave into the register image.
+ *       The engine polls the enabled entries one after another without pause, the
+ *       next request goes out as soon as the silent interval after a response has
+ *       passed, so the bus runs at its maximum rate.
+ */
+#define MODBUS_MAX_POLLS 16
+
+// registers of the image in RAM, read by the clients in bulk
+#define MODBUS_IMAGE_SIZE 1024
+
+// registers read by one request, limited by the protocol
+#define MODBUS_MAX_COUNT 125
+
+// registers of the image returned by one R15
+#define MODBUS_MAX_READ 128
+
+// largest RTU frame
+#define MODBUS_FRAME_SIZE 256
+
+// default line parameters and response timeout, settings 121 ~ 123
+#define MODBUS_DEFAULT_BAUD_RATE 19200
+#define MODBUS_DEFAULT_PARITY SERIAL_PARITY_EVEN
+#define MODBUS_DEFAULT_TIMEOUT_MS 100
+
+#define MODBUS_MIN_TIMEOUT_MS 1
+#define MODBUS_MAX_TIMEOUT_MS 10000
+
+// the silent interval between frames is fixed to 1750us above 19200 baud
+#define MODBUS_FIXED_T35_BAUD_RATE 19200
+#define MODBUS_FIXED_T35_US 1750
+
+// function codes
+#define MODBUS_READ_HOLDING_REGISTERS 3
+#define MODBUS_READ_INPUT_REGISTERS 4
+#define MODBUS_EXCEPTION (1 << 7)
+
+/* user-defined type */
+typedef struct
+{
+    uint8_t slave;     // 1 ~ 247, 0 if the entry is disabled
+    uint8_t function;  // MODBUS_READ_HOLDING_REGISTERS or MODBUS_READ_INPUT_REGISTERS
+    uint16_t address;  // first register of the slave
+    uint16_t count;    // 1 ~ MODBUS_MAX_COUNT
+    uint16_t offset;   // first register of the image written
+} modbus_poll_t;
+
+typedef struct
+{
+    uint32_t cycle_us;   // time between the last two polls of the slave
+    uint32_t polls;      // requests sent
+    uint32_t timeouts;   // requests without a response
+    uint32_t errors;     // responses with a bad CRC or an unexpected content
+    uint32_t exceptions; // exception responses
+} modbus_stats_t;
+
+/* Function Prototype */
+void modbus_init(USART_TypeDef *_uart, DMA_HandleTypeDef *_hdma_tx);
+HAL_StatusTypeDef modbus_configure(void);
+HAL_StatusTypeDef modbus_set_poll(uint8_t index, const modbus_poll_t *poll);
+HAL_StatusTypeDef modbus_get_poll(uint8_t index, modbus_poll_t *poll);
+HAL_StatusTypeDef modbus_read_image(uint16_t offset, uint16_t count, uint16_t *values);
+HAL_StatusTypeDef modbus_get_stats(uint8_t slave, modbus_stats_t *stats);
+void modbus_irq_handler(void);
+
+#endif
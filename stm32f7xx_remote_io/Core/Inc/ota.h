@@ -0,0 +1,142 @@
+#ifndef __OTA_H
+#define __OTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Slots of the images in dual bank mode
+ * @note An image runs from the bank it is linked for, STM32F767ZITX_FLASH.ld for
+ *       bank 1 and STM32F767ZITX_FLASH_BANK2.ld for bank 2, and takes the first
+ *       768 KB of it, sectors 0 ~ 9 or 12 ~ 21, the trailer at the very end. The
+ *       last two sectors of each bank hold the settings of the image in the other
+ *       bank, so neither the update nor the settings ever stall the running code.
+ */
+#define OTA_BANK_1_ADDRESS 0x08000000
+#define OTA_BANK_2_ADDRESS 0x08100000
+#define OTA_BANK_1_SECTOR FLASH_SECTOR_0
+#define OTA_BANK_2_SECTOR FLASH_SECTOR_12
+#define OTA_SLOT_SIZE (768 * 1024)
+#define OTA_SLOT_SECTORS 10
+#define OTA_IMAGE_MAX_SIZE (OTA_SLOT_SIZE - sizeof(ota_trailer_t))
+
+/**
+ * @brief Boot address option bytes of the banks, through the ITCM interface
+ * @note The boot address is the atomic switch between the banks. The swap of the
+ *       banks by SYSCFG only lasts until the next reset.
+ */
+#define OTA_BOOT_ADDRESS_1 OB_BOOTADDR_ITCM_FLASH // 0x00200000
+#define OTA_BOOT_ADDRESS_2 0x00C0                 // 0x00300000
+
+/**
+ * @brief Update socket
+ * @note Listens at the API port plus OTA_PORT_OFFSET. The client sends the header
+ *       and the payload, which is decoded and programmed into the other bank as it
+ *       arrives, while the next data is received into the window of the socket. The
+ *       device replies with a line of the result, and restarts from the new image if
+ *       it is "OK".
+ */
+#define OTA_PORT_OFFSET 4
+
+// magic number at the beginning of an update, "OTA1"
+#define OTA_MAGIC 0x3141544F
+
+// receive buffer of the update socket, the window is half of it
+#define OTA_RX_BUFFER_SIZE 8192
+
+// data programmed at a time
+#define OTA_CHUNK_SIZE 2048
+
+// payload taken from the socket at a time to be decoded
+#define OTA_INPUT_SIZE 512
+
+/**
+ * @brief Encodings of the payload
+ * @note A compressed or delta payload is a run of sequences, each a token byte, the
+ *       literals and a match. The high nibble of the token is the count of literals,
+ *       the low nibble the length of the match minus OTA_MIN_MATCH - 1, 0 for none.
+ *       A nibble of 15 is followed by a varint to add. The match is then a varint
+ *       reference, bit 0 clear for the distance back in the new image, or set for the
+ *       offset in the running image relative to the position, zigzag encoded, in a
+ *       delta only. The words of the running image pointing into its slot are read
+ *       relocated to the other slot, so the code that only moved with the bank still
+ *       matches. Tools/ota/ota_pack.c makes the payloads.
+ */
+#define OTA_ENCODING_RAW 0        // the image itself
+#define OTA_ENCODING_COMPRESSED 1 // matches in the new image only
+#define OTA_ENCODING_DELTA 2      // matches in the new image and the running image
+#define OTA_MIN_MATCH 4
+
+// the update is given up if the client sends nothing for this time
+#define OTA_RECEIVE_TIMEOUT_MS 5000
+
+// interval at which the update task checks an erase in progress
+#define OTA_ERASE_POLL_MS 10
+
+// results of an update, the reply is "OK" or "ERR" followed by one of these
+#define OTA_OK 0
+#define OTA_ERROR_BUSY 1         // the running image is still on trial
+#define OTA_ERROR_HEADER 2       // wrong magic or encoding, or the image does not fit the slot
+#define OTA_ERROR_BANK 3         // the image is not linked for the other bank
+#define OTA_ERROR_DATA 4         // the client stopped before the end of the image
+#define OTA_ERROR_FLASH 5        // erase or programming failed
+#define OTA_ERROR_CRC 6          // the image in flash does not match the CRC of the header
+#define OTA_ERROR_BOOT 7         // the boot address could not be changed
+#define OTA_ERROR_BASE 8         // the delta was not made against the running image
+#define OTA_ERROR_DECODE 9       // a match out of the images, or more data than the length
+#define OTA_ERROR_SINGLE_BANK 10 // the flash is in single bank mode, there is no other bank
+
+/**
+ * @brief Trial of a new image
+ * @note A new image boots on trial with the watchdog running, which is fed by the
+ *       idle task. It passes the health check once a client has connected to the API
+ *       port and it has run for OTA_HEALTH_CHECK_MS. If it is reset before, by the
+ *       watchdog, a fault or a power cycle, the next boot goes back to the image in
+ *       the other bank.
+ */
+#define OTA_HEALTH_CHECK_MS 10000
+
+// "IMG1" once the image in a slot is complete and verified
+#define OTA_TRAILER_MAGIC 0x31474D49
+
+// MPU regions mapping the other bank and the trailer of the running image non-cacheable
+#define OTA_MPU_REGION_BANK MPU_REGION_NUMBER1
+#define OTA_MPU_REGION_TRAILER MPU_REGION_NUMBER2
+
+// LSI of 32 kHz divided by 256, 8 s
+#define OTA_WATCHDOG_PRESCALER (IWDG_PR_PR_2 | IWDG_PR_PR_1)
+#define OTA_WATCHDOG_RELOAD 1000
+
+// header of an update, little-endian fields
+typedef struct
+{
+    uint32_t magic;       // OTA_MAGIC
+    uint32_t length;      // bytes of the image
+    uint32_t crc;         // CRC-32/MPEG-2 of the image
+    uint32_t encoding;    // OTA_ENCODING_x
+    uint32_t base_length; // bytes of the running image a delta is made against, else 0
+    uint32_t base_crc;    // CRC-32/MPEG-2 of them, as they are in flash
+} ota_header_t;
+
+// trailer in the last bytes of a slot, every word is programmed once
+typedef struct
+{
+    uint32_t magic;     // OTA_TRAILER_MAGIC, programmed last
+    uint32_t length;    // bytes of the image
+    uint32_t crc;       // CRC-32/MPEG-2 of the image
+    uint32_t trial;     // 0 from the first boot of the image
+    uint32_t confirmed; // 0 once the image has passed the health check
+    uint32_t reserved[3];
+} ota_trailer_t;
+
+/* Function prototypes */
+void ota_start_trial(void);
+void ota_init(void);
+void ota_start_task(void);
+uint8_t ota_get_bank(void);
+bool ota_is_trial(void);
+void ota_lock_flash(void);
+void ota_unlock_flash(void);
+void ota_refresh_watchdog(void);
+
+#endif
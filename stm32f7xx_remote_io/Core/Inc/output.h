@@ -0,0 +1,20 @@
+#ifndef __OUTPUT_H
+#define __OUTPUT_H
+
+#include <stdint.h>
+#include "stm32f7xx_hal.h"
+
+/**
+ * @brief Bitmap of all outputs, bit n is output n
+ */
+#define OUTPUT_ALL_MASK (NUMBER_OF_OUTPUTS >= 32 ? 0xFFFFFFFFU : (1U << NUMBER_OF_OUTPUTS) - 1U)
+
+/* Function Prototype */
+HAL_StatusTypeDef output_write(uint8_t output, uint8_t value);
+HAL_StatusTypeDef output_write_masked(uint32_t mask, uint32_t value);
+int8_t output_read(uint8_t output);
+uint32_t output_read_all(void);
+void output_map(uint32_t outputs, uint16_t pins[NUMBER_OF_OUTPUT_PORTS]);
+GPIO_TypeDef *output_get_port(uint8_t port);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef __SEQUENCE_H
+#define __SEQUENCE_H
+
+#include <stdint.h>
+#include "stm32f7xx_hal.h"
+
+/**
+ * @brief Maximum number of entries of an output sequence
+ * @note Every entry takes two words of DMA data, the BSRR value written at the
+ *       update event of the timer and the auto-reload value of the period after it.
+ */
+#define SEQUENCE_MAX_LENGTH 256
+
+/**
+ * @brief Delay of each entry in timer ticks of 1us
+ * @note The auto-reload value for the next entry is written by the DMA at the
+ *       compare event of channel 2 at tick SEQUENCE_COMPARE_TICK of every period,
+ *       hence a period must be longer than that.
+ */
+#define SEQUENCE_TICK_FREQ 1000000
+#define SEQUENCE_COMPARE_TICK 1
+#define SEQUENCE_MIN_DELAY_US (SEQUENCE_COMPARE_TICK + 1)
+#define SEQUENCE_MAX_DELAY_US 65535
+
+// Flags of the playback mode
+#define SEQUENCE_MODE_LOOP (1 << 0)    // restart from the first entry after the last one
+#define SEQUENCE_MODE_TRIGGER (1 << 1) // start at the rising edge of SEQUENCE_TRIGGER_Pin
+
+/* user-defined type */
+typedef enum
+{
+    SEQUENCE_IDLE = 0,
+    SEQUENCE_WAITING_TRIGGER = 1,
+    SEQUENCE_RUNNING = 2,
+} sequence_state_t;
+
+typedef struct
+{
+    uint16_t outputs;  // bitmap of outputs, bit n is output n
+    uint8_t set;       // 1 to set the outputs, 0 to reset them
+    uint16_t delay_us; // time until the next entry
+} sequence_entry_t;
+
+/* Function Prototype */
+void sequence_init(TIM_HandleTypeDef *_htim, DMA_HandleTypeDef *_hdma_bsrr, DMA_HandleTypeDef *_hdma_arr);
+HAL_StatusTypeDef sequence_set_entry(uint16_t index, sequence_entry_t *entry);
+HAL_StatusTypeDef sequence_get_entry(uint16_t index, sequence_entry_t *entry);
+HAL_StatusTypeDef sequence_start(uint16_t length, uint8_t mode);
+void sequence_stop(void);
+sequence_state_t sequence_get_state(void);
+uint32_t sequence_get_cycles(void);
+
+#endif
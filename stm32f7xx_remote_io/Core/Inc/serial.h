@@ -0,0 +1,122 @@
+#ifndef __SERIAL_H
+#define __SERIAL_H
+
+#include <stdint.h>
+#include "stm32f7xx_hal.h"
+
+/**
+ * @brief Size of the DMA receive buffer
+ * @note The DMA writes the received bytes into this buffer in circular mode.
+ *       The half transfer, transfer complete and idle line interrupts hand the
+ *       bytes received since the previous interrupt to the stream buffer, so the
+ *       reader is woken once per chunk instead of once per byte.
+ *       At 1 Mbaud the buffer is filled in about 10ms.
+ */
+#define SERIAL_RX_BUFFER_SIZE 1024
+
+// bytes buffered between the interrupts and the reading task
+#define SERIAL_STREAM_BUFFER_SIZE 2048
+
+// bytes read from the stream buffer at a time, and sent to the client in one go
+#define SERIAL_CHUNK_SIZE 256
+
+/**
+ * @brief Largest frame assembled from the received data
+ * @note A frame is sent to the client in one FreeRTOS_send(). Data which does not
+ *       form a frame within this size is sent as it is and counted as a frame error.
+ */
+#define SERIAL_FRAME_SIZE 1024
+
+// frame ends signaled by the receiver timeout and not taken by the reader yet
+#define SERIAL_FRAME_MARKS 16
+
+// the raw serial tunnel listens at the API port plus this offset
+#define SERIAL_TUNNEL_PORT_OFFSET 2
+
+// interval to retry handing received data to a congested tunnel
+#define SERIAL_TUNNEL_RETRY_MS 5
+
+// longest time to wait for the DMA to send a block
+#define SERIAL_TX_TIMEOUT_MS 1000
+
+// longest time a change of the line parameters waits for the receiver to be between characters
+#define SERIAL_RECONFIGURE_TIMEOUT_MS 20
+
+// line terminator appended to the message of W05
+#define SERIAL_LINE_TERMINATOR "\r\n"
+
+// default line parameters, settings 105 ~ 109
+#define SERIAL_DEFAULT_BAUD_RATE 115200
+#define SERIAL_DEFAULT_DATA_BITS 8
+#define SERIAL_DEFAULT_PARITY SERIAL_PARITY_NONE
+#define SERIAL_DEFAULT_STOP_BITS 1
+#define SERIAL_DEFAULT_FLOW_CONTROL 0
+
+// fill levels in percent of the receive path at which RTS holds off and releases the peer, settings 114 and 115
+#define SERIAL_DEFAULT_HIGH_WATERMARK 75
+#define SERIAL_DEFAULT_LOW_WATERMARK 25
+
+// default framing of the received data, settings 116 ~ 119
+#define SERIAL_DEFAULT_FRAME_MODE SERIAL_FRAME_NONE
+#define SERIAL_DEFAULT_FRAME_DELIMITER '\n'
+#define SERIAL_DEFAULT_FRAME_LENGTH 1
+#define SERIAL_DEFAULT_FRAME_TIMEOUT_US 1000
+
+#define SERIAL_MIN_BAUD_RATE 1200
+#define SERIAL_MAX_BAUD_RATE 3000000
+
+#define SERIAL_PARITY_NONE 0
+#define SERIAL_PARITY_ODD 1
+#define SERIAL_PARITY_EVEN 2
+
+/**
+ * @brief Framing modes of the received data
+ * @note NONE: the data is handed on as it arrives.
+ *       DELIMITER: a frame ends with the delimiter byte, which is part of the frame.
+ *       FIXED: every frame is the frame length in bytes.
+ *       PREFIXED: a frame starts with a big endian length field of the frame length
+ *       in bytes, 1 or 2, which counts the bytes following the field.
+ *       TIMEOUT: a frame ends when the line has been idle for the frame timeout,
+ *       measured by the receiver timeout counter of the UART.
+ */
+#define SERIAL_FRAME_NONE 0
+#define SERIAL_FRAME_DELIMITER 1
+#define SERIAL_FRAME_FIXED 2
+#define SERIAL_FRAME_PREFIXED 3
+#define SERIAL_FRAME_TIMEOUT 4
+
+/* user-defined type */
+typedef struct
+{
+    uint32_t rx_bytes;   // bytes received by the DMA
+    uint32_t tx_bytes;   // bytes sent by the DMA
+    uint32_t rx_events;  // interrupts which handed data to the stream buffer
+    uint32_t rx_dropped; // bytes lost because the stream buffer was full
+    uint32_t overruns;   // overrun errors of the UART
+    uint32_t tx_stalls;     // writes which timed out, e.g. held off by CTS
+    uint32_t rts_throttles; // times RTS held off the peer
+    uint32_t isr_cycles; // CPU cycles spent in the receive interrupts
+    uint32_t frames;       // frames handed to the client
+    uint32_t frame_errors; // data sent without a complete frame, or discarded for a bad length field
+} serial_stats_t;
+
+/* Function Prototype */
+void serial_init(USART_TypeDef *_uart, DMA_HandleTypeDef *_hdma_rx, DMA_HandleTypeDef *_hdma_tx);
+HAL_StatusTypeDef serial_configure(void);
+void serial_set_reader(TaskHandle_t task);
+void serial_notify_reader(void);
+void serial_open_tunnel(TaskHandle_t task);
+void serial_close_tunnel(void);
+size_t serial_tunnel_peek(const uint8_t **data);
+void serial_tunnel_consume(size_t len);
+size_t serial_read(uint8_t *data, size_t len);
+bool serial_is_framed(void);
+void serial_flush(void);
+size_t serial_frame_peek(const uint8_t **frame);
+void serial_frame_consume(size_t len);
+HAL_StatusTypeDef serial_write(const uint8_t *data, uint16_t len);
+uint16_t serial_write_some(const uint8_t *data, uint16_t len, TickType_t timeout);
+void serial_get_stats(serial_stats_t *stats);
+void serial_irq_handler(void);
+
+#endif
@@ -3,6 +3,45 @@
 
 // flags for instructing restoring function to restore settings
 #define SETTINGS_RESTORE_DEFAULTS (1 << 0)
+#define SETTINGS_RESTORE_NETWORK (1 << 1) // address, netmask, gateway and port only
+
+/**
+ * @brief Store of the settings in flash
+ * @note The settings are appended as records to a log in the last two sectors of
+ *       the bank the code does not run from, sectors 22 and 23 for an image in
+ *       bank 1 and sectors 10 and 11 for one in bank 2, so the device has to be in
+ *       dual bank mode, option bit nDBANK cleared. The code keeps running while the
+ *       other bank is programmed or erased. Every record is a whole copy of the
+ *       settings in a slot of its own, checked by the CRC unit, and the one with the
+ *       highest sequence number is the latest. Once a sector is full the next record
+ *       starts the other sector, and the full one is erased by the settings task.
+ *       After an update the latest record is in the running bank, where the image
+ *       in the other bank kept it, and is moved over by the settings task.
+ */
+#define SETTINGS_SECTOR_SIZE (128 * 1024)
+#define SETTINGS_BANK_1_SECTOR FLASH_SECTOR_10 // the first of the two sectors
+#define SETTINGS_BANK_1_ADDRESS 0x080C0000
+#define SETTINGS_BANK_2_SECTOR FLASH_SECTOR_22
+#define SETTINGS_BANK_2_ADDRESS 0x081C0000
+#define SETTINGS_SLOT_SIZE 256
+#define SETTINGS_SLOTS (SETTINGS_SECTOR_SIZE / SETTINGS_SLOT_SIZE)
+
+// "SET1" once a record is complete, it is programmed last
+#define SETTINGS_MAGIC 0x53455431
+
+/**
+ * @brief Layout of settings_t
+ * @note New fields are only appended, so a record of a shorter settings_t is taken
+ *       with the defaults of the missing fields. Anything else bumps the version,
+ *       and the records of other versions are ignored.
+ */
+#define SETTINGS_VERSION 1
+
+// changes within this time are saved as one record
+#define SETTINGS_SAVE_DELAY_MS 100
+
+// interval at which the settings task checks an erase in progress
+#define SETTINGS_ERASE_POLL_MS 20
 
 // type of settings
 typedef struct
@@ -26,11 +65,44 @@ typedef struct
     uint8_t mac_address_4;
     uint8_t mac_address_5;
     uint8_t tcp_port;
+    uint32_t serial_baud_rate;
+    uint8_t serial_data_bits;    // 7 or 8
+    uint8_t serial_parity;       // SERIAL_PARITY_NONE, _ODD or _EVEN
+    uint8_t serial_stop_bits;    // 1 or 2
+    uint8_t serial_flow_control; // 1 to enable RTS/CTS
+    uint8_t serial_high_watermark; // percent of the receive path, RTS holds off the peer above it
+    uint8_t serial_low_watermark;  // percent of the receive path, RTS releases the peer below it
+    uint8_t serial_frame_mode;       // SERIAL_FRAME_NONE ~ SERIAL_FRAME_TIMEOUT
+    uint8_t serial_frame_delimiter;  // last byte of a frame in delimiter mode
+    uint16_t serial_frame_length;    // bytes of a frame in fixed mode, of the length field in prefixed mode
+    uint32_t serial_frame_timeout_us; // idle time ending a frame in timeout mode
+    uint16_t serial_transaction_timeout_ms; // time to wait for the response of a W13 request
+    uint32_t modbus_baud_rate;
+    uint8_t modbus_parity;      // SERIAL_PARITY_NONE, _ODD or _EVEN
+    uint16_t modbus_timeout_ms; // time for a slave to start its response
+    uint16_t debounce_period_us;                // sampling period of the input debounce filter
+    uint8_t debounce_time_ms[NUMBER_OF_INPUTS]; // debounce time of each input
+    int32_t analog_gain[NUMBER_OF_ANALOG_INPUTS];      // Q16.16 gain of each analog input
+    int32_t analog_offset_uv[NUMBER_OF_ANALOG_INPUTS]; // offset of each analog input in microvolts
+    uint32_t analog_slew_rate[NUMBER_OF_ANALOG_OUTPUTS]; // slew rate of each analog output in mV/s, 0 unlimited
+    uint16_t ws28xx_led_count; // LEDs of the WS28xx strip, 1 ~ NUMBER_OF_LEDS
 } settings_t;
 
+typedef struct
+{
+    uint32_t magic;    // SETTINGS_MAGIC, erased until the record is complete
+    uint32_t crc;      // CRC-32 of the words from sequence to the end of the settings
+    uint32_t sequence; // the record with the highest number is the latest
+    uint16_t version;  // SETTINGS_VERSION
+    uint16_t length;   // bytes of the settings
+    settings_t settings;
+} settings_record_t;
+
 extern settings_t settings;
 
 /* Export functions */
 void settings_init();
+void settings_restore(uint8_t restore_flag);
+void settings_save(void);
 
 #endif
\ No newline at end of file
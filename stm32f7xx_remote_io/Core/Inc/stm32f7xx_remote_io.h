@@ -3,22 +3,41 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "main.h"
 #include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+
+typedef enum {
+    STATUS_OK = 0,
+    STATUS_ERROR = 1,
+    STATUS_FAIL = 2,
+} io_status_t;
+
 #include "cpu_map.h"
 #include "utils.h"
+#include "boot.h"
 #include "freertos.h"
 #include "settings.h"
+#include "ota.h"
 #include "ethernet_if.h"
+#include "debounce.h"
+#include "output.h"
+#include "logic_capture.h"
+#include "sequence.h"
+#include "serial.h"
+#include "modbus.h"
+#include "analog.h"
+#include "analog_output.h"
+#include "ws28xx_pwm.h"
 #include "api.h"
-
-typedef enum {
-    STATUS_OK = 0,
-    STATUS_ERROR = 1,
-    STATUS_FAIL = 2,
-} io_status_t
+#include "transaction.h"
+#include "subscription.h"
 
 /* Exported functions */
 
-#endif
\ No newline at end of file
+#endif
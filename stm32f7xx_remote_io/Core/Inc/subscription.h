@@ -0,0 +1,58 @@
+#ifndef __SUBSCRIPTION_H
+#define __SUBSCRIPTION_H
+
+#include <stdint.h>
+#include "stm32f7xx_hal.h"
+
+/**
+ * @brief Report by exception of the subscribed inputs
+ * @note A digital input is reported whenever its debounced state changes, and an
+ *       analog input whenever its filtered value moves away from the value last
+ *       reported by more than the deadband. The interrupts of the debounce filter
+ *       and of the analog scan only wake the reporting task when there is something
+ *       to report, so an input which does not change costs nothing but its heartbeat.
+ *       A change is reported at most once per minimum interval, the latest value
+ *       being reported once the interval has passed, and every subscribed input is
+ *       reported at least once per maximum interval if it is not 0.
+ */
+#define SUBSCRIPTION_SLOTS (NUMBER_OF_INPUTS + NUMBER_OF_ANALOG_INPUTS)
+
+// longest minimum or maximum interval in milliseconds, 1 hour
+#define SUBSCRIPTION_MAX_INTERVAL_MS 3600000
+
+// a deadband in percent is given in millionths of a percent, 100% is the full scale of the input
+#define SUBSCRIPTION_MAX_PERCENT 100000000
+
+/* user-defined type */
+typedef struct
+{
+    bool percent;             // the deadband is in percent of the full scale instead of microvolts
+    uint32_t deadband;        // in microvolts, or in millionths of a percent, ignored by a digital input
+    uint32_t min_interval_ms; // least time between two reports of a change, 0 to report every change
+    uint32_t max_interval_ms; // heartbeat, 0 to report changes only
+} subscription_config_t;
+
+typedef struct
+{
+    bool active;
+    bool due;                 // report at the next chance, e.g. right after subscribing
+    bool changed;             // a digital input toggled since the last report
+    subscription_config_t config;
+    uint32_t deadband_uv;     // deadband of an analog input in microvolts
+    int32_t reported;         // value last reported, 0 or 1 for a digital input
+    TickType_t reported_tick; // time of the last report
+} subscription_t;
+
+/* Function Prototype */
+void subscription_init(void);
+HAL_StatusTypeDef subscription_set(uint32_t pin, subscription_config_t *config);
+bool subscription_get(uint32_t pin, subscription_config_t *config);
+uint32_t subscription_list(uint32_t *pins);
+void subscription_clear(void);
+void subscription_set_reader(TaskHandle_t task);
+bool subscription_take(uint32_t *pin, int32_t *value);
+TickType_t subscription_get_wait(void);
+void subscription_input_changed_from_isr(void);
+void subscription_analog_updated_from_isr(void);
+
+#endif
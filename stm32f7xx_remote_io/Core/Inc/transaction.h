@@ -0,0 +1,45 @@
+#ifndef __TRANSACTION_H
+#define __TRANSACTION_H
+
+#include <stdint.h>
+#include "stm32f7xx_hal.h"
+
+/**
+ * @brief Number of serial requests waiting to be sent
+ * @note W05 and W13 only queue their message and return, the messages are sent
+ *       by a task in the order of arrival, so a slow serial device never stalls
+ *       the command dispatcher.
+ */
+#define TRANSACTION_QUEUE_SIZE 8
+
+/**
+ * @brief Number of W13 requests sent and waiting for their response
+ * @note The serial device is expected to answer in the order of the requests,
+ *       hence every frame received completes the oldest transaction in flight.
+ *       The next request waits while all slots are in use.
+ */
+#define TRANSACTION_IN_FLIGHT 8
+
+// default time in milliseconds to wait for the response of a W13 request, setting 120
+#define TRANSACTION_DEFAULT_TIMEOUT_MS 1000
+#define TRANSACTION_MIN_TIMEOUT_MS 1
+#define TRANSACTION_MAX_TIMEOUT_MS 60000
+
+/* user-defined type */
+typedef struct
+{
+    uint32_t tag;                   // correlation ID given by the client
+    bool tagged;                    // false for W05, which expects no response
+    uint8_t length;                 // bytes of the message
+    char message[API_RX_BUFFER_SIZE];
+} transaction_request_t;
+
+/* Function Prototype */
+void transaction_init(void);
+HAL_StatusTypeDef transaction_submit(bool tagged, uint32_t tag, const char *message);
+void transaction_reset(void);
+bool transaction_match(uint32_t *tag);
+bool transaction_expire(uint32_t *tag);
+TickType_t transaction_get_wait(void);
+
+#endif
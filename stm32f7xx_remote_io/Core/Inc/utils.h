@@ -4,6 +4,53 @@
 #define true 1
 #define false 0
 
+/**
+ * @brief Bytes which the tokenizer may read past the terminator of a line
+ * @note The digits are scanned a word of 4 characters at a time, so a buffer holding
+ *       a line to be parsed has this many spare bytes after the room of the line.
+ */
+#define UTILS_READ_PADDING 3
+
+// largest number of decimals of utils_read_decimal(), the fraction and its rounding digit fit 32 bits
+#define UTILS_MAX_DECIMALS 8
+
+// Q16.16 fixed point, 1.0 is 65536
+#define UTILS_Q16_ONE 65536
+
+// longest value written by utils_format_decimal(), e.g. "-2147.483648"
+#define UTILS_FORMAT_SIZE 12
+
+// bytes of a line of the data cache
+#define UTILS_CACHE_LINE_SIZE 32
+
+/**
+ * @brief Placement of a buffer read or written by a DMA
+ * @note The .dma_buffer section is mapped non-cacheable by the MPU, so the data
+ *       cache needs no clean or invalidate around the transfers. The buffers start
+ *       at a cache line, so no cached data ever shares a line with them.
+ */
+#define UTILS_DMA_BUFFER __attribute__((section(".dma_buffer"), aligned(UTILS_CACHE_LINE_SIZE)))
+
+/**
+ * @brief Placement of the code and data of the hot paths in the tightly coupled memories
+ * @note The code is copied by the startup into the ITCM RAM, where it runs with no
+ *       wait state whatever the cache holds. The data is zeroed by the startup in
+ *       the DTCM RAM, never cached and reached by the DMA through the AHBS port.
+ */
+#define UTILS_ITCM_CODE __attribute__((section(".itcm_text")))
+#define UTILS_DTCM_DATA __attribute__((section(".dtcm_bss")))
+
 /* Function prototypes */
+uint8_t utils_read_float(char *line, uint8_t *char_counter, float *float_ptr);
+uint8_t utils_read_uint(char *line, uint8_t *char_counter, uint32_t *value, uint32_t max);
+uint8_t utils_read_int(char *line, uint8_t *char_counter, int32_t *value, int32_t min, int32_t max);
+uint8_t utils_read_decimal(char *line, uint8_t *char_counter, int32_t *value, uint8_t decimals);
+uint8_t utils_read_q16(char *line, uint8_t *char_counter, int32_t *value);
+uint8_t utils_read_uint_list(char *line, uint8_t *char_counter, uint32_t *values, uint8_t size, uint32_t max);
+uint8_t utils_format_uint(char *buffer, uint32_t value, uint8_t width);
+uint8_t utils_format_decimal(char *buffer, int32_t value, uint8_t decimals);
+#ifndef UTILS_HOST_BENCHMARK
+uint32_t utils_get_timer_clock(TIM_TypeDef *instance);
+#endif
 
-#endif
\ No newline at end of file
+#endif
@@ -17,7 +17,11 @@
 #endif
 
 /**
- * @brief Number of LEDs per strip
+ * @brief Largest number of LEDs per strip
+ * @note The number of LEDs driven is setting 110, up to this value. It is taken at
+ *       the start of every update, so a change never cuts a frame in two. The LEDs
+ *       are sent in groups of NUMBER_OF_LEDS_UPDATED_PER_ISR, those of the last
+ *       group past the number of LEDs are sent off.
  */
 #define NUMBER_OF_LEDS 50
 
@@ -74,6 +78,8 @@ typedef struct color
 
 /* Function Prototype */
 void ws28xx_pwm_init(TIM_HandleTypeDef *_htim, uint32_t _tim_channel);
+HAL_StatusTypeDef ws28xx_pwm_set_led_count(uint16_t count);
+uint16_t ws28xx_pwm_get_led_count(void);
 HAL_StatusTypeDef ws28xx_pwm_set_color(uint8_t r, uint8_t g, uint8_t b, uint16_t led);
 void ws28xx_pwm_set_color_all(uint8_t r, uint8_t g, uint8_t b);
 void ws28xx_pwm_set_color_all_off(void);
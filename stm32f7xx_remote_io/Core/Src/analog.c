@@ -0,0 +1,1257 @@
+#include "stm32f7xx_remote_io.h"
+#include "queue.h"
+
+static TIM_HandleTypeDef *htim;
+static DMA_HandleTypeDef *hdma;
+static QueueHandle_t blockQueue;
+static SemaphoreHandle_t captureMutex; // held while a capture is started, stopped or sent
+static TaskHandle_t analogStreamTaskHandle = NULL;
+
+// ADC channel of every analog input, in the order of the scan
+static const uint8_t analog_channels[NUMBER_OF_ANALOG_INPUTS] = ANALOG_INPUT_CHANNEL_TABLE;
+
+// digital inputs, whose EXTI lines trigger a capture
+static const cpu_map_pin_t input_pins[NUMBER_OF_INPUTS] = INPUT_PIN_TABLE;
+
+// sampling times selectable by SMPx of the ADC, in ADC clock cycles
+static const uint16_t sampling_cycles[] = {3, 15, 28, 56, 84, 112, 144, 480};
+
+// pool of blocks written by the DMA, the inputs of a scan are adjacent
+static uint16_t analog_blocks[ANALOG_BLOCKS][ANALOG_BLOCK_SIZE] UTILS_DMA_BUFFER;
+
+// blocks of the memory registers of the DMA
+static uint8_t dma_blocks[2];
+
+// ring of the blocks neither written by the DMA nor queued to the sender task
+static uint8_t free_blocks[ANALOG_BLOCKS];
+static uint8_t free_head = 0;
+static uint8_t free_count = 0;
+
+// latest calibrated value of every input in microvolts, written by the DMA interrupt
+static volatile int32_t analog_values[NUMBER_OF_ANALOG_INPUTS];
+
+// calibration folded into a Q16.16 factor from the sum of a block to microvolts
+static struct
+{
+    int64_t scale;
+    int32_t offset_uv;
+} calibration[NUMBER_OF_ANALOG_INPUTS];
+
+// state of the stream, the scan rate is 0 if not streaming
+static volatile analog_stream_stats_t stream;
+static volatile bool streamClientConnected = false;
+static volatile uint32_t stream_cycles = 0; // CPU cycles spent on the stream in the current period
+static uint32_t stream_bytes = 0;           // bytes sent in the current period
+
+// state of the capture
+static analog_capture_config_t capture;
+static volatile analog_capture_state_t capture_state = ANALOG_CAPTURE_IDLE;
+static uint32_t capture_blocks = 0;        // blocks completed since the capture was armed
+static volatile uint32_t trigger_scan = 0; // absolute index of the trigger scan
+static bool trigger_enabled = false;       // the pre-trigger scans are available
+static int32_t trigger_code = 0;           // level in ADC codes, or slope in codes per scan
+static bool watchdog_above = false;        // the watchdog flags the conversions above the level
+static bool watchdog_armed = false;        // the input has been seen on the other side of the level
+static uint16_t last_sample = 0;           // last sample of the slope input in the previous block
+
+// ring of the blocks kept by the capture, oldest first
+static uint8_t capture_ring[ANALOG_BLOCKS];
+static uint8_t capture_head = 0;
+static uint8_t capture_count = 0;
+static uint32_t capture_first = 0; // number of the oldest block of the ring since the capture was armed
+
+// the encoded block being sent
+static uint8_t send_buffer[ANALOG_DELTA_MAX_SIZE];
+
+_Static_assert((uint64_t)NUMBER_OF_ANALOG_INPUTS * (3 + ANALOG_CONVERSION_CYCLES) * ANALOG_SCAN_RATE * 4
+                   <= (uint64_t)ANALOG_ADC_CLOCK * 3,
+               "the analog inputs cannot be scanned at the default rate");
+_Static_assert(ANALOG_BLOCK_SIZE < 65536, "a block exceeds the 16-bit DMA counter");
+_Static_assert(ANALOG_BLOCKS >= 5 && ANALOG_BLOCKS <= UINT8_MAX, "the pool needs blocks besides the two of the DMA");
+
+/* Function Prototype */
+uint32_t __analog_configure(uint32_t scan_rate);
+uint32_t __analog_restart(uint32_t scan_rate);
+void __analog_start_dma(void);
+void __analog_stop_dma(void);
+void __analog_update_scale(uint8_t input);
+void __analog_filter(const uint16_t *samples);
+void __analog_m0_complete_callback(DMA_HandleTypeDef *_hdma);
+void __analog_m1_complete_callback(DMA_HandleTypeDef *_hdma);
+void __analog_block_complete(HAL_DMA_MemoryTypeDef memory);
+bool __analog_take_block(uint8_t *block);
+void __analog_release_block(uint8_t block);
+static void prvAnalogStreamTask(void *pvParameters);
+BaseType_t __analog_send_block(Socket_t xSocket, const analog_block_t *block);
+uint16_t __analog_encode_delta(const uint16_t *samples, uint8_t *data);
+void __analog_update_stats(TickType_t *last_update);
+uint8_t __analog_capture_block(uint8_t block, BaseType_t *pxHigherPriorityTaskWoken);
+uint8_t __analog_capture_pop(void);
+void __analog_capture_arm(void);
+void __analog_capture_stop(void);
+void __analog_find_slope(uint8_t block, uint32_t base);
+void __analog_enable_trigger(void);
+void __analog_disable_trigger(void);
+void __analog_set_watchdog(void);
+void __analog_trigger(void);
+uint32_t __analog_latest_scan(void);
+int32_t __analog_level_to_code(uint8_t input, int32_t level_uv);
+int32_t __analog_slope_to_code(uint8_t input, int32_t slope_uv, uint32_t scan_rate);
+BaseType_t __analog_send_capture(Socket_t xSocket);
+BaseType_t __analog_send_all(Socket_t xSocket, const uint8_t *data, size_t len);
+
+/**
+ * @brief Initialize the scan of the analog inputs.
+ * @note The ADC is driven at register level and triggered by the TRGO of the timer,
+ *       which must be configured to output its update event.
+ */
+void analog_init(TIM_HandleTypeDef *_htim, DMA_HandleTypeDef *_hdma)
+{
+    htim = _htim;
+    hdma = _hdma;
+
+    blockQueue = xQueueCreate(ANALOG_BLOCKS, sizeof(analog_block_t));
+    configASSERT(blockQueue != NULL);
+
+    captureMutex = xSemaphoreCreateMutex();
+    configASSERT(captureMutex != NULL);
+
+    // the cycle counter measures the CPU time of the stream
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (uint8_t i = 0; i < NUMBER_OF_ANALOG_INPUTS; i++)
+    {
+        if (analog_set_calibration(i, settings.analog_gain[i], settings.analog_offset_uv[i]) != HAL_OK)
+        {
+            analog_set_calibration(i, ANALOG_UNITY_GAIN, 0);
+        }
+    }
+
+    // the DMA starts with the first two blocks of the pool, the others are free
+    dma_blocks[0] = 0;
+    dma_blocks[1] = 1;
+    for (uint8_t i = 2; i < ANALOG_BLOCKS; i++)
+    {
+        free_blocks[free_count++] = i;
+    }
+
+    // peripheral to memory, one half word per conversion
+    hdma->Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma->Init.MemInc = DMA_MINC_ENABLE;
+    hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    hdma->Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    hdma->Init.Mode = DMA_CIRCULAR;
+    hdma->Init.Priority = DMA_PRIORITY_HIGH;
+    hdma->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(hdma) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    // the DMA callbacks are called when the block of a memory register has been filled
+    hdma->XferCpltCallback = __analog_m0_complete_callback;
+    hdma->XferM1CpltCallback = __analog_m1_complete_callback;
+    hdma->XferHalfCpltCallback = NULL;
+    hdma->XferM1HalfCpltCallback = NULL;
+    hdma->XferErrorCallback = NULL;
+
+    __HAL_RCC_ADC1_CLK_ENABLE();
+
+    // ADCCLK is PCLK2 / 4
+    MODIFY_REG(ADC123_COMMON->CCR, ADC_CCR_ADCPRE, ADC_CCR_ADCPRE_0);
+
+    // 12-bit scan of the mapped channels, the DMA request follows every conversion
+    ADC1->CR1 = ADC_CR1_SCAN | ADC_CR1_OVRIE;
+    ADC1->SQR1 = (NUMBER_OF_ANALOG_INPUTS - 1U) << ADC_SQR1_L_Pos;
+    ADC1->SQR2 = 0;
+    ADC1->SQR3 = 0;
+    for (uint8_t rank = 0; rank < NUMBER_OF_ANALOG_INPUTS; rank++)
+    {
+        uint8_t channel = analog_channels[rank];
+
+        if (rank < 6)
+        {
+            ADC1->SQR3 |= (uint32_t)channel << (5 * rank);
+        }
+        else if (rank < 12)
+        {
+            ADC1->SQR2 |= (uint32_t)channel << (5 * (rank - 6));
+        }
+        else
+        {
+            ADC1->SQR1 |= (uint32_t)channel << (5 * (rank - 12));
+        }
+    }
+
+    // a scan starts at the rising edge of TIM2_TRGO
+    ADC1->CR2 = ADC_CR2_EXTEN_0 | (0xBU << ADC_CR2_EXTSEL_Pos) | ADC_CR2_DMA | ADC_CR2_DDS | ADC_CR2_ADON;
+
+    HAL_NVIC_SetPriority(ADC_IRQn, 6, 0);
+    HAL_NVIC_EnableIRQ(ADC_IRQn);
+
+    if (__analog_configure(ANALOG_SCAN_RATE) == 0)
+    {
+        Error_Handler();
+    }
+
+    __analog_start_dma();
+    HAL_TIM_Base_Start(htim);
+}
+
+void analog_start_task(void)
+{
+    xTaskCreate(prvAnalogStreamTask, "AnalogStream", configMINIMAL_STACK_SIZE * 2, NULL, tskIDLE_PRIORITY + 1, &analogStreamTaskHandle);
+}
+
+/**
+ * @brief Read the latest value of an analog input in microvolts.
+ * @note The value is computed in the DMA interrupt, reading it takes a single load.
+ */
+int32_t analog_read(uint8_t input)
+{
+    return analog_values[input];
+}
+
+HAL_StatusTypeDef analog_set_calibration(uint8_t input, int32_t gain, int32_t offset_uv)
+{
+    if (input >= NUMBER_OF_ANALOG_INPUTS || gain <= 0 || gain > ANALOG_MAX_GAIN
+        || offset_uv < -ANALOG_MAX_OFFSET_UV || offset_uv > ANALOG_MAX_OFFSET_UV)
+    {
+        return HAL_ERROR;
+    }
+
+    settings.analog_gain[input] = gain;
+    settings.analog_offset_uv[input] = offset_uv;
+    __analog_update_scale(input);
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Start streaming the scans to the client of the data socket.
+ * @note The scan restarts at the new rate, so the first block of the stream is
+ *       scanned at that rate. The sequence numbers and counters start from 0.
+ * @retval HAL_ERROR if the inputs cannot be converted at that rate
+ */
+HAL_StatusTypeDef analog_stream_start(uint32_t scan_rate, analog_encoding_t encoding)
+{
+    if (scan_rate < ANALOG_MIN_SCAN_RATE || scan_rate > ANALOG_MAX_SCAN_RATE || encoding > ANALOG_ENCODING_DELTA)
+    {
+        return HAL_ERROR;
+    }
+
+    // the stream and a capture share the pool
+    xSemaphoreTake(captureMutex, portMAX_DELAY);
+    if (capture_state != ANALOG_CAPTURE_IDLE)
+    {
+        xSemaphoreGive(captureMutex);
+        return HAL_BUSY;
+    }
+
+    // no block is queued while the scan restarts
+    taskENTER_CRITICAL();
+    stream.scan_rate = 0;
+    taskEXIT_CRITICAL();
+
+    // back to the default rate if the new one is not achievable
+    uint32_t achieved = __analog_restart(scan_rate);
+    if (achieved == 0)
+    {
+        __analog_restart(ANALOG_SCAN_RATE);
+        xSemaphoreGive(captureMutex);
+        return HAL_ERROR;
+    }
+
+    taskENTER_CRITICAL();
+    stream.encoding = encoding;
+    stream.blocks = 0;
+    stream.dropped = 0;
+    stream.scan_rate = achieved;
+    taskEXIT_CRITICAL();
+
+    xSemaphoreGive(captureMutex);
+    return HAL_OK;
+}
+
+// Stop streaming, and scan at the default rate again
+void analog_stream_stop(void)
+{
+    // a capture keeps its own rate
+    xSemaphoreTake(captureMutex, portMAX_DELAY);
+    if (capture_state == ANALOG_CAPTURE_IDLE)
+    {
+        taskENTER_CRITICAL();
+        stream.scan_rate = 0;
+        taskEXIT_CRITICAL();
+
+        __analog_restart(ANALOG_SCAN_RATE);
+    }
+    xSemaphoreGive(captureMutex);
+}
+
+void analog_stream_get_stats(analog_stream_stats_t *stats)
+{
+    taskENTER_CRITICAL();
+    stats->scan_rate = stream.scan_rate;
+    stats->encoding = stream.encoding;
+    stats->blocks = stream.blocks;
+    stats->dropped = stream.dropped;
+    stats->bytes_per_second = stream.bytes_per_second;
+    stats->cpu_permille = stream.cpu_permille;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Start a triggered capture.
+ * @note The scan restarts at the rate of the capture, and returns to the default
+ *       rate once the capture has been sent or aborted. A capture which has not
+ *       been sent yet is dropped.
+ * @retval HAL_BUSY while streaming or while another capture is armed
+ */
+HAL_StatusTypeDef analog_capture_start(analog_capture_config_t *_config)
+{
+    analog_capture_config_t config = *_config;
+    int32_t code = 0;
+
+    if (config.scan_rate < ANALOG_MIN_SCAN_RATE
+        || config.scan_rate > ANALOG_MAX_SCAN_RATE
+        || config.depth == 0
+        || config.depth > ANALOG_CAPTURE_MAX_SCANS
+        || config.pre_trigger >= config.depth
+        || config.trigger > ANALOG_TRIGGER_DIGITAL_FALLING
+        || config.level_uv < -ANALOG_MAX_LEVEL_UV
+        || config.level_uv > ANALOG_MAX_LEVEL_UV)
+    {
+        return HAL_ERROR;
+    }
+
+    if (config.trigger == ANALOG_TRIGGER_NONE)
+    {
+        // without a trigger, there is nothing before the first scan
+        config.pre_trigger = 0;
+    }
+    else if (config.trigger <= ANALOG_TRIGGER_SLOPE)
+    {
+        if (config.source < ANALOG_INPUT_ID_OFFSET || config.source >= ANALOG_INPUT_ID_OFFSET + NUMBER_OF_ANALOG_INPUTS)
+        {
+            return HAL_ERROR;
+        }
+
+        // a level at either end of the range is never crossed
+        code = __analog_level_to_code(config.source - ANALOG_INPUT_ID_OFFSET, config.level_uv);
+        if (config.trigger != ANALOG_TRIGGER_SLOPE && (code <= 0 || code >= ANALOG_FULL_SCALE_CODE))
+        {
+            return HAL_ERROR;
+        }
+    }
+    else if (config.source >= NUMBER_OF_INPUTS)
+    {
+        return HAL_ERROR;
+    }
+
+    xSemaphoreTake(captureMutex, portMAX_DELAY);
+    if (stream.scan_rate != 0 || capture_state == ANALOG_CAPTURE_ARMED || capture_state == ANALOG_CAPTURE_TRIGGERED)
+    {
+        xSemaphoreGive(captureMutex);
+        return HAL_BUSY;
+    }
+    __analog_capture_stop();
+
+    // back to the default rate if the new one is not achievable
+    config.scan_rate = __analog_restart(config.scan_rate);
+    if (config.scan_rate == 0)
+    {
+        __analog_restart(ANALOG_SCAN_RATE);
+        xSemaphoreGive(captureMutex);
+        return HAL_ERROR;
+    }
+
+    if (config.trigger == ANALOG_TRIGGER_SLOPE)
+    {
+        code = __analog_slope_to_code(config.source - ANALOG_INPUT_ID_OFFSET, config.level_uv, config.scan_rate);
+    }
+
+    taskENTER_CRITICAL();
+    capture = config;
+    trigger_code = code;
+    __analog_capture_arm();
+    taskEXIT_CRITICAL();
+
+    xSemaphoreGive(captureMutex);
+
+    // report the scan rate which the timer can actually achieve
+    _config->scan_rate = config.scan_rate;
+    _config->pre_trigger = config.pre_trigger;
+
+    return HAL_OK;
+}
+
+void analog_capture_abort(void)
+{
+    xSemaphoreTake(captureMutex, portMAX_DELAY);
+    if (capture_state != ANALOG_CAPTURE_IDLE)
+    {
+        __analog_capture_stop();
+        __analog_restart(ANALOG_SCAN_RATE);
+    }
+    xSemaphoreGive(captureMutex);
+}
+
+analog_capture_state_t analog_capture_get_state(void)
+{
+    return capture_state;
+}
+
+uint32_t analog_capture_get_length(void)
+{
+    return (capture_state == ANALOG_CAPTURE_DONE) ? capture.depth : 0;
+}
+
+/**
+ * @brief Handle the interrupts of the ADC.
+ * @note The ADC stops its DMA requests after an overrun, so the DMA is restarted at
+ *       the beginning of its blocks to keep the inputs of a scan in order. That
+ *       breaks the continuity of the scans, hence a capture in progress is armed
+ *       again.
+ *       The analog watchdog flags every conversion of the trigger input beyond the
+ *       level. It first waits for the input on the other side of the level, then for
+ *       the crossing, so a level already crossed at arming does not trigger.
+ */
+void analog_irq_handler(void)
+{
+    if (ADC1->SR & ADC_SR_OVR)
+    {
+        CLEAR_BIT(ADC1->CR2, ADC_CR2_DMA);
+        __analog_stop_dma();
+        ADC1->SR = ~(uint32_t)ADC_SR_OVR;
+        __analog_start_dma();
+
+        if (capture_state == ANALOG_CAPTURE_ARMED || capture_state == ANALOG_CAPTURE_TRIGGERED)
+        {
+            __analog_capture_arm();
+        }
+    }
+
+    if ((ADC1->CR1 & ADC_CR1_AWDIE) && (ADC1->SR & ADC_SR_AWD))
+    {
+        if (watchdog_armed)
+        {
+            __analog_trigger();
+        }
+        else
+        {
+            watchdog_armed = true;
+            watchdog_above = !watchdog_above;
+            __analog_set_watchdog();
+        }
+
+        // cleared after the new thresholds, so a conversion in between flags them
+        ADC1->SR = ~(uint32_t)ADC_SR_AWD;
+    }
+}
+
+// Trigger a capture at an edge of a digital input, called from the EXTI interrupt
+void analog_exti_callback(uint16_t GPIO_Pin)
+{
+    if (capture_state == ANALOG_CAPTURE_ARMED && trigger_enabled
+        && capture.trigger >= ANALOG_TRIGGER_DIGITAL_RISING
+        && GPIO_Pin == input_pins[capture.source].mask)
+    {
+        __analog_trigger();
+    }
+}
+
+/**
+ * @brief Set the trigger timer and the sampling time for a scan rate.
+ * @note The longest sampling time is chosen for which a scan takes at most 3/4 of
+ *       the scan period, the rest is left for the DMA and the next trigger.
+ * @retval achieved scan rate, 0 if even the shortest sampling time is too long
+ */
+uint32_t __analog_configure(uint32_t scan_rate)
+{
+    int8_t code;
+
+    for (code = sizeof(sampling_cycles) / sizeof(sampling_cycles[0]) - 1; code >= 0; code--)
+    {
+        uint64_t cycles = (uint64_t)NUMBER_OF_ANALOG_INPUTS * (sampling_cycles[code] + ANALOG_CONVERSION_CYCLES);
+        if (cycles * scan_rate * 4 <= (uint64_t)ANALOG_ADC_CLOCK * 3)
+        {
+            break;
+        }
+    }
+
+    if (code < 0)
+    {
+        return 0;
+    }
+
+    uint32_t smpr1 = 0, smpr2 = 0;
+    for (uint8_t i = 0; i < NUMBER_OF_ANALOG_INPUTS; i++)
+    {
+        if (analog_channels[i] < 10)
+        {
+            smpr2 |= (uint32_t)code << (3 * analog_channels[i]);
+        }
+        else
+        {
+            smpr1 |= (uint32_t)code << (3 * (analog_channels[i] - 10));
+        }
+    }
+    ADC1->SMPR1 = smpr1;
+    ADC1->SMPR2 = smpr2;
+
+    // the timer counts at its full clock, TIM2 has a 32-bit auto-reload register
+    uint32_t clock = utils_get_timer_clock(htim->Instance);
+    uint32_t period = (clock + scan_rate / 2) / scan_rate;
+
+    __HAL_TIM_SET_PRESCALER(htim, 0);
+    __HAL_TIM_SET_AUTORELOAD(htim, period - 1);
+    __HAL_TIM_SET_COUNTER(htim, 0);
+
+    // load the prescaler now instead of at the next update event
+    htim->Instance->EGR = TIM_EGR_UG;
+
+    return clock / period;
+}
+
+/**
+ * @brief Restart the scan at another rate.
+ * @note The scan in progress completes before the ADC is reconfigured, and the DMA
+ *       restarts at the beginning of its blocks so the blocks hold whole scans.
+ */
+uint32_t __analog_restart(uint32_t scan_rate)
+{
+    uint32_t achieved;
+
+    __HAL_TIM_DISABLE(htim);
+
+    // two ticks include a full tick, much longer than a scan
+    vTaskDelay(2);
+
+    HAL_NVIC_DisableIRQ(ADC_IRQn);
+    CLEAR_BIT(ADC1->CR2, ADC_CR2_DMA);
+    HAL_DMA_Abort(hdma);
+    ADC1->SR = 0;
+
+    achieved = __analog_configure(scan_rate);
+
+    __analog_start_dma();
+    HAL_NVIC_EnableIRQ(ADC_IRQn);
+    __HAL_TIM_ENABLE(htim);
+
+    return achieved;
+}
+
+void __analog_start_dma(void)
+{
+    if (HAL_DMAEx_MultiBufferStart_IT(hdma,
+                                      (uint32_t)&ADC1->DR,
+                                      (uint32_t)analog_blocks[dma_blocks[0]],
+                                      (uint32_t)analog_blocks[dma_blocks[1]],
+                                      ANALOG_BLOCK_SIZE) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    SET_BIT(ADC1->CR2, ADC_CR2_DMA);
+}
+
+/**
+ * @brief Stop the DMA from the interrupt of the ADC.
+ * @note HAL_DMA_Abort() blocks with a timeout on the tick, which has no place in an
+ *       interrupt. With the requests of the ADC off, the stream has no transfer in
+ *       progress and reads disabled within a few cycles.
+ *       Its flags are cleared, so a transfer complete of the old blocks is not taken
+ *       for one of the restarted DMA.
+ */
+void __analog_stop_dma(void)
+{
+    // its interrupts go first, as HAL_DMA_Abort() does, they are enabled again by the restart
+    CLEAR_BIT(hdma->Instance->CR, DMA_IT_TC | DMA_IT_TE | DMA_IT_DME | DMA_IT_HT);
+    CLEAR_BIT(hdma->Instance->FCR, DMA_IT_FE);
+    CLEAR_BIT(hdma->Instance->CR, DMA_SxCR_EN);
+    while (hdma->Instance->CR & DMA_SxCR_EN)
+    {
+    }
+
+    __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_TC_FLAG_INDEX(hdma) | __HAL_DMA_GET_HT_FLAG_INDEX(hdma)
+                                   | __HAL_DMA_GET_TE_FLAG_INDEX(hdma) | __HAL_DMA_GET_DME_FLAG_INDEX(hdma)
+                                   | __HAL_DMA_GET_FE_FLAG_INDEX(hdma));
+    hdma->State = HAL_DMA_STATE_READY;
+    __HAL_UNLOCK(hdma);
+}
+
+void __analog_update_scale(uint8_t input)
+{
+    // the sum of a block of codes to microvolts, including the gain
+    int64_t scale = (int64_t)settings.analog_gain[input] * ANALOG_REFERENCE_UV
+                    / ((int64_t)ANALOG_FULL_SCALE_CODE * ANALOG_BLOCK_SCANS);
+
+    // the DMA interrupt must not see the scale of one calibration with the offset of another
+    taskENTER_CRITICAL();
+    calibration[input].scale = scale;
+    calibration[input].offset_uv = settings.analog_offset_uv[input];
+    taskEXIT_CRITICAL();
+}
+
+// Average the scans of a block and calibrate them
+void __analog_filter(const uint16_t *samples)
+{
+    uint32_t sum[NUMBER_OF_ANALOG_INPUTS] = {0};
+
+    for (uint16_t scan = 0; scan < ANALOG_BLOCK_SCANS; scan++)
+    {
+        for (uint8_t i = 0; i < NUMBER_OF_ANALOG_INPUTS; i++)
+        {
+            sum[i] += *samples++;
+        }
+    }
+
+    for (uint8_t i = 0; i < NUMBER_OF_ANALOG_INPUTS; i++)
+    {
+        analog_values[i] = (int32_t)((sum[i] * calibration[i].scale) >> 16) + calibration[i].offset_uv;
+    }
+
+    // report the subscribed inputs which moved out of their deadband
+    subscription_analog_updated_from_isr();
+}
+
+void __analog_m0_complete_callback(DMA_HandleTypeDef *_hdma)
+{
+    __analog_block_complete(MEMORY0);
+}
+
+void __analog_m1_complete_callback(DMA_HandleTypeDef *_hdma)
+{
+    __analog_block_complete(MEMORY1);
+}
+
+/**
+ * @brief Handle a completed block.
+ * @note The memory register which has just completed is idle now. While a capture
+ *       is armed, the block is kept in its ring. While streaming, the block is queued
+ *       to the sender task and the memory register is pointed at a free block.
+ *       Otherwise, or if no block is free, the block is written again once the other
+ *       memory register completes.
+ */
+void __analog_block_complete(HAL_DMA_MemoryTypeDef memory)
+{
+    uint32_t start = DWT->CYCCNT;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    uint8_t block = dma_blocks[memory];
+    uint8_t next = block;
+
+    if (capture_state == ANALOG_CAPTURE_ARMED || capture_state == ANALOG_CAPTURE_TRIGGERED)
+    {
+        next = __analog_capture_block(block, &xHigherPriorityTaskWoken);
+    }
+    else if (stream.scan_rate != 0)
+    {
+        analog_block_t item = {.sequence = stream.blocks++, .index = block};
+
+        if (streamClientConnected && __analog_take_block(&next))
+        {
+            if (xQueueSendFromISR(blockQueue, &item, &xHigherPriorityTaskWoken) != pdTRUE)
+            {
+                __analog_release_block(next);
+                next = block;
+            }
+        }
+
+        if (next == block)
+        {
+            stream.dropped++;
+        }
+    }
+
+    dma_blocks[memory] = next;
+    HAL_DMAEx_ChangeMemory(hdma, (uint32_t)analog_blocks[next], memory);
+
+    // the block stays intact for at least one block time, or until the capture is sent
+    __analog_filter(analog_blocks[block]);
+
+    if (stream.scan_rate != 0)
+    {
+        stream_cycles += DWT->CYCCNT - start;
+    }
+
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+// Take a block from the free ring, called from the DMA interrupt
+bool __analog_take_block(uint8_t *block)
+{
+    if (free_count == 0)
+    {
+        return false;
+    }
+
+    *block = free_blocks[free_head];
+    free_head = (free_head + 1) % ANALOG_BLOCKS;
+    free_count--;
+
+    return true;
+}
+
+// Return a block to the free ring
+void __analog_release_block(uint8_t block)
+{
+    UBaseType_t uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+    free_blocks[(free_head + free_count) % ANALOG_BLOCKS] = block;
+    free_count++;
+    taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+}
+
+/**
+ * @brief Send the blocks of the stream and the captures to the client of the data socket.
+ * @note The blocks are only queued while a client is connected, the blocks left in
+ *       the queue are released once the client disconnects. A capture is sent as
+ *       soon as it is done, or as soon as a client connects if it was done earlier.
+ */
+static void prvAnalogStreamTask(void *pvParameters)
+{
+    Socket_t xListeningSocket = NULL, xConnectedSocket;
+    analog_block_t block;
+    TickType_t last_update;
+
+    for (;;)
+    {
+        // the accepted socket inherits the size of the transmit buffer
+        xConnectedSocket = tcp_server_accept(&xListeningSocket, ANALOG_STREAM_PORT_OFFSET, ANALOG_STREAM_TX_BUFFER_SIZE, 0);
+        if (xConnectedSocket == NULL)
+        {
+            continue;
+        }
+
+        FreeRTOS_debug_printf(("Analog stream client connected\n"));
+
+        last_update = xTaskGetTickCount();
+        streamClientConnected = true;
+
+        while (FreeRTOS_issocketconnected(xConnectedSocket) == pdTRUE)
+        {
+            // a capture may have completed before the client connected
+            if (capture_state == ANALOG_CAPTURE_DONE && __analog_send_capture(xConnectedSocket) != pdPASS)
+            {
+                break;
+            }
+
+            if (xQueueReceive(blockQueue, &block, pdMS_TO_TICKS(ANALOG_STREAM_STATS_PERIOD_MS)) == pdTRUE
+                && block.index != ANALOG_BLOCK_CAPTURE_DONE)
+            {
+                BaseType_t result = __analog_send_block(xConnectedSocket, &block);
+                __analog_release_block(block.index);
+                if (result != pdPASS)
+                {
+                    break;
+                }
+            }
+
+            __analog_update_stats(&last_update);
+        }
+
+        streamClientConnected = false;
+        while (xQueueReceive(blockQueue, &block, 0) == pdTRUE)
+        {
+            if (block.index != ANALOG_BLOCK_CAPTURE_DONE)
+            {
+                __analog_release_block(block.index);
+            }
+        }
+
+        taskENTER_CRITICAL();
+        stream.bytes_per_second = 0;
+        stream.cpu_permille = 0;
+        taskEXIT_CRITICAL();
+
+        FreeRTOS_shutdown(xConnectedSocket, FREERTOS_SHUT_RDWR);
+        FreeRTOS_closesocket(xConnectedSocket);
+    }
+}
+
+/**
+ * @brief Send a block with its header.
+ * @note The block is only sent once the socket has room for all of it, so the send
+ *       never blocks, and the cycles measured are the ones spent on the copy.
+ */
+BaseType_t __analog_send_block(Socket_t xSocket, const analog_block_t *block)
+{
+    const uint16_t *samples = analog_blocks[block->index];
+    analog_stream_header_t header = {
+        .magic = ANALOG_STREAM_MAGIC,
+        .sequence = block->sequence,
+        .dropped = stream.dropped,
+        .scan_rate = stream.scan_rate,
+        .inputs = NUMBER_OF_ANALOG_INPUTS,
+        .encoding = stream.encoding,
+        .scans = ANALOG_BLOCK_SCANS,
+    };
+    const uint8_t *data = (const uint8_t *)samples;
+    uint32_t start = DWT->CYCCNT;
+
+    if (header.encoding == ANALOG_ENCODING_DELTA)
+    {
+        header.length = __analog_encode_delta(samples, send_buffer);
+        data = send_buffer;
+    }
+    else
+    {
+        header.length = ANALOG_BLOCK_SIZE * sizeof(uint16_t);
+    }
+
+    for (;;)
+    {
+        BaseType_t xSpace = FreeRTOS_tx_space(xSocket);
+        if (xSpace < 0)
+        {
+            return pdFAIL;
+        }
+        if ((size_t)xSpace >= sizeof(header) + header.length)
+        {
+            break;
+        }
+
+        // the socket is congested, the time waiting is not counted
+        taskENTER_CRITICAL();
+        stream_cycles += DWT->CYCCNT - start;
+        taskEXIT_CRITICAL();
+        vTaskDelay(pdMS_TO_TICKS(ANALOG_STREAM_RETRY_MS));
+        start = DWT->CYCCNT;
+    }
+
+    if (FreeRTOS_send(xSocket, &header, sizeof(header), 0) != sizeof(header)
+        || FreeRTOS_send(xSocket, data, header.length, 0) != header.length)
+    {
+        return pdFAIL;
+    }
+
+    taskENTER_CRITICAL();
+    stream_cycles += DWT->CYCCNT - start;
+    taskEXIT_CRITICAL();
+    stream_bytes += sizeof(header) + header.length;
+
+    return pdPASS;
+}
+
+// Encode the samples of a block as differences, see ANALOG_DELTA_ESCAPE
+uint16_t __analog_encode_delta(const uint16_t *samples, uint8_t *data)
+{
+    uint16_t previous[NUMBER_OF_ANALOG_INPUTS] = {0};
+    uint16_t len = 0;
+
+    for (uint16_t scan = 0; scan < ANALOG_BLOCK_SCANS; scan++)
+    {
+        for (uint8_t i = 0; i < NUMBER_OF_ANALOG_INPUTS; i++)
+        {
+            uint16_t sample = *samples++;
+            int32_t delta = (int32_t)sample - previous[i];
+
+            if (delta > -128 && delta < 128)
+            {
+                data[len++] = (uint8_t)delta;
+            }
+            else
+            {
+                data[len++] = ANALOG_DELTA_ESCAPE;
+                data[len++] = sample & 0xFF;
+                data[len++] = sample >> 8;
+            }
+            previous[i] = sample;
+        }
+    }
+
+    return len;
+}
+
+// Compute the throughput and the CPU usage once per period
+void __analog_update_stats(TickType_t *last_update)
+{
+    TickType_t now = xTaskGetTickCount();
+    uint32_t elapsed_ms = (now - *last_update) * portTICK_PERIOD_MS;
+    uint32_t cycles;
+
+    if (elapsed_ms < ANALOG_STREAM_STATS_PERIOD_MS)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    cycles = stream_cycles;
+    stream_cycles = 0;
+    taskEXIT_CRITICAL();
+
+    uint32_t bytes_per_second = (uint64_t)stream_bytes * 1000 / elapsed_ms;
+    uint32_t cpu_permille = (uint64_t)cycles * 1000 / ((uint64_t)SystemCoreClock / 1000 * elapsed_ms);
+
+    taskENTER_CRITICAL();
+    stream.bytes_per_second = bytes_per_second;
+    stream.cpu_permille = cpu_permille;
+    taskEXIT_CRITICAL();
+
+    stream_bytes = 0;
+    *last_update = now;
+}
+
+/**
+ * @brief Keep a completed block in the ring of the capture.
+ * @note The DMA continues with a free block, or with the oldest block of the ring
+ *       if none is free. Once the post-trigger scans are complete, the blocks before
+ *       the window are released, and the DMA writes its own two blocks again.
+ * @retval block for the idle memory register of the DMA
+ */
+uint8_t __analog_capture_block(uint8_t block, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    uint32_t base = capture_blocks++ * ANALOG_BLOCK_SCANS;
+    uint8_t next;
+
+    capture_ring[(capture_head + capture_count) % ANALOG_BLOCKS] = block;
+    capture_count++;
+    if (!__analog_take_block(&next))
+    {
+        next = __analog_capture_pop();
+    }
+
+    if (capture_state == ANALOG_CAPTURE_ARMED)
+    {
+        if (capture.trigger == ANALOG_TRIGGER_SLOPE)
+        {
+            __analog_find_slope(block, base);
+        }
+        else if (!trigger_enabled && capture_blocks * ANALOG_BLOCK_SCANS >= capture.pre_trigger)
+        {
+            // the trigger is only accepted once the pre-trigger scans are available
+            __analog_enable_trigger();
+        }
+    }
+
+    if (capture_state == ANALOG_CAPTURE_TRIGGERED
+        && capture_blocks * ANALOG_BLOCK_SCANS >= trigger_scan + capture.depth - capture.pre_trigger)
+    {
+        uint32_t first = (trigger_scan - capture.pre_trigger) / ANALOG_BLOCK_SCANS;
+        while (capture_first < first)
+        {
+            __analog_release_block(__analog_capture_pop());
+        }
+        capture_state = ANALOG_CAPTURE_DONE;
+
+        // wake the sender task to send the capture
+        if (streamClientConnected)
+        {
+            analog_block_t item = {.sequence = 0, .index = ANALOG_BLOCK_CAPTURE_DONE};
+            xQueueSendFromISR(blockQueue, &item, pxHigherPriorityTaskWoken);
+        }
+    }
+
+    return next;
+}
+
+// Remove the oldest block from the ring of the capture
+uint8_t __analog_capture_pop(void)
+{
+    uint8_t block = capture_ring[capture_head];
+
+    capture_head = (capture_head + 1) % ANALOG_BLOCKS;
+    capture_count--;
+    capture_first++;
+
+    return block;
+}
+
+/**
+ * @brief Arm the capture from the block being written.
+ * @note Called with the DMA interrupt masked, or from an interrupt at its priority.
+ *       The blocks of the ring are released.
+ */
+void __analog_capture_arm(void)
+{
+    __analog_disable_trigger();
+    while (capture_count > 0)
+    {
+        __analog_release_block(__analog_capture_pop());
+    }
+
+    capture_blocks = 0;
+    capture_first = 0;
+    trigger_scan = 0;
+
+    if (capture.trigger == ANALOG_TRIGGER_NONE)
+    {
+        capture_state = ANALOG_CAPTURE_TRIGGERED;
+    }
+    else
+    {
+        capture_state = ANALOG_CAPTURE_ARMED;
+        if (capture.pre_trigger == 0 && capture.trigger != ANALOG_TRIGGER_SLOPE)
+        {
+            __analog_enable_trigger();
+        }
+    }
+}
+
+// Drop the capture and release its blocks, called with the capture mutex held
+void __analog_capture_stop(void)
+{
+    taskENTER_CRITICAL();
+    __analog_disable_trigger();
+    capture_state = ANALOG_CAPTURE_IDLE;
+    while (capture_count > 0)
+    {
+        __analog_release_block(__analog_capture_pop());
+    }
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Scan a completed block for the slope.
+ * @note The change of the input from one scan to the next is compared with the
+ *       slope, a few cycles per scan. The first scan of the capture is skipped as
+ *       it has no predecessor.
+ */
+void __analog_find_slope(uint8_t block, uint32_t base)
+{
+    const uint16_t *samples = &analog_blocks[block][capture.source - ANALOG_INPUT_ID_OFFSET];
+    uint32_t first = (capture.pre_trigger > 0) ? capture.pre_trigger : 1;
+    int32_t previous = last_sample;
+    uint32_t i = 0;
+
+    // the trigger is only accepted once the pre-trigger scans are available
+    if (first > base)
+    {
+        i = first - base;
+        if (i >= ANALOG_BLOCK_SCANS)
+        {
+            last_sample = samples[(ANALOG_BLOCK_SCANS - 1) * NUMBER_OF_ANALOG_INPUTS];
+            return;
+        }
+        previous = samples[(i - 1) * NUMBER_OF_ANALOG_INPUTS];
+    }
+
+    for (; i < ANALOG_BLOCK_SCANS; i++)
+    {
+        int32_t sample = samples[i * NUMBER_OF_ANALOG_INPUTS];
+        int32_t delta = sample - previous;
+
+        if ((trigger_code > 0) ? (delta >= trigger_code) : (delta <= trigger_code))
+        {
+            break;
+        }
+        previous = sample;
+    }
+
+    last_sample = samples[(ANALOG_BLOCK_SCANS - 1) * NUMBER_OF_ANALOG_INPUTS];
+    if (i < ANALOG_BLOCK_SCANS)
+    {
+        trigger_scan = base + i;
+        capture_state = ANALOG_CAPTURE_TRIGGERED;
+    }
+}
+
+// Let the hardware watch for the trigger, the analog watchdog or the EXTI line
+void __analog_enable_trigger(void)
+{
+    trigger_enabled = true;
+
+    if (capture.trigger == ANALOG_TRIGGER_RISING || capture.trigger == ANALOG_TRIGGER_FALLING)
+    {
+        uint8_t channel = analog_channels[capture.source - ANALOG_INPUT_ID_OFFSET];
+
+        // a rising level is armed by a conversion below the level, and vice versa
+        watchdog_armed = false;
+        watchdog_above = (capture.trigger == ANALOG_TRIGGER_FALLING);
+        __analog_set_watchdog();
+
+        ADC1->SR = ~(uint32_t)ADC_SR_AWD;
+        MODIFY_REG(ADC1->CR1, ADC_CR1_AWDCH, (uint32_t)channel << ADC_CR1_AWDCH_Pos);
+        SET_BIT(ADC1->CR1, ADC_CR1_AWDSGL | ADC_CR1_AWDEN | ADC_CR1_AWDIE);
+    }
+    else if (capture.trigger == ANALOG_TRIGGER_DIGITAL_RISING || capture.trigger == ANALOG_TRIGGER_DIGITAL_FALLING)
+    {
+        uint16_t line = input_pins[capture.source].mask;
+
+        if (capture.trigger == ANALOG_TRIGGER_DIGITAL_RISING)
+        {
+            SET_BIT(EXTI->RTSR, line);
+        }
+        else
+        {
+            SET_BIT(EXTI->FTSR, line);
+        }
+
+        // an edge before now does not count
+        EXTI->PR = line;
+        SET_BIT(EXTI->IMR, line);
+    }
+}
+
+void __analog_disable_trigger(void)
+{
+    trigger_enabled = false;
+
+    CLEAR_BIT(ADC1->CR1, ADC_CR1_AWDEN | ADC_CR1_AWDIE);
+
+    if (capture.trigger == ANALOG_TRIGGER_DIGITAL_RISING || capture.trigger == ANALOG_TRIGGER_DIGITAL_FALLING)
+    {
+        uint16_t line = input_pins[capture.source].mask;
+
+        CLEAR_BIT(EXTI->IMR, line);
+        CLEAR_BIT(EXTI->RTSR, line);
+        CLEAR_BIT(EXTI->FTSR, line);
+    }
+}
+
+// Let the watchdog flag the conversions above the level, or below it
+void __analog_set_watchdog(void)
+{
+    if (watchdog_above)
+    {
+        ADC1->LTR = 0;
+        ADC1->HTR = trigger_code;
+    }
+    else
+    {
+        ADC1->LTR = trigger_code;
+        ADC1->HTR = ANALOG_FULL_SCALE_CODE;
+    }
+}
+
+// Take the latest scan as the trigger scan, called from the interrupt of the trigger
+void __analog_trigger(void)
+{
+    uint32_t scan;
+
+    if (capture_state != ANALOG_CAPTURE_ARMED)
+    {
+        return;
+    }
+
+    __analog_disable_trigger();
+
+    scan = __analog_latest_scan();
+    trigger_scan = (scan > capture.pre_trigger) ? scan : capture.pre_trigger;
+    capture_state = ANALOG_CAPTURE_TRIGGERED;
+}
+
+/**
+ * @brief Absolute index of the latest scan written by the DMA.
+ * @note Called at the priority of the DMA interrupt, so the count of the completed
+ *       blocks is stable, except for a block whose interrupt is pending. The interrupt
+ *       follows the conversion within a fraction of a scan at the highest scan rate,
+ *       so the scan is the one of the conversion to within one scan.
+ */
+uint32_t __analog_latest_scan(void)
+{
+    uint32_t flag = __HAL_DMA_GET_TC_FLAG_INDEX(hdma);
+    uint32_t pending, remaining, samples;
+
+    do
+    {
+        pending = __HAL_DMA_GET_FLAG(hdma, flag);
+        remaining = __HAL_DMA_GET_COUNTER(hdma);
+    } while (pending != __HAL_DMA_GET_FLAG(hdma, flag));
+
+    samples = (capture_blocks + (pending ? 1U : 0U)) * ANALOG_BLOCK_SIZE + ANALOG_BLOCK_SIZE - remaining;
+
+    return (samples > 0) ? (samples - 1) / NUMBER_OF_ANALOG_INPUTS : 0;
+}
+
+// Convert a level of an input in microvolts to the ADC code, the inverse of the calibration
+int32_t __analog_level_to_code(uint8_t input, int32_t level_uv)
+{
+    int64_t raw_uv = ((int64_t)level_uv - settings.analog_offset_uv[input]) * ANALOG_UNITY_GAIN / settings.analog_gain[input];
+
+    return (int32_t)(raw_uv * ANALOG_FULL_SCALE_CODE / ANALOG_REFERENCE_UV);
+}
+
+// Convert a slope of an input in microvolts per millisecond to ADC codes per scan, at least one code
+int32_t __analog_slope_to_code(uint8_t input, int32_t slope_uv, uint32_t scan_rate)
+{
+    int64_t uv_per_scan = (int64_t)slope_uv * 1000 / scan_rate;
+    int64_t code = uv_per_scan * ANALOG_UNITY_GAIN / settings.analog_gain[input] * ANALOG_FULL_SCALE_CODE / ANALOG_REFERENCE_UV;
+
+    if (code > ANALOG_FULL_SCALE_CODE)
+    {
+        return ANALOG_FULL_SCALE_CODE;
+    }
+    if (code < -ANALOG_FULL_SCALE_CODE)
+    {
+        return -ANALOG_FULL_SCALE_CODE;
+    }
+    if (code == 0)
+    {
+        return (slope_uv < 0) ? -1 : 1;
+    }
+
+    return (int32_t)code;
+}
+
+/**
+ * @brief Send the capture, then release it and return to the default rate.
+ * @note The window is sent straight from the blocks of the ring. If the client
+ *       disconnects in between, the capture is kept for the next client.
+ */
+BaseType_t __analog_send_capture(Socket_t xSocket)
+{
+    BaseType_t result = pdPASS;
+
+    xSemaphoreTake(captureMutex, portMAX_DELAY);
+    if (capture_state == ANALOG_CAPTURE_DONE)
+    {
+        uint32_t first = (trigger_scan - capture.pre_trigger) * NUMBER_OF_ANALOG_INPUTS;
+        uint32_t count = capture.depth * NUMBER_OF_ANALOG_INPUTS;
+        analog_capture_header_t header = {
+            .magic = ANALOG_CAPTURE_MAGIC,
+            .scan_rate = capture.scan_rate,
+            .scans = capture.depth,
+            .pre_trigger = capture.pre_trigger,
+            .inputs = NUMBER_OF_ANALOG_INPUTS,
+            .trigger = capture.trigger,
+            .source = capture.source,
+        };
+
+        result = __analog_send_all(xSocket, (const uint8_t *)&header, sizeof(header));
+
+        // the window may begin and end anywhere in a block
+        while (result == pdPASS && count > 0)
+        {
+            uint32_t offset = first % ANALOG_BLOCK_SIZE;
+            uint32_t len = ANALOG_BLOCK_SIZE - offset;
+            uint8_t block = capture_ring[(capture_head + first / ANALOG_BLOCK_SIZE - capture_first) % ANALOG_BLOCKS];
+
+            if (len > count)
+            {
+                len = count;
+            }
+
+            result = __analog_send_all(xSocket, (const uint8_t *)&analog_blocks[block][offset], len * sizeof(uint16_t));
+            first += len;
+            count -= len;
+        }
+
+        if (result == pdPASS)
+        {
+            __analog_capture_stop();
+            __analog_restart(ANALOG_SCAN_RATE);
+        }
+    }
+    xSemaphoreGive(captureMutex);
+
+    return result;
+}
+
+BaseType_t __analog_send_all(Socket_t xSocket, const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        BaseType_t bytesSent = FreeRTOS_send(xSocket, data, len, 0);
+        if (bytesSent < 0)
+        {
+            return pdFAIL;
+        }
+
+        data += bytesSent;
+        len -= bytesSent;
+    }
+
+    return pdPASS;
+}
@@ -0,0 +1,426 @@
+#include "stm32f7xx_remote_io.h"
+
+static analog_output_channel_t channels[NUMBER_OF_ANALOG_OUTPUTS] UTILS_DMA_BUFFER; // the buffers are played by the DMA
+static SemaphoreHandle_t outputMutex; // held while a channel is reconfigured
+
+// TSELx of the channels in DAC->CR, TIM4_TRGO for channel 1 and TIM5_TRGO for channel 2
+static const uint32_t trigger_selections[NUMBER_OF_ANALOG_OUTPUTS] = {0x5U, 0x3U};
+
+// tables played by the DMA, in 12-bit codes
+static uint16_t tables[NUMBER_OF_ANALOG_OUTPUTS][ANALOG_OUTPUT_TABLE_SIZE] UTILS_DMA_BUFFER;
+
+// first quarter of a sine turn in Q15, 64 steps and the peak
+static const int16_t quarter_sine[65] = {
+    0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+    6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767,
+};
+
+_Static_assert(NUMBER_OF_ANALOG_OUTPUTS == 2, "the DAC has two channels");
+_Static_assert(ANALOG_OUTPUT_RAMP_CHUNK <= ANALOG_OUTPUT_SHAPE_CHUNK, "a ramp exceeds the buffer");
+
+/* Function Prototype */
+void __analog_output_stop(analog_output_channel_t *channel);
+void __analog_output_run(analog_output_channel_t *channel);
+uint32_t __analog_output_configure_timer(TIM_HandleTypeDef *htim, uint32_t rate);
+void __analog_output_fill(analog_output_channel_t *channel, uint16_t *samples);
+int32_t __analog_output_shape(analog_output_mode_t mode, uint32_t phase);
+int32_t __analog_output_sine(uint32_t phase);
+int32_t __analog_output_sine_step(uint32_t index);
+int32_t __analog_output_uv_to_code(int32_t value_uv);
+void __analog_output_update_step(analog_output_channel_t *channel, uint32_t slew_rate);
+analog_output_channel_t *__analog_output_channel(DMA_HandleTypeDef *_hdma);
+void __analog_output_half_complete_callback(DMA_HandleTypeDef *_hdma);
+void __analog_output_complete_callback(DMA_HandleTypeDef *_hdma);
+
+/**
+ * @brief Initialize the DAC outputs at 0 V.
+ * @note The DAC is driven at register level and triggered by the TRGO of the timers,
+ *       which must be configured to output their update event.
+ */
+void analog_output_init(TIM_HandleTypeDef *htim_1, DMA_HandleTypeDef *hdma_1,
+                        TIM_HandleTypeDef *htim_2, DMA_HandleTypeDef *hdma_2)
+{
+    outputMutex = xSemaphoreCreateMutex();
+    configASSERT(outputMutex != NULL);
+
+    channels[0].htim = htim_1;
+    channels[0].hdma = hdma_1;
+    channels[0].dhr = &DAC->DHR12R1;
+    channels[0].dor = &DAC->DOR1;
+    channels[0].shift = 0;
+
+    channels[1].htim = htim_2;
+    channels[1].hdma = hdma_2;
+    channels[1].dhr = &DAC->DHR12R2;
+    channels[1].dor = &DAC->DOR2;
+    channels[1].shift = 16;
+
+    __HAL_RCC_DAC_CLK_ENABLE();
+
+    for (uint8_t i = 0; i < NUMBER_OF_ANALOG_OUTPUTS; i++)
+    {
+        analog_output_channel_t *channel = &channels[i];
+        DMA_HandleTypeDef *hdma = channel->hdma;
+
+        // memory to peripheral, one half word per update
+        hdma->Init.Direction = DMA_MEMORY_TO_PERIPH;
+        hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+        hdma->Init.MemInc = DMA_MINC_ENABLE;
+        hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+        hdma->Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+        hdma->Init.Mode = DMA_CIRCULAR;
+        hdma->Init.Priority = DMA_PRIORITY_MEDIUM;
+        hdma->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+        if (HAL_DMA_Init(hdma) != HAL_OK)
+        {
+            Error_Handler();
+        }
+
+        // the callbacks compute the half of the buffer which has just been played
+        hdma->XferHalfCpltCallback = __analog_output_half_complete_callback;
+        hdma->XferCpltCallback = __analog_output_complete_callback;
+        hdma->XferErrorCallback = NULL;
+
+        if (settings.analog_slew_rate[i] > ANALOG_OUTPUT_MAX_SLEW_RATE)
+        {
+            settings.analog_slew_rate[i] = 0;
+        }
+        __analog_output_update_step(channel, settings.analog_slew_rate[i]);
+
+        channel->config.mode = ANALOG_OUTPUT_LEVEL;
+        channel->code = 0;
+        channel->target = 0;
+        __analog_output_run(channel);
+    }
+}
+
+/**
+ * @brief Ramp an analog output to a setpoint at its slew rate.
+ * @note A shape or a table being played stops, and the ramp starts from the value
+ *       being output.
+ */
+HAL_StatusTypeDef analog_output_write(uint8_t output, int32_t value_uv)
+{
+    if (output >= NUMBER_OF_ANALOG_OUTPUTS || value_uv < 0 || value_uv > ANALOG_REFERENCE_UV)
+    {
+        return HAL_ERROR;
+    }
+
+    analog_output_channel_t *channel = &channels[output];
+    int32_t target = __analog_output_uv_to_code(value_uv) << 16;
+
+    xSemaphoreTake(outputMutex, portMAX_DELAY);
+    if (channel->config.mode == ANALOG_OUTPUT_LEVEL)
+    {
+        // the interrupt picks up the new setpoint at its next chunk
+        channel->target = target;
+    }
+    else
+    {
+        __analog_output_stop(channel);
+        channel->config.mode = ANALOG_OUTPUT_LEVEL;
+        channel->code = (int32_t)(*channel->dor << 16);
+        channel->target = target;
+        __analog_output_run(channel);
+    }
+    xSemaphoreGive(outputMutex);
+
+    return HAL_OK;
+}
+
+// Read the value being output in microvolts
+int32_t analog_output_read(uint8_t output)
+{
+    return (int32_t)((*channels[output].dor * (uint64_t)ANALOG_REFERENCE_UV + ANALOG_FULL_SCALE_CODE / 2) / ANALOG_FULL_SCALE_CODE);
+}
+
+/**
+ * @brief Start generating a shape or playing the table on an analog output.
+ * @note ANALOG_OUTPUT_LEVEL holds the value being output. The achieved rate of the
+ *       table is returned in the config.
+ */
+HAL_StatusTypeDef analog_output_start(uint8_t output, analog_output_config_t *config)
+{
+    if (output >= NUMBER_OF_ANALOG_OUTPUTS || config->mode > ANALOG_OUTPUT_TABLE)
+    {
+        return HAL_ERROR;
+    }
+
+    if (config->mode == ANALOG_OUTPUT_TABLE)
+    {
+        if (config->rate < ANALOG_OUTPUT_MIN_TABLE_RATE || config->rate > ANALOG_OUTPUT_MAX_TABLE_RATE
+            || config->length == 0 || config->length > ANALOG_OUTPUT_TABLE_SIZE)
+        {
+            return HAL_ERROR;
+        }
+    }
+    else if (config->mode != ANALOG_OUTPUT_LEVEL)
+    {
+        if (config->frequency_mhz < ANALOG_OUTPUT_MIN_FREQUENCY_MHZ || config->frequency_mhz > ANALOG_OUTPUT_MAX_FREQUENCY_MHZ
+            || config->amplitude_uv < 0 || config->amplitude_uv > ANALOG_REFERENCE_UV
+            || config->offset_uv < 0 || config->offset_uv > ANALOG_REFERENCE_UV)
+        {
+            return HAL_ERROR;
+        }
+    }
+
+    analog_output_channel_t *channel = &channels[output];
+
+    xSemaphoreTake(outputMutex, portMAX_DELAY);
+    __analog_output_stop(channel);
+
+    channel->config = *config;
+    channel->code = (int32_t)(*channel->dor << 16);
+    channel->target = channel->code;
+    channel->phase = 0;
+    channel->phase_step = (uint32_t)(((uint64_t)config->frequency_mhz << 32) / (ANALOG_OUTPUT_SHAPE_RATE * 1000ULL));
+    channel->amplitude = __analog_output_uv_to_code(config->amplitude_uv);
+    channel->offset = __analog_output_uv_to_code(config->offset_uv);
+
+    __analog_output_run(channel);
+    config->rate = channel->config.rate;
+    xSemaphoreGive(outputMutex);
+
+    return HAL_OK;
+}
+
+void analog_output_get_config(uint8_t output, analog_output_config_t *config)
+{
+    xSemaphoreTake(outputMutex, portMAX_DELAY);
+    *config = channels[output].config;
+    xSemaphoreGive(outputMutex);
+}
+
+// Write a sample of the table, which takes effect at once if the table is playing
+HAL_StatusTypeDef analog_output_write_table(uint8_t output, uint16_t index, uint16_t code)
+{
+    if (output >= NUMBER_OF_ANALOG_OUTPUTS || index >= ANALOG_OUTPUT_TABLE_SIZE || code > ANALOG_FULL_SCALE_CODE)
+    {
+        return HAL_ERROR;
+    }
+
+    tables[output][index] = code;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef analog_output_set_slew_rate(uint8_t output, uint32_t slew_rate)
+{
+    if (output >= NUMBER_OF_ANALOG_OUTPUTS || slew_rate > ANALOG_OUTPUT_MAX_SLEW_RATE)
+    {
+        return HAL_ERROR;
+    }
+
+    settings.analog_slew_rate[output] = slew_rate;
+    __analog_output_update_step(&channels[output], slew_rate);
+
+    return HAL_OK;
+}
+
+// Stop the updates of a channel, the output holds its value
+void __analog_output_stop(analog_output_channel_t *channel)
+{
+    __HAL_TIM_DISABLE(channel->htim);
+    CLEAR_BIT(DAC->CR, DAC_CR_DMAEN1 << channel->shift);
+    HAL_DMA_Abort(channel->hdma);
+}
+
+/**
+ * @brief Start the updates of a channel in its mode.
+ * @note A ramp or a shape fills both halves of the buffer before the start, then
+ *       one half per interrupt while the DMA plays the other one.
+ */
+void __analog_output_run(analog_output_channel_t *channel)
+{
+    uint8_t output = channel - channels;
+    const uint16_t *samples = channel->buffer;
+    uint32_t length;
+
+    if (channel->config.mode == ANALOG_OUTPUT_TABLE)
+    {
+        samples = tables[output];
+        length = channel->config.length;
+        channel->config.rate = __analog_output_configure_timer(channel->htim, channel->config.rate);
+    }
+    else
+    {
+        bool ramp = (channel->config.mode == ANALOG_OUTPUT_LEVEL);
+
+        channel->chunk = ramp ? ANALOG_OUTPUT_RAMP_CHUNK : ANALOG_OUTPUT_SHAPE_CHUNK;
+        length = 2 * channel->chunk;
+        channel->config.rate = __analog_output_configure_timer(channel->htim, ramp ? ANALOG_OUTPUT_RAMP_RATE : ANALOG_OUTPUT_SHAPE_RATE);
+
+        __analog_output_fill(channel, channel->buffer);
+        __analog_output_fill(channel, channel->buffer + channel->chunk);
+    }
+
+    // a table needs no interrupt, it is played as it is
+    HAL_StatusTypeDef status = (channel->config.mode == ANALOG_OUTPUT_TABLE)
+        ? HAL_DMA_Start(channel->hdma, (uint32_t)samples, (uint32_t)channel->dhr, length)
+        : HAL_DMA_Start_IT(channel->hdma, (uint32_t)samples, (uint32_t)channel->dhr, length);
+    if (status != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    // a conversion at every rising edge of the TRGO of the timer, with the output buffer
+    MODIFY_REG(DAC->CR,
+               (DAC_CR_TSEL1 | DAC_CR_TEN1 | DAC_CR_DMAEN1 | DAC_CR_BOFF1 | DAC_CR_EN1) << channel->shift,
+               ((trigger_selections[output] << DAC_CR_TSEL1_Pos) | DAC_CR_TEN1 | DAC_CR_DMAEN1 | DAC_CR_EN1) << channel->shift);
+
+    __HAL_TIM_SET_COUNTER(channel->htim, 0);
+    __HAL_TIM_ENABLE(channel->htim);
+}
+
+// Configure the update rate of a timer, return the achieved rate
+uint32_t __analog_output_configure_timer(TIM_HandleTypeDef *htim, uint32_t rate)
+{
+    uint32_t clock = utils_get_timer_clock(htim->Instance);
+    uint32_t ticks = clock / rate;
+    uint32_t prescaler = (ticks - 1) / 65536U;
+    uint32_t period = ticks / (prescaler + 1);
+
+    __HAL_TIM_SET_PRESCALER(htim, prescaler);
+    __HAL_TIM_SET_AUTORELOAD(htim, period - 1);
+
+    // load the prescaler now instead of at the next update event
+    htim->Instance->EGR = TIM_EGR_UG;
+
+    return clock / ((prescaler + 1) * period);
+}
+
+/**
+ * @brief Compute the next chunk of a ramp or a shape.
+ * @note A ramp moves by the step per update until it reaches its setpoint. A shape
+ *       is looked up by its phase, which wraps around at a full turn.
+ */
+void __analog_output_fill(analog_output_channel_t *channel, uint16_t *samples)
+{
+    if (channel->config.mode == ANALOG_OUTPUT_LEVEL)
+    {
+        int32_t code = channel->code;
+        int32_t target = channel->target;
+        int32_t step = channel->step;
+
+        for (uint16_t i = 0; i < channel->chunk; i++)
+        {
+            int32_t error = target - code;
+
+            if (step == 0 || (error <= step && error >= -step))
+            {
+                code = target;
+            }
+            else
+            {
+                code += (error > 0) ? step : -step;
+            }
+            samples[i] = (code + 0x8000) >> 16;
+        }
+
+        channel->code = code;
+    }
+    else
+    {
+        uint32_t phase = channel->phase;
+
+        for (uint16_t i = 0; i < channel->chunk; i++)
+        {
+            int32_t code = channel->offset + ((channel->amplitude * __analog_output_shape(channel->config.mode, phase)) >> 15);
+
+            if (code < 0)
+            {
+                code = 0;
+            }
+            else if (code > ANALOG_FULL_SCALE_CODE)
+            {
+                code = ANALOG_FULL_SCALE_CODE;
+            }
+            samples[i] = code;
+            phase += channel->phase_step;
+        }
+
+        channel->phase = phase;
+    }
+}
+
+// Value of a shape at a phase in Q15, each shape starts at 0 rising
+int32_t __analog_output_shape(analog_output_mode_t mode, uint32_t phase)
+{
+    switch (mode)
+    {
+    case ANALOG_OUTPUT_SINE:
+        return __analog_output_sine(phase);
+
+    case ANALOG_OUTPUT_TRIANGLE:
+        phase += 0x40000000U;
+        return (int32_t)(((phase < 0x80000000U) ? phase : ~phase) >> 15) - 32768;
+
+    default:
+        return (phase < 0x80000000U) ? 32767 : -32767;
+    }
+}
+
+// Sine of a phase in Q15, interpolated between the 256 steps of a turn
+int32_t __analog_output_sine(uint32_t phase)
+{
+    uint32_t index = phase >> 24;
+    int32_t fraction = (phase >> 8) & 0xFFFF;
+    int32_t a = __analog_output_sine_step(index);
+    int32_t b = __analog_output_sine_step((index + 1) & 0xFF);
+
+    return a + (((b - a) * fraction) >> 16);
+}
+
+// Sine of a step of a turn in Q15, from the quarter by symmetry
+int32_t __analog_output_sine_step(uint32_t index)
+{
+    uint32_t i = index & 63;
+
+    switch (index >> 6)
+    {
+    case 0:
+        return quarter_sine[i];
+    case 1:
+        return quarter_sine[64 - i];
+    case 2:
+        return -quarter_sine[i];
+    default:
+        return -quarter_sine[64 - i];
+    }
+}
+
+int32_t __analog_output_uv_to_code(int32_t value_uv)
+{
+    return (int32_t)(((int64_t)value_uv * ANALOG_FULL_SCALE_CODE + ANALOG_REFERENCE_UV / 2) / ANALOG_REFERENCE_UV);
+}
+
+// Convert the slew rate to the change of a ramp per update, at least the smallest change
+void __analog_output_update_step(analog_output_channel_t *channel, uint32_t slew_rate)
+{
+    int32_t step = (int32_t)((uint64_t)slew_rate * 1000U / ANALOG_OUTPUT_RAMP_RATE * ANALOG_FULL_SCALE_CODE * 65536U / ANALOG_REFERENCE_UV);
+
+    channel->step = (slew_rate != 0 && step == 0) ? 1 : step;
+}
+
+analog_output_channel_t *__analog_output_channel(DMA_HandleTypeDef *_hdma)
+{
+    return (_hdma == channels[0].hdma) ? &channels[0] : &channels[1];
+}
+
+void __analog_output_half_complete_callback(DMA_HandleTypeDef *_hdma)
+{
+    analog_output_channel_t *channel = __analog_output_channel(_hdma);
+    __analog_output_fill(channel, channel->buffer);
+}
+
+void __analog_output_complete_callback(DMA_HandleTypeDef *_hdma)
+{
+    analog_output_channel_t *channel = __analog_output_channel(_hdma);
+    __analog_output_fill(channel, channel->buffer + channel->chunk);
+}
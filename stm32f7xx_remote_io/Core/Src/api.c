@@ -2,61 +2,1747 @@
 
 Socket_t apiSocket;
 
-// API task handle
-TaskHandle_t apiTaskHandle;
+// ring buffer for received data
+uint8_t rxBuffer[API_RX_BUFFER_SIZE] UTILS_DTCM_DATA;
+uint8_t rxBufferHead = 0;
+uint8_t rxBufferTail = 0;
+
+// ring buffer for sending data, a value of a reply is formatted in place and may run past its end
+uint8_t txBuffer[API_TX_BUFFER_SIZE + API_VALUE_SIZE] UTILS_DTCM_DATA;
+uint8_t txBufferHead = 0;
+uint8_t txBufferTail = 0;
+
+// the command line being executed
+static char line[API_RX_BUFFER_SIZE + UTILS_READ_PADDING] UTILS_DTCM_DATA;
+
+// set if a command line did not fit in the rx buffer
+static bool rxOverflow = false;
+
+/* Function Prototype */
+void __api_execute_line(char *command_line);
+const api_function_t *__api_find_function(uint16_t id);
+void __api_transmit(const char *data, uint16_t len);
+void __api_flush(void);
+void __api_reserve(uint8_t len);
+void __api_commit(uint8_t len);
+void __api_reply_error(uint8_t error);
+void __api_skip_spaces(api_command_t *command);
+io_status_t __api_read_status(api_command_t *command);
+io_status_t __api_read_input(api_command_t *command);
+io_status_t __api_read_analog_input(api_command_t *command);
+io_status_t __api_read_analog_stream(api_command_t *command);
+io_status_t __api_write_analog_stream(api_command_t *command);
+io_status_t __api_read_analog_capture(api_command_t *command);
+io_status_t __api_write_analog_capture(api_command_t *command);
+io_status_t __api_read_analog_calibration(api_command_t *command);
+io_status_t __api_write_analog_calibration(api_command_t *command);
+io_status_t __api_read_analog_output(api_command_t *command);
+io_status_t __api_write_analog_output(api_command_t *command);
+io_status_t __api_read_analog_waveform(api_command_t *command);
+io_status_t __api_write_analog_waveform(api_command_t *command);
+io_status_t __api_write_analog_table(api_command_t *command);
+io_status_t __api_read_boot_time(api_command_t *command);
+io_status_t __api_read_firmware(api_command_t *command);
+io_status_t __api_read_analog_slew_rate(api_command_t *command);
+io_status_t __api_write_analog_slew_rate(api_command_t *command);
+io_status_t __api_read_analog_output_pin(api_command_t *command, uint8_t *output);
+void __api_reply_analog_waveform(analog_output_config_t *config);
+io_status_t __api_read_subscription(api_command_t *command);
+io_status_t __api_write_subscription(api_command_t *command);
+io_status_t __api_read_output(api_command_t *command);
+io_status_t __api_write_output(api_command_t *command);
+io_status_t __api_read_serial(api_command_t *command);
+io_status_t __api_write_serial(api_command_t *command);
+io_status_t __api_write_serial_transaction(api_command_t *command);
+io_status_t __api_read_transaction_timeout(api_command_t *command);
+io_status_t __api_read_modbus_poll(api_command_t *command);
+io_status_t __api_write_modbus_poll(api_command_t *command);
+io_status_t __api_read_modbus_image(api_command_t *command);
+io_status_t __api_read_modbus_stats(api_command_t *command);
+io_status_t __api_read_modbus_setting(api_command_t *command);
+io_status_t __api_write_modbus_setting(api_command_t *command);
+io_status_t __api_write_transaction_timeout(api_command_t *command);
+io_status_t __api_read_output_masked(api_command_t *command);
+io_status_t __api_write_output_masked(api_command_t *command);
+io_status_t __api_read_logic_capture(api_command_t *command);
+io_status_t __api_write_logic_capture(api_command_t *command);
+io_status_t __api_read_sequence(api_command_t *command);
+io_status_t __api_write_sequence(api_command_t *command);
+io_status_t __api_read_sequence_playback(api_command_t *command);
+io_status_t __api_write_sequence_playback(api_command_t *command);
+io_status_t __api_read_network_setting(api_command_t *command);
+io_status_t __api_write_network_setting(api_command_t *command);
+io_status_t __api_read_serial_setting(api_command_t *command);
+io_status_t __api_write_serial_setting(api_command_t *command);
+io_status_t __api_read_led_count(api_command_t *command);
+io_status_t __api_write_led_count(api_command_t *command);
+io_status_t __api_read_debounce_period(api_command_t *command);
+io_status_t __api_write_debounce_period(api_command_t *command);
+io_status_t __api_read_debounce_time(api_command_t *command);
+io_status_t __api_write_debounce_time(api_command_t *command);
+
+// table of the supported functions
+static const api_function_t api_functions[] = {
+    {API_ID_STATUS, __api_read_status, NULL},
+    {API_ID_INPUT, __api_read_input, NULL},
+    {API_ID_OUTPUT, __api_read_output, __api_write_output},
+    {API_ID_SUBSCRIBE, __api_read_subscription, __api_write_subscription},
+    {API_ID_SERIAL, __api_read_serial, __api_write_serial},
+    {API_ID_ANALOG_INPUT, __api_read_analog_input, NULL},
+    {API_ID_ANALOG_OUTPUT, __api_read_analog_output, __api_write_analog_output},
+    {API_ID_LOGIC_CAPTURE, __api_read_logic_capture, __api_write_logic_capture},
+    {API_ID_SEQUENCE, __api_read_sequence, __api_write_sequence},
+    {API_ID_SEQUENCE_PLAYBACK, __api_read_sequence_playback, __api_write_sequence_playback},
+    {API_ID_OUTPUT_MASKED, __api_read_output_masked, __api_write_output_masked},
+    {API_ID_SERIAL_TRANSACTION, NULL, __api_write_serial_transaction},
+    {API_ID_MODBUS_POLL, __api_read_modbus_poll, __api_write_modbus_poll},
+    {API_ID_MODBUS_IMAGE, __api_read_modbus_image, NULL},
+    {API_ID_MODBUS_STATS, __api_read_modbus_stats, NULL},
+    {API_ID_ANALOG_STREAM, __api_read_analog_stream, __api_write_analog_stream},
+    {API_ID_ANALOG_CAPTURE, __api_read_analog_capture, __api_write_analog_capture},
+    {API_ID_ANALOG_WAVEFORM, __api_read_analog_waveform, __api_write_analog_waveform},
+    {API_ID_ANALOG_TABLE, NULL, __api_write_analog_table},
+    {API_ID_BOOT_TIME, __api_read_boot_time, NULL},
+    {API_ID_FIRMWARE, __api_read_firmware, NULL},
+    {API_ID_IP_ADDRESS, __api_read_network_setting, __api_write_network_setting},
+    {API_ID_TCP_PORT, __api_read_network_setting, __api_write_network_setting},
+    {API_ID_NETMASK, __api_read_network_setting, __api_write_network_setting},
+    {API_ID_GATEWAY, __api_read_network_setting, __api_write_network_setting},
+    {API_ID_SERIAL_BAUD_RATE, __api_read_serial_setting, __api_write_serial_setting},
+    {API_ID_SERIAL_DATA_BITS, __api_read_serial_setting, __api_write_serial_setting},
+    {API_ID_SERIAL_PARITY, __api_read_serial_setting, __api_write_serial_setting},
+    {API_ID_SERIAL_STOP_BITS, __api_read_serial_setting, __api_write_serial_setting},
+    {API_ID_SERIAL_FLOW_CONTROL, __api_read_serial_setting, __api_write_serial_setting},
+    {API_ID_WS28XX_LED_COUNT, __api_read_led_count, __api_write_led_count},
+    {API_ID_DEBOUNCE_PERIOD, __api_read_debounce_period, __api_write_debounce_period},
+    {API_ID_DEBOUNCE_TIME, __api_read_debounce_time, __api_write_debounce_time},
+    {API_ID_SERIAL_HIGH_WATERMARK, __api_read_serial_setting, __api_write_serial_setting},
+    {API_ID_SERIAL_LOW_WATERMARK, __api_read_serial_setting, __api_write_serial_setting},
+    {API_ID_SERIAL_FRAME_MODE, __api_read_serial_setting, __api_write_serial_setting},
+    {API_ID_SERIAL_FRAME_DELIMITER, __api_read_serial_setting, __api_write_serial_setting},
+    {API_ID_SERIAL_FRAME_LENGTH, __api_read_serial_setting, __api_write_serial_setting},
+    {API_ID_SERIAL_FRAME_TIMEOUT, __api_read_serial_setting, __api_write_serial_setting},
+    {API_ID_SERIAL_TRANSACTION_TIMEOUT, __api_read_transaction_timeout, __api_write_transaction_timeout},
+    {API_ID_MODBUS_BAUD_RATE, __api_read_modbus_setting, __api_write_modbus_setting},
+    {API_ID_MODBUS_PARITY, __api_read_modbus_setting, __api_write_modbus_setting},
+    {API_ID_MODBUS_TIMEOUT, __api_read_modbus_setting, __api_write_modbus_setting},
+    {API_ID_ANALOG_CALIBRATION, __api_read_analog_calibration, __api_write_analog_calibration},
+    {API_ID_ANALOG_SLEW_RATE, __api_read_analog_slew_rate, __api_write_analog_slew_rate},
+};
+
+// initialize API for a new connection
+void api_init(Socket_t socket)
+{
+    // initialize socket
+    apiSocket = socket;
+
+    // drop anything left from the previous connection
+    rxBufferHead = rxBufferTail = 0;
+    txBufferHead = txBufferTail = 0;
+    rxOverflow = false;
+}
+
+/**
+ * @brief Process data received from the client.
+ * @note Data is accumulated in the rx buffer until a line terminator is received,
+ *       then the line is executed and the reply is sent back through the socket.
+ */
+UTILS_ITCM_CODE void api_process_data(char *rx_data, BaseType_t len, Socket_t socket)
+{
+    apiSocket = socket;
+
+    // process received data stored in buffer
+    for (BaseType_t i = 0; i < len; i++)
+    {
+        // read data from buffer
+        char charReceived = rx_data[i];
+
+        if (charReceived != '\n' && charReceived != '\r')
+        {
+            // append data to buffer
+            if (api_append_data((uint8_t *)&charReceived, 1) != STATUS_OK)
+            {
+                rxOverflow = true;
+            }
+            continue;
+        }
+
+        // skip empty lines, e.g. the '\n' of "\r\n"
+        if (api_is_rx_buffer_empty() == STATUS_OK && !rxOverflow)
+        {
+            continue;
+        }
+
+        // move the line out of the ring buffer
+        uint8_t lineLength = 0;
+        while (api_is_rx_buffer_empty() != STATUS_OK)
+        {
+            line[lineLength++] = rxBuffer[rxBufferTail];
+            api_increment_rx_buffer_tail();
+        }
+        line[lineLength] = '\0';
+
+        if (rxOverflow)
+        {
+            // the line is incomplete, reply with the command code only
+            rxOverflow = false;
+            __api_transmit(line, 3);
+            __api_reply_error(API_ERROR_FORMAT);
+            __api_transmit("\r\n", 2);
+            continue;
+        }
+
+        __api_execute_line(line);
+    }
+
+    __api_flush();
+}
+
+// Read an unsigned integer argument of the command, a fraction is rejected unless it is 0
+io_status_t api_read_uint(api_command_t *command, uint32_t *value)
+{
+    __api_skip_spaces(command);
+    if (!utils_read_uint(command->line, &command->char_counter, value, UINT32_MAX))
+    {
+        return STATUS_FAIL;
+    }
+
+    return STATUS_OK;
+}
+
+// Read a decimal argument of the command in millionths, e.g. volts as microvolts
+io_status_t api_read_micro(api_command_t *command, int32_t *value)
+{
+    __api_skip_spaces(command);
+    if (!utils_read_decimal(command->line, &command->char_counter, value, 6))
+    {
+        return STATUS_FAIL;
+    }
+
+    return STATUS_OK;
+}
+
+// Read a decimal argument of the command in thousandths, e.g. hertz as millihertz
+io_status_t api_read_milli(api_command_t *command, int32_t *value)
+{
+    __api_skip_spaces(command);
+    if (!utils_read_decimal(command->line, &command->char_counter, value, 3))
+    {
+        return STATUS_FAIL;
+    }
+
+    return STATUS_OK;
+}
+
+// Read a decimal argument of the command as Q16.16
+io_status_t api_read_q16(api_command_t *command, int32_t *value)
+{
+    __api_skip_spaces(command);
+    if (!utils_read_q16(command->line, &command->char_counter, value))
+    {
+        return STATUS_FAIL;
+    }
+
+    return STATUS_OK;
+}
+
+// Read the unsigned integer arguments left in the command in one pass, returns how many were read
+uint8_t api_read_uint_list(api_command_t *command, uint32_t *values, uint8_t size)
+{
+    return utils_read_uint_list(command->line, &command->char_counter, values, size, UINT32_MAX);
+}
+
+// Check if there is any argument left in the command
+bool api_has_argument(api_command_t *command)
+{
+    __api_skip_spaces(command);
+    return command->line[command->char_counter] != '\0';
+}
+
+/**
+ * @brief Append an unsigned integer to the reply of the command being executed, e.g. " 255"
+ * @note Like the other values of a reply, it is formatted straight into the tx buffer.
+ */
+void api_reply_uint(uint32_t value)
+{
+    __api_reserve(API_VALUE_SIZE);
+    char *ptr = (char *)&txBuffer[txBufferHead];
+    ptr[0] = ' ';
+    __api_commit(1 + utils_format_uint(ptr + 1, value, 1));
+}
+
+// Append a signed integer to the reply of the command being executed, e.g. " -1"
+void api_reply_int(int32_t value)
+{
+    __api_reserve(API_VALUE_SIZE);
+    char *ptr = (char *)&txBuffer[txBufferHead];
+    ptr[0] = ' ';
+    __api_commit(1 + utils_format_decimal(ptr + 1, value, 0));
+}
+
+// Append a value in units of 10^-decimals with all its decimals, e.g. 1650250 with 6 decimals as " 1.650250"
+void api_reply_decimal(int32_t value, uint8_t decimals)
+{
+    __api_reserve(API_VALUE_SIZE);
+    char *ptr = (char *)&txBuffer[txBufferHead];
+    ptr[0] = ' ';
+    __api_commit(1 + utils_format_decimal(ptr + 1, value, decimals));
+}
+
+// Append text as it is to the reply of the command being executed, e.g. a unit
+void api_reply_text(const char *text)
+{
+    __api_transmit(text, strlen(text));
+}
+
+UTILS_ITCM_CODE void __api_execute_line(char *command_line)
+{
+    api_command_t command = {.line = command_line, .char_counter = 0};
+    uint32_t id = 0;
+    io_status_t status = STATUS_FAIL;
+    uint8_t error = API_ERROR_UNSUPPORTED;
+    uint8_t replyStart = txBufferHead;
+
+    __api_skip_spaces(&command);
+    command.line += command.char_counter;
+    command.char_counter = 1;
+    command.type = command.line[0];
+
+    // the command code, e.g. "R02", is read as an integer right after the type
+    if ((command.type == 'R' || command.type == 'W')
+        && command.line[1] >= '0' && command.line[1] <= '9'
+        && api_read_uint(&command, &id) == STATUS_OK)
+    {
+        command.id = id;
+
+        const api_function_t *function = __api_find_function(command.id);
+        api_handler_t handler = NULL;
+        if (function != NULL)
+        {
+            handler = (command.type == 'R') ? function->read : function->write;
+        }
+
+        if (handler != NULL)
+        {
+            // echo the command code, the handler appends its values once it succeeds
+            __api_reserve(command.char_counter);
+            replyStart = txBufferHead;
+            __api_transmit(command.line, command.char_counter);
+
+            status = handler(&command);
+            error = (status == STATUS_ERROR) ? API_ERROR_HARD_FAULT : API_ERROR_FORMAT;
+
+            if (status == STATUS_OK && command.type == 'W' && command.id >= API_ID_SETTINGS_BASE)
+            {
+                settings_save();
+            }
+        }
+    }
+
+    if (status != STATUS_OK)
+    {
+        // echo the command code followed by the error code
+        uint8_t codeLength = 0;
+        while (command.line[codeLength] != '\0' && command.line[codeLength] != ' ')
+        {
+            codeLength++;
+        }
+
+        // take the echo back, nothing else is replied by a handler which fails
+        txBufferHead = replyStart;
+        __api_transmit(command.line, codeLength);
+        __api_reply_error(error);
+    }
+
+    __api_transmit("\r\n", 2);
+}
+
+UTILS_ITCM_CODE const api_function_t *__api_find_function(uint16_t id)
+{
+    for (uint8_t i = 0; i < sizeof(api_functions) / sizeof(api_functions[0]); i++)
+    {
+        if (api_functions[i].id == id)
+        {
+            return &api_functions[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Queue data in the tx buffer, flush the buffer to the socket whenever it is full
+UTILS_ITCM_CODE void __api_transmit(const char *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++)
+    {
+        if (api_is_tx_buffer_full() == STATUS_OK)
+        {
+            __api_flush();
+        }
+
+        txBuffer[txBufferHead] = data[i];
+        api_increment_tx_buffer_head();
+    }
+}
+
+// Send all data in the tx buffer
+void __api_flush(void)
+{
+    while (api_is_tx_buffer_empty() != STATUS_OK)
+    {
+        // send the contiguous part of the ring buffer
+        uint8_t end = (txBufferHead > txBufferTail) ? txBufferHead : API_TX_BUFFER_SIZE;
+        BaseType_t bytesSent = FreeRTOS_send(apiSocket, &txBuffer[txBufferTail], end - txBufferTail, 0);
+
+        if (bytesSent < 0)
+        {
+            // the connection is gone, drop the data
+            txBufferHead = txBufferTail = 0;
+            return;
+        }
+
+        txBufferTail = (txBufferTail + bytesSent) % API_TX_BUFFER_SIZE;
+    }
+}
+
+// Make room for len bytes in the tx buffer, flushing it to the socket if needed
+void __api_reserve(uint8_t len)
+{
+    uint8_t free = (txBufferTail + API_TX_BUFFER_SIZE - txBufferHead - 1) % API_TX_BUFFER_SIZE;
+
+    if (free < len)
+    {
+        __api_flush();
+    }
+}
+
+// Take len bytes formatted in place at the head, moving the part past the end to the start
+void __api_commit(uint8_t len)
+{
+    uint16_t end = txBufferHead + len;
+
+    if (end >= API_TX_BUFFER_SIZE)
+    {
+        end -= API_TX_BUFFER_SIZE;
+        memcpy(txBuffer, &txBuffer[API_TX_BUFFER_SIZE], end);
+    }
+
+    txBufferHead = end;
+}
+
+// Append an error code to the reply, e.g. " ERR02"
+void __api_reply_error(uint8_t error)
+{
+    __api_reserve(API_VALUE_SIZE);
+    char *ptr = (char *)&txBuffer[txBufferHead];
+    memcpy(ptr, " ERR", 4);
+    __api_commit(4 + utils_format_uint(ptr + 4, error, 2));
+}
+
+void __api_skip_spaces(api_command_t *command)
+{
+    while (command->line[command->char_counter] == ' ')
+    {
+        command->char_counter++;
+    }
+}
+
+/* Handlers of functions */
+
+// R01
+io_status_t __api_read_status(api_command_t *command)
+{
+    return STATUS_OK;
+}
+
+// R02, R02 [PIN]
+io_status_t __api_read_input(api_command_t *command)
+{
+    uint32_t pin;
+
+    if (!api_has_argument(command))
+    {
+        for (uint8_t i = 0; i < NUMBER_OF_INPUTS; i++)
+        {
+            api_reply_int(debounce_read_input(i));
+        }
+        return STATUS_OK;
+    }
+
+    if (api_read_uint(command, &pin) != STATUS_OK || pin >= NUMBER_OF_INPUTS)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(pin);
+    api_reply_int(debounce_read_input(pin));
+    return STATUS_OK;
+}
+
+// R03, R03 [PIN]
+io_status_t __api_read_output(api_command_t *command)
+{
+    uint32_t pin;
+
+    if (!api_has_argument(command))
+    {
+        uint32_t outputs = output_read_all();
+        for (uint8_t i = 0; i < NUMBER_OF_OUTPUTS; i++)
+        {
+            api_reply_uint((outputs >> i) & 1);
+        }
+        return STATUS_OK;
+    }
+
+    if (api_read_uint(command, &pin) != STATUS_OK || pin >= NUMBER_OF_OUTPUTS)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(pin);
+    api_reply_int(output_read(pin));
+    return STATUS_OK;
+}
+
+// W03 [PIN] [VALUE]
+io_status_t __api_write_output(api_command_t *command)
+{
+    uint32_t pin, value;
+
+    if (api_read_uint(command, &pin) != STATUS_OK || api_read_uint(command, &value) != STATUS_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    if (pin >= NUMBER_OF_OUTPUTS || value > 1 || output_write(pin, value) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(pin);
+    api_reply_uint(value);
+    return STATUS_OK;
+}
+
+// R04, R04 [PIN]
+io_status_t __api_read_subscription(api_command_t *command)
+{
+    subscription_config_t config;
+    uint32_t pin;
+
+    if (!api_has_argument(command))
+    {
+        uint32_t pins[SUBSCRIPTION_SLOTS];
+        uint32_t count = subscription_list(pins);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            api_reply_uint(pins[i]);
+        }
+        return STATUS_OK;
+    }
+
+    if (api_read_uint(command, &pin) != STATUS_OK || !subscription_get(pin, &config))
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(pin);
+    api_reply_decimal(config.deadband, 6);
+    if (config.percent)
+    {
+        api_reply_text("%");
+    }
+    api_reply_uint(config.min_interval_ms);
+    api_reply_uint(config.max_interval_ms);
+    return STATUS_OK;
+}
+
+// W04, W04 [PIN] [DEADBAND] [MIN_INTERVAL] [MAX_INTERVAL]
+io_status_t __api_write_subscription(api_command_t *command)
+{
+    subscription_config_t config = {0};
+    uint32_t pin;
+    int32_t deadband = 0;
+
+    if (!api_has_argument(command))
+    {
+        subscription_clear();
+        return STATUS_OK;
+    }
+
+    if (api_read_uint(command, &pin) != STATUS_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    // the deadband is in volts, or in percent of the full scale if it ends with '%'
+    if (api_has_argument(command))
+    {
+        if (api_read_micro(command, &deadband) != STATUS_OK)
+        {
+            return STATUS_FAIL;
+        }
+        if (command->line[command->char_counter] == '%')
+        {
+            config.percent = true;
+            command->char_counter++;
+        }
+    }
+
+    if ((api_has_argument(command) && api_read_uint(command, &config.min_interval_ms) != STATUS_OK)
+        || (api_has_argument(command) && api_read_uint(command, &config.max_interval_ms) != STATUS_OK))
+    {
+        return STATUS_FAIL;
+    }
+
+    if (deadband < 0)
+    {
+        return STATUS_FAIL;
+    }
+    config.deadband = deadband;
+
+    if (subscription_set(pin, &config) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(pin);
+    api_reply_decimal(config.deadband, 6);
+    if (config.percent)
+    {
+        api_reply_text("%");
+    }
+    api_reply_uint(config.min_interval_ms);
+    api_reply_uint(config.max_interval_ms);
+    return STATUS_OK;
+}
+
+// R05
+io_status_t __api_read_serial(api_command_t *command)
+{
+    serial_stats_t stats;
+
+    serial_get_stats(&stats);
+    api_reply_uint(stats.rx_bytes);
+    api_reply_uint(stats.tx_bytes);
+    api_reply_uint(stats.rx_events);
+    api_reply_uint(stats.rx_dropped);
+    api_reply_uint(stats.overruns);
+    api_reply_uint(stats.isr_cycles);
+    api_reply_uint(stats.tx_stalls);
+    api_reply_uint(stats.rts_throttles);
+    api_reply_uint(stats.frames);
+    api_reply_uint(stats.frame_errors);
+    return STATUS_OK;
+}
+
+// W05 [MSG]
+io_status_t __api_write_serial(api_command_t *command)
+{
+    // the message is the rest of the line after the separating space
+    if (command->line[command->char_counter] == ' ')
+    {
+        command->char_counter++;
+    }
+
+    // the message is sent later by the transaction task, the queue is full if it fails
+    if (transaction_submit(false, 0, &command->line[command->char_counter]) != HAL_OK)
+    {
+        return STATUS_ERROR;
+    }
+
+    return STATUS_OK;
+}
+
+// W13 [TAG] [MSG]
+io_status_t __api_write_serial_transaction(api_command_t *command)
+{
+    uint32_t tag;
+
+    if (api_read_uint(command, &tag) != STATUS_OK || command->line[command->char_counter] != ' ')
+    {
+        return STATUS_FAIL;
+    }
+
+    // the response is reported later as W13 [TAG] [RESPONSE], or W13 [TAG] ERR04
+    if (transaction_submit(true, tag, &command->line[command->char_counter + 1]) != HAL_OK)
+    {
+        return STATUS_ERROR;
+    }
+
+    api_reply_uint(tag);
+    return STATUS_OK;
+}
+
+// R12
+io_status_t __api_read_output_masked(api_command_t *command)
+{
+    api_reply_uint(output_read_all());
+    return STATUS_OK;
+}
+
+// W12 [MASK] [VALUE]
+io_status_t __api_write_output_masked(api_command_t *command)
+{
+    uint32_t mask, value;
+
+    if (api_read_uint(command, &mask) != STATUS_OK || api_read_uint(command, &value) != STATUS_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    if (output_write_masked(mask, value) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(mask);
+    api_reply_uint(value & mask);
+    return STATUS_OK;
+}
+
+// R09
+io_status_t __api_read_logic_capture(api_command_t *command)
+{
+    api_reply_uint(logic_capture_get_state());
+    api_reply_uint(logic_capture_get_length());
+    return STATUS_OK;
+}
+
+// W09 [PORT] [RATE] [DEPTH] [PRE_TRIGGER] [TRIGGER] [MASK] [VALUE], or W09 to abort
+io_status_t __api_write_logic_capture(api_command_t *command)
+{
+    logic_capture_config_t config = {.trigger = LOGIC_CAPTURE_TRIGGER_NONE};
+    uint32_t value;
+
+    if (!api_has_argument(command))
+    {
+        logic_capture_abort();
+        return STATUS_OK;
+    }
+
+    if (api_read_uint(command, &value) != STATUS_OK) return STATUS_FAIL;
+    config.port = value;
+    if (api_read_uint(command, &config.sample_rate) != STATUS_OK) return STATUS_FAIL;
+    if (api_read_uint(command, &config.depth) != STATUS_OK) return STATUS_FAIL;
+    if (api_read_uint(command, &config.pre_trigger) != STATUS_OK) return STATUS_FAIL;
+
+    // the trigger is optional, capture starts immediately without it
+    if (api_has_argument(command))
+    {
+        if (api_read_uint(command, &value) != STATUS_OK) return STATUS_FAIL;
+        config.trigger = value;
+        if (api_read_uint(command, &value) != STATUS_OK) return STATUS_FAIL;
+        config.mask = value;
+        if (api_has_argument(command))
+        {
+            if (api_read_uint(command, &value) != STATUS_OK) return STATUS_FAIL;
+            config.value = value;
+        }
+    }
+
+    if (logic_capture_start(&config) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(config.port);
+    api_reply_uint(config.sample_rate);
+    api_reply_uint(config.depth);
+    api_reply_uint(config.pre_trigger);
+    api_reply_uint(config.trigger);
+    api_reply_uint(config.mask);
+    api_reply_uint(config.value);
+    return STATUS_OK;
+}
+
+// R10 [INDEX]
+io_status_t __api_read_sequence(api_command_t *command)
+{
+    sequence_entry_t entry;
+    uint32_t index;
+
+    if (api_read_uint(command, &index) != STATUS_OK || index > UINT16_MAX)
+    {
+        return STATUS_FAIL;
+    }
+
+    if (sequence_get_entry(index, &entry) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(index);
+    api_reply_uint(entry.outputs);
+    api_reply_uint(entry.set);
+    api_reply_uint(entry.delay_us);
+    return STATUS_OK;
+}
+
+// W10 [INDEX] [OUTPUTS] [SET] [DELAY_US]
+io_status_t __api_write_sequence(api_command_t *command)
+{
+    sequence_entry_t entry;
+    uint32_t index, outputs, set, delay;
+
+    if (api_read_uint(command, &index) != STATUS_OK || api_read_uint(command, &outputs) != STATUS_OK ||
+        api_read_uint(command, &set) != STATUS_OK || api_read_uint(command, &delay) != STATUS_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    if (index > UINT16_MAX || outputs > UINT16_MAX || set > 1 || delay > UINT16_MAX)
+    {
+        return STATUS_FAIL;
+    }
+
+    entry.outputs = outputs;
+    entry.set = set;
+    entry.delay_us = delay;
+
+    if (sequence_set_entry(index, &entry) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(index);
+    api_reply_uint(outputs);
+    api_reply_uint(set);
+    api_reply_uint(delay);
+    return STATUS_OK;
+}
+
+// R11
+io_status_t __api_read_sequence_playback(api_command_t *command)
+{
+    api_reply_uint(sequence_get_state());
+    api_reply_uint(sequence_get_cycles());
+    return STATUS_OK;
+}
+
+// W11 [LENGTH] [MODE], or W11 to stop
+io_status_t __api_write_sequence_playback(api_command_t *command)
+{
+    uint32_t length, mode = 0;
+
+    if (!api_has_argument(command))
+    {
+        sequence_stop();
+        return STATUS_OK;
+    }
+
+    if (api_read_uint(command, &length) != STATUS_OK || length > UINT16_MAX)
+    {
+        return STATUS_FAIL;
+    }
+
+    if (api_has_argument(command) && (api_read_uint(command, &mode) != STATUS_OK || mode > UINT8_MAX))
+    {
+        return STATUS_FAIL;
+    }
+
+    if (sequence_start(length, mode) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(length);
+    api_reply_uint(mode);
+    return STATUS_OK;
+}
+
+// R101 ~ R104
+io_status_t __api_read_network_setting(api_command_t *command)
+{
+    uint8_t *address;
+
+    switch (command->id)
+    {
+    case API_ID_TCP_PORT:
+        api_reply_uint(LISTENING_PORT + settings.tcp_port);
+        return STATUS_OK;
+    case API_ID_NETMASK:
+        address = &settings.netmask_0;
+        break;
+    case API_ID_GATEWAY:
+        address = &settings.gateway_0;
+        break;
+    default:
+        address = &settings.ip_address_0;
+        break;
+    }
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        api_reply_uint(address[i]);
+    }
+    return STATUS_OK;
+}
+
+// W101 [A] [B] [C] [D], W102 [PORT], W103 [A] [B] [C] [D], W104 [A] [B] [C] [D]
+io_status_t __api_write_network_setting(api_command_t *command)
+{
+    uint32_t values[4];
+    uint8_t *address;
+
+    if (command->id == API_ID_TCP_PORT)
+    {
+        if (api_read_uint(command, &values[0]) != STATUS_OK
+            || values[0] < LISTENING_PORT || values[0] > LISTENING_PORT + UINT8_MAX)
+        {
+            return STATUS_FAIL;
+        }
+
+        // the listeners move to the new port, the connected clients stay
+        settings.tcp_port = values[0] - LISTENING_PORT;
+        tcp_server_configure_port();
+
+        api_reply_uint(values[0]);
+        return STATUS_OK;
+    }
+
+    if (api_read_uint_list(command, values, 4) != 4 || api_has_argument(command))
+    {
+        return STATUS_FAIL;
+    }
+
+    switch (command->id)
+    {
+    case API_ID_NETMASK:
+        address = &settings.netmask_0;
+        break;
+    case API_ID_GATEWAY:
+        address = &settings.gateway_0;
+        break;
+    default:
+        address = &settings.ip_address_0;
+        break;
+    }
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        if (values[i] > UINT8_MAX)
+        {
+            return STATUS_FAIL;
+        }
+    }
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        address[i] = values[i];
+        api_reply_uint(values[i]);
+    }
+
+    // applied once this reply has been sent, which ends the connection
+    tcp_server_configure_address();
+    return STATUS_OK;
+}
+
+// R105 ~ R109, R114 ~ R119
+io_status_t __api_read_serial_setting(api_command_t *command)
+{
+    uint32_t value;
+
+    switch (command->id)
+    {
+    case API_ID_SERIAL_BAUD_RATE:
+        value = settings.serial_baud_rate;
+        break;
+    case API_ID_SERIAL_DATA_BITS:
+        value = settings.serial_data_bits;
+        break;
+    case API_ID_SERIAL_PARITY:
+        value = settings.serial_parity;
+        break;
+    case API_ID_SERIAL_STOP_BITS:
+        value = settings.serial_stop_bits;
+        break;
+    case API_ID_SERIAL_HIGH_WATERMARK:
+        value = settings.serial_high_watermark;
+        break;
+    case API_ID_SERIAL_LOW_WATERMARK:
+        value = settings.serial_low_watermark;
+        break;
+    case API_ID_SERIAL_FRAME_MODE:
+        value = settings.serial_frame_mode;
+        break;
+    case API_ID_SERIAL_FRAME_DELIMITER:
+        value = settings.serial_frame_delimiter;
+        break;
+    case API_ID_SERIAL_FRAME_LENGTH:
+        value = settings.serial_frame_length;
+        break;
+    case API_ID_SERIAL_FRAME_TIMEOUT:
+        value = settings.serial_frame_timeout_us;
+        break;
+    default:
+        value = settings.serial_flow_control;
+        break;
+    }
+
+    api_reply_uint(value);
+    return STATUS_OK;
+}
+
+// W105 [BAUD_RATE], W106 [DATA_BITS], W107 [PARITY], W108 [STOP_BITS], W109 [FLOW_CONTROL],
+// W114 [HIGH_WATERMARK], W115 [LOW_WATERMARK], W116 [FRAME_MODE], W117 [DELIMITER],
+// W118 [FRAME_LENGTH], W119 [FRAME_TIMEOUT_US]
+io_status_t __api_write_serial_setting(api_command_t *command)
+{
+    settings_t previous = settings;
+    uint32_t value;
+    uint32_t max = UINT8_MAX;
+
+    if (command->id == API_ID_SERIAL_BAUD_RATE || command->id == API_ID_SERIAL_FRAME_TIMEOUT)
+    {
+        max = UINT32_MAX;
+    }
+    else if (command->id == API_ID_SERIAL_FRAME_LENGTH)
+    {
+        max = UINT16_MAX;
+    }
+
+    if (api_read_uint(command, &value) != STATUS_OK || value > max)
+    {
+        return STATUS_FAIL;
+    }
+
+    switch (command->id)
+    {
+    case API_ID_SERIAL_BAUD_RATE:
+        settings.serial_baud_rate = value;
+        break;
+    case API_ID_SERIAL_DATA_BITS:
+        settings.serial_data_bits = value;
+        break;
+    case API_ID_SERIAL_PARITY:
+        settings.serial_parity = value;
+        break;
+    case API_ID_SERIAL_STOP_BITS:
+        settings.serial_stop_bits = value;
+        break;
+    case API_ID_SERIAL_HIGH_WATERMARK:
+        settings.serial_high_watermark = value;
+        break;
+    case API_ID_SERIAL_LOW_WATERMARK:
+        settings.serial_low_watermark = value;
+        break;
+    case API_ID_SERIAL_FRAME_MODE:
+        settings.serial_frame_mode = value;
+        break;
+    case API_ID_SERIAL_FRAME_DELIMITER:
+        settings.serial_frame_delimiter = value;
+        break;
+    case API_ID_SERIAL_FRAME_LENGTH:
+        settings.serial_frame_length = value;
+        break;
+    case API_ID_SERIAL_FRAME_TIMEOUT:
+        settings.serial_frame_timeout_us = value;
+        break;
+    default:
+        settings.serial_flow_control = (value != 0);
+        break;
+    }
+
+    // the new line parameters take effect immediately, the previous ones are kept if invalid
+    if (serial_configure() != HAL_OK)
+    {
+        settings = previous;
+        serial_configure();
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(value);
+    return STATUS_OK;
+}
+
+// R110
+io_status_t __api_read_led_count(api_command_t *command)
+{
+    api_reply_uint(settings.ws28xx_led_count);
+    return STATUS_OK;
+}
+
+// W110 [COUNT]
+io_status_t __api_write_led_count(api_command_t *command)
+{
+    uint32_t count;
+
+    if (api_read_uint(command, &count) != STATUS_OK || count > UINT16_MAX
+        || ws28xx_pwm_set_led_count(count) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    settings.ws28xx_led_count = count;
+
+    api_reply_uint(count);
+    return STATUS_OK;
+}
+
+// R14 [INDEX]
+io_status_t __api_read_modbus_poll(api_command_t *command)
+{
+    modbus_poll_t poll;
+    uint32_t index;
+
+    if (api_read_uint(command, &index) != STATUS_OK || index > UINT8_MAX
+        || modbus_get_poll(index, &poll) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(index);
+    api_reply_uint(poll.slave);
+    api_reply_uint(poll.function);
+    api_reply_uint(poll.address);
+    api_reply_uint(poll.count);
+    api_reply_uint(poll.offset);
+    return STATUS_OK;
+}
+
+// W14 [INDEX] [SLAVE] [FUNCTION] [ADDRESS] [COUNT] [OFFSET], W14 [INDEX] 0
+io_status_t __api_write_modbus_poll(api_command_t *command)
+{
+    modbus_poll_t poll = {0};
+    uint32_t index, slave, function = 0, address = 0, count = 0, offset = 0;
+
+    if (api_read_uint(command, &index) != STATUS_OK || api_read_uint(command, &slave) != STATUS_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    // the rest is not needed to disable the entry
+    if (slave != 0
+        && (api_read_uint(command, &function) != STATUS_OK || api_read_uint(command, &address) != STATUS_OK
+            || api_read_uint(command, &count) != STATUS_OK || api_read_uint(command, &offset) != STATUS_OK))
+    {
+        return STATUS_FAIL;
+    }
+
+    if (index > UINT8_MAX || slave > UINT8_MAX || function > UINT8_MAX
+        || address > UINT16_MAX || count > UINT16_MAX || offset > UINT16_MAX)
+    {
+        return STATUS_FAIL;
+    }
+
+    poll.slave = slave;
+    poll.function = function;
+    poll.address = address;
+    poll.count = count;
+    poll.offset = offset;
+
+    if (modbus_set_poll(index, &poll) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(index);
+    api_reply_uint(slave);
+    api_reply_uint(function);
+    api_reply_uint(address);
+    api_reply_uint(count);
+    api_reply_uint(offset);
+    return STATUS_OK;
+}
+
+// R15 [OFFSET] [COUNT]
+io_status_t __api_read_modbus_image(api_command_t *command)
+{
+    static uint16_t values[MODBUS_MAX_READ];
+    uint32_t offset, count;
+
+    if (api_read_uint(command, &offset) != STATUS_OK || api_read_uint(command, &count) != STATUS_OK
+        || offset > UINT16_MAX || count > UINT16_MAX
+        || modbus_read_image(offset, count, values) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(offset);
+    for (uint16_t i = 0; i < count; i++)
+    {
+        api_reply_uint(values[i]);
+    }
+
+    return STATUS_OK;
+}
+
+// R16 [SLAVE]
+io_status_t __api_read_modbus_stats(api_command_t *command)
+{
+    modbus_stats_t stats;
+    uint32_t slave;
+
+    if (api_read_uint(command, &slave) != STATUS_OK || slave > UINT8_MAX
+        || modbus_get_stats(slave, &stats) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(slave);
+    api_reply_uint(stats.cycle_us);
+    api_reply_uint(stats.polls);
+    api_reply_uint(stats.timeouts);
+    api_reply_uint(stats.errors);
+    api_reply_uint(stats.exceptions);
+    return STATUS_OK;
+}
+
+// R121 ~ R123
+io_status_t __api_read_modbus_setting(api_command_t *command)
+{
+    uint32_t value;
 
-// ring buffer for received data
-uint8_t rxBuffer[API_RX_BUFFER_SIZE];
-uint8_t rxBufferHead = 0;
-uint8_t rxBufferTail = 0;
+    switch (command->id)
+    {
+    case API_ID_MODBUS_BAUD_RATE:
+        value = settings.modbus_baud_rate;
+        break;
+    case API_ID_MODBUS_PARITY:
+        value = settings.modbus_parity;
+        break;
+    default:
+        value = settings.modbus_timeout_ms;
+        break;
+    }
 
-// ring buffer for sending data
-uint8_t txBuffer[API_TX_BUFFER_SIZE];
-uint8_t txBufferHead = 0;
-uint8_t txBufferTail = 0;
+    api_reply_uint(value);
+    return STATUS_OK;
+}
 
-// initialize API task
-void api_init(Socket_t socket)
+// W121 [BAUD_RATE], W122 [PARITY], W123 [TIMEOUT_MS]
+io_status_t __api_write_modbus_setting(api_command_t *command)
 {
-    // initialize socket
-    apiSocket = socket;
+    settings_t previous = settings;
+    uint32_t value;
+
+    if (api_read_uint(command, &value) != STATUS_OK || value > SERIAL_MAX_BAUD_RATE)
+    {
+        return STATUS_FAIL;
+    }
+
+    switch (command->id)
+    {
+    case API_ID_MODBUS_BAUD_RATE:
+        settings.modbus_baud_rate = value;
+        break;
+    case API_ID_MODBUS_PARITY:
+        settings.modbus_parity = (value <= UINT8_MAX) ? value : UINT8_MAX;
+        break;
+    default:
+        settings.modbus_timeout_ms = (value <= UINT16_MAX) ? value : UINT16_MAX;
+        break;
+    }
+
+    // the previous line parameters are kept if the new ones are invalid
+    if (modbus_configure() != HAL_OK)
+    {
+        settings = previous;
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(value);
+    return STATUS_OK;
 }
 
-void api_task(void *parameters)
+// R120
+io_status_t __api_read_transaction_timeout(api_command_t *command)
 {
-    // process received data stored in buffer
-    for (BaseType_t i = 0; i < len; i++)
+    api_reply_uint(settings.serial_transaction_timeout_ms);
+    return STATUS_OK;
+}
+
+// W120 [TIMEOUT_MS]
+io_status_t __api_write_transaction_timeout(api_command_t *command)
+{
+    uint32_t timeout;
+
+    if (api_read_uint(command, &timeout) != STATUS_OK
+        || timeout < TRANSACTION_MIN_TIMEOUT_MS || timeout > TRANSACTION_MAX_TIMEOUT_MS)
     {
-        // read data from buffer
-        char charReceived = rx_data[i];
+        return STATUS_FAIL;
+    }
 
-        if (charReceived == '\n'
-            || charReceived == '\r'
-            || charReceived <= ' ') 
-            {
+    settings.serial_transaction_timeout_ms = timeout;
+    api_reply_uint(timeout);
+    return STATUS_OK;
+}
 
-            }
-        else continue;
+// R112
+io_status_t __api_read_debounce_period(api_command_t *command)
+{
+    api_reply_uint(debounce_get_period());
+    return STATUS_OK;
+}
+
+// W112 [PERIOD_US]
+io_status_t __api_write_debounce_period(api_command_t *command)
+{
+    uint32_t period;
+
+    if (api_read_uint(command, &period) != STATUS_OK || period > UINT16_MAX)
+    {
+        return STATUS_FAIL;
+    }
+
+    if (debounce_set_period(period) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(period);
+    return STATUS_OK;
+}
+
+// R113 [PIN]
+io_status_t __api_read_debounce_time(api_command_t *command)
+{
+    uint32_t pin;
+
+    if (api_read_uint(command, &pin) != STATUS_OK || pin >= NUMBER_OF_INPUTS)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(pin);
+    api_reply_uint(settings.debounce_time_ms[pin]);
+    return STATUS_OK;
+}
+
+// W113 [PIN] [TIME_MS]
+io_status_t __api_write_debounce_time(api_command_t *command)
+{
+    uint32_t pin, time;
+
+    if (api_read_uint(command, &pin) != STATUS_OK || api_read_uint(command, &time) != STATUS_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    if (pin >= NUMBER_OF_INPUTS || time > UINT8_MAX || debounce_set_time(pin, time) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(pin);
+    api_reply_uint(time);
+    return STATUS_OK;
+}
+
+// R07, R07 [PIN]
+io_status_t __api_read_analog_input(api_command_t *command)
+{
+    uint32_t pin;
+
+    if (!api_has_argument(command))
+    {
+        for (uint8_t i = 0; i < NUMBER_OF_ANALOG_INPUTS; i++)
+        {
+            api_reply_decimal(analog_read(i), 6);
+        }
+        return STATUS_OK;
+    }
+
+    if (api_read_uint(command, &pin) != STATUS_OK || pin < ANALOG_INPUT_ID_OFFSET
+        || pin >= ANALOG_INPUT_ID_OFFSET + NUMBER_OF_ANALOG_INPUTS)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(pin);
+    api_reply_decimal(analog_read(pin - ANALOG_INPUT_ID_OFFSET), 6);
+    return STATUS_OK;
+}
+
+// R17
+io_status_t __api_read_analog_stream(api_command_t *command)
+{
+    analog_stream_stats_t stats;
+
+    analog_stream_get_stats(&stats);
+    api_reply_uint(stats.scan_rate);
+    api_reply_uint(stats.encoding);
+    api_reply_uint(stats.blocks);
+    api_reply_uint(stats.dropped);
+    api_reply_uint(stats.bytes_per_second);
+    api_reply_uint(stats.cpu_permille);
+    return STATUS_OK;
+}
+
+// W17, W17 [RATE] [ENCODING]
+io_status_t __api_write_analog_stream(api_command_t *command)
+{
+    analog_stream_stats_t stats;
+    uint32_t rate, encoding = ANALOG_ENCODING_RAW;
+
+    if (!api_has_argument(command))
+    {
+        analog_stream_stop();
+        return STATUS_OK;
+    }
+
+    if (api_read_uint(command, &rate) != STATUS_OK
+        || (api_has_argument(command) && api_read_uint(command, &encoding) != STATUS_OK))
+    {
+        return STATUS_FAIL;
+    }
+
+    if (rate == 0)
+    {
+        analog_stream_stop();
+        return STATUS_OK;
+    }
+
+    if (encoding > ANALOG_ENCODING_DELTA || analog_stream_start(rate, encoding) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    // reply the achieved rate
+    analog_stream_get_stats(&stats);
+    api_reply_uint(stats.scan_rate);
+    api_reply_uint(encoding);
+    return STATUS_OK;
+}
+
+// R18
+io_status_t __api_read_analog_capture(api_command_t *command)
+{
+    api_reply_uint(analog_capture_get_state());
+    api_reply_uint(analog_capture_get_length());
+    return STATUS_OK;
+}
+
+// W18 [RATE] [DEPTH] [PRE_TRIGGER] [TRIGGER] [SOURCE] [LEVEL], or W18 to abort
+io_status_t __api_write_analog_capture(api_command_t *command)
+{
+    analog_capture_config_t config = {.trigger = ANALOG_TRIGGER_NONE};
+    uint32_t value;
+
+    if (!api_has_argument(command))
+    {
+        analog_capture_abort();
+        return STATUS_OK;
+    }
+
+    if (api_read_uint(command, &config.scan_rate) != STATUS_OK) return STATUS_FAIL;
+    if (api_read_uint(command, &config.depth) != STATUS_OK) return STATUS_FAIL;
+    if (api_read_uint(command, &config.pre_trigger) != STATUS_OK) return STATUS_FAIL;
+
+    // the trigger is optional, capture starts immediately without it
+    if (api_has_argument(command))
+    {
+        if (api_read_uint(command, &value) != STATUS_OK) return STATUS_FAIL;
+        config.trigger = value;
+        if (api_read_uint(command, &value) != STATUS_OK || value > UINT8_MAX) return STATUS_FAIL;
+        config.source = value;
+        if (api_has_argument(command) && api_read_micro(command, &config.level_uv) != STATUS_OK) return STATUS_FAIL;
+    }
+
+    if (config.level_uv < -ANALOG_MAX_LEVEL_UV || config.level_uv > ANALOG_MAX_LEVEL_UV)
+    {
+        return STATUS_FAIL;
+    }
+
+    if (analog_capture_start(&config) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(config.scan_rate);
+    api_reply_uint(config.depth);
+    api_reply_uint(config.pre_trigger);
+    api_reply_uint(config.trigger);
+    api_reply_uint(config.source);
+    api_reply_decimal(config.level_uv, 6);
+    return STATUS_OK;
+}
 
-        switch (charReceived)
+// R124 [PIN]
+io_status_t __api_read_analog_calibration(api_command_t *command)
+{
+    uint32_t pin;
+
+    if (api_read_uint(command, &pin) != STATUS_OK || pin < ANALOG_INPUT_ID_OFFSET
+        || pin >= ANALOG_INPUT_ID_OFFSET + NUMBER_OF_ANALOG_INPUTS)
+    {
+        return STATUS_FAIL;
+    }
+
+    uint8_t input = pin - ANALOG_INPUT_ID_OFFSET;
+    api_reply_uint(pin);
+    api_reply_decimal((int64_t)settings.analog_gain[input] * 1000000 / ANALOG_UNITY_GAIN, 6);
+    api_reply_decimal(settings.analog_offset_uv[input], 6);
+    return STATUS_OK;
+}
+
+// W124 [PIN] [GAIN] [OFFSET]
+io_status_t __api_write_analog_calibration(api_command_t *command)
+{
+    uint32_t pin;
+    int32_t gain_q16, offset_uv;
+
+    if (api_read_uint(command, &pin) != STATUS_OK || api_read_q16(command, &gain_q16) != STATUS_OK
+        || api_read_micro(command, &offset_uv) != STATUS_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    if (pin < ANALOG_INPUT_ID_OFFSET || pin >= ANALOG_INPUT_ID_OFFSET + NUMBER_OF_ANALOG_INPUTS
+        || gain_q16 <= 0 || gain_q16 > ANALOG_MAX_GAIN
+        || offset_uv < -ANALOG_MAX_OFFSET_UV || offset_uv > ANALOG_MAX_OFFSET_UV)
+    {
+        return STATUS_FAIL;
+    }
+
+    uint8_t input = pin - ANALOG_INPUT_ID_OFFSET;
+
+    if (analog_set_calibration(input, gain_q16, offset_uv) != HAL_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    api_reply_uint(pin);
+    api_reply_decimal((int64_t)gain_q16 * 1000000 / ANALOG_UNITY_GAIN, 6);
+    api_reply_decimal(offset_uv, 6);
+    return STATUS_OK;
+}
+
+// Read the pin ID of an analog output, replied by the handler once it succeeds
+io_status_t __api_read_analog_output_pin(api_command_t *command, uint8_t *output)
+{
+    uint32_t pin;
+
+    if (api_read_uint(command, &pin) != STATUS_OK || pin < ANALOG_OUTPUT_ID_OFFSET
+        || pin >= ANALOG_OUTPUT_ID_OFFSET + NUMBER_OF_ANALOG_OUTPUTS)
+    {
+        return STATUS_FAIL;
+    }
+
+    *output = pin - ANALOG_OUTPUT_ID_OFFSET;
+    return STATUS_OK;
+}
+
+// R08, R08 [PIN]
+io_status_t __api_read_analog_output(api_command_t *command)
+{
+    uint8_t output;
+
+    if (!api_has_argument(command))
+    {
+        for (uint8_t i = 0; i < NUMBER_OF_ANALOG_OUTPUTS; i++)
+        {
+            api_reply_decimal(analog_output_read(i), 6);
+        }
+        return STATUS_OK;
+    }
+
+    if (__api_read_analog_output_pin(command, &output) != STATUS_OK) return STATUS_FAIL;
+
+    api_reply_uint(output + ANALOG_OUTPUT_ID_OFFSET);
+    api_reply_decimal(analog_output_read(output), 6);
+    return STATUS_OK;
+}
+
+// W08 [PIN] [VALUE]
+io_status_t __api_write_analog_output(api_command_t *command)
+{
+    uint8_t output;
+    int32_t value_uv;
+
+    if (__api_read_analog_output_pin(command, &output) != STATUS_OK
+        || api_read_micro(command, &value_uv) != STATUS_OK)
+    {
+        return STATUS_FAIL;
+    }
+
+    if (analog_output_write(output, value_uv) != HAL_OK) return STATUS_FAIL;
+
+    api_reply_uint(output + ANALOG_OUTPUT_ID_OFFSET);
+    api_reply_decimal(value_uv, 6);
+    return STATUS_OK;
+}
+
+// Append the mode of an analog output and its parameters
+void __api_reply_analog_waveform(analog_output_config_t *config)
+{
+    api_reply_uint(config->mode);
+    if (config->mode == ANALOG_OUTPUT_TABLE)
+    {
+        api_reply_uint(config->rate);
+        api_reply_uint(config->length);
+    }
+    else if (config->mode != ANALOG_OUTPUT_LEVEL)
+    {
+        api_reply_decimal(config->frequency_mhz, 3);
+        api_reply_decimal(config->amplitude_uv, 6);
+        api_reply_decimal(config->offset_uv, 6);
+    }
+}
+
+// R19 [PIN]
+io_status_t __api_read_analog_waveform(api_command_t *command)
+{
+    analog_output_config_t config;
+    uint8_t output;
+
+    if (__api_read_analog_output_pin(command, &output) != STATUS_OK) return STATUS_FAIL;
+
+    analog_output_get_config(output, &config);
+    api_reply_uint(output + ANALOG_OUTPUT_ID_OFFSET);
+    __api_reply_analog_waveform(&config);
+    return STATUS_OK;
+}
+
+// W19 [PIN] [MODE], W19 [PIN] [MODE] [FREQUENCY] [AMPLITUDE] [OFFSET], W19 [PIN] 4 [RATE] [LENGTH]
+io_status_t __api_write_analog_waveform(api_command_t *command)
+{
+    analog_output_config_t config = {0};
+    uint8_t output;
+    uint32_t mode;
+
+    if (__api_read_analog_output_pin(command, &output) != STATUS_OK
+        || api_read_uint(command, &mode) != STATUS_OK || mode > ANALOG_OUTPUT_TABLE)
+    {
+        return STATUS_FAIL;
+    }
+    config.mode = (analog_output_mode_t)mode;
+
+    if (config.mode == ANALOG_OUTPUT_TABLE)
+    {
+        uint32_t length;
+
+        if (api_read_uint(command, &config.rate) != STATUS_OK || api_read_uint(command, &length) != STATUS_OK
+            || length > ANALOG_OUTPUT_TABLE_SIZE)
+        {
+            return STATUS_FAIL;
+        }
+        config.length = length;
+    }
+    else if (config.mode != ANALOG_OUTPUT_LEVEL)
+    {
+        int32_t frequency_mhz;
+
+        if (api_read_milli(command, &frequency_mhz) != STATUS_OK || api_read_micro(command, &config.amplitude_uv) != STATUS_OK
+            || api_read_micro(command, &config.offset_uv) != STATUS_OK || frequency_mhz < 0)
+        {
+            return STATUS_FAIL;
+        }
+
+        // the rest of the range is checked by analog_output_start()
+        config.frequency_mhz = frequency_mhz;
+    }
+
+    if (analog_output_start(output, &config) != HAL_OK) return STATUS_FAIL;
+
+    // the rate of a table is echoed as achieved by the timer
+    api_reply_uint(output + ANALOG_OUTPUT_ID_OFFSET);
+    __api_reply_analog_waveform(&config);
+    return STATUS_OK;
+}
+
+// W20 [PIN] [INDEX] [CODE_1] ... [CODE_N]
+io_status_t __api_write_analog_table(api_command_t *command)
+{
+    uint8_t output;
+    uint32_t index, codes[API_RX_BUFFER_SIZE / 2];
+
+    if (__api_read_analog_output_pin(command, &output) != STATUS_OK
+        || api_read_uint(command, &index) != STATUS_OK || !api_has_argument(command))
+    {
+        return STATUS_FAIL;
+    }
+
+    // a code takes at least 2 characters, so the list fits
+    uint32_t count = api_read_uint_list(command, codes, sizeof(codes) / sizeof(codes[0]));
+    if (api_has_argument(command) || index + count > ANALOG_OUTPUT_TABLE_SIZE)
+    {
+        return STATUS_FAIL;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (analog_output_write_table(output, index + i, codes[i]) != HAL_OK)
+        {
+            return STATUS_FAIL;
+        }
+    }
+
+    api_reply_uint(output + ANALOG_OUTPUT_ID_OFFSET);
+    api_reply_uint(index);
+    api_reply_uint(count);
+    return STATUS_OK;
+}
+
+// R21
+io_status_t __api_read_boot_time(api_command_t *command)
+{
+    uint32_t time_us;
+
+    // milliseconds since reset of every phase, a dash for those not reached yet
+    for (uint8_t phase = 0; phase < BOOT_PHASES; phase++)
+    {
+        if (boot_get_time(phase, &time_us))
         {
-        case 'W': // write data
-            /* code */
-            break;
-        case 'R': // read data
-            /* code */
-            break;
-        default:
-            break;
+            api_reply_decimal((time_us > INT32_MAX) ? INT32_MAX : (int32_t)time_us, 3);
         }
+        else
+        {
+            api_reply_text(" -");
+        }
+    }
+    return STATUS_OK;
+}
+
+// R22
+io_status_t __api_read_firmware(api_command_t *command)
+{
+    // the bank the image runs from, 1 or 2, and 1 while it is on trial
+    api_reply_uint(ota_get_bank() + 1);
+    api_reply_uint(ota_is_trial() ? 1 : 0);
+    return STATUS_OK;
+}
+
+// R125 [PIN]
+io_status_t __api_read_analog_slew_rate(api_command_t *command)
+{
+    uint8_t output;
+
+    if (__api_read_analog_output_pin(command, &output) != STATUS_OK) return STATUS_FAIL;
+
+    // millivolts per second, replied in volts per second
+    api_reply_uint(output + ANALOG_OUTPUT_ID_OFFSET);
+    api_reply_decimal(settings.analog_slew_rate[output], 3);
+    return STATUS_OK;
+}
+
+// W125 [PIN] [SLEW_RATE]
+io_status_t __api_write_analog_slew_rate(api_command_t *command)
+{
+    uint8_t output;
+    int32_t slew_rate_mv;
+
+    // volts per second as millivolts per second
+    if (__api_read_analog_output_pin(command, &output) != STATUS_OK
+        || api_read_milli(command, &slew_rate_mv) != STATUS_OK || slew_rate_mv < 0)
+    {
+        return STATUS_FAIL;
     }
+
+    if (analog_output_set_slew_rate(output, slew_rate_mv) != HAL_OK) return STATUS_FAIL;
+
+    api_reply_uint(output + ANALOG_OUTPUT_ID_OFFSET);
+    api_reply_decimal(slew_rate_mv, 3);
+    return STATUS_OK;
 }
 
 // Append received data to buffer
 io_status_t api_append_data(uint8_t *data, BaseType_t len)
 {
     // append data to buffer
-    for (uint8_t i = 0; i < len; i++)
+    for (BaseType_t i = 0; i < len; i++)
     {
         // check if buffer is full
         if (api_is_rx_buffer_full() == STATUS_OK) return STATUS_FAIL;
@@ -115,4 +1801,4 @@ io_status_t api_is_tx_buffer_empty()
 io_status_t api_is_tx_buffer_full()
 {
     return (((txBufferHead + 1) % API_TX_BUFFER_SIZE) == txBufferTail) ? STATUS_OK : STATUS_FAIL;
-}
\ No newline at end of file
+}
@@ -0,0 +1,88 @@
+#include "stm32f7xx_remote_io.h"
+
+static uint32_t boot_time_us[BOOT_PHASES];
+static uint8_t reached = 0; // one bit for each phase timestamped
+
+// the previous timestamp, the intervals between timestamps are added up
+static uint32_t last_cycles = 0;
+static uint32_t last_clock_mhz = 0;
+static TickType_t last_ticks = 0;
+static uint32_t last_us = 0;
+
+/**
+ * @brief Start timing the boot.
+ * @note Called first thing in main(), the cycle counter starts from here.
+ */
+void boot_init(void)
+{
+    // the DWT is locked unless a debugger is attached
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    last_clock_mhz = SystemCoreClock / 1000000U;
+    boot_mark(BOOT_PHASE_RESET);
+}
+
+/**
+ * @brief Timestamp a phase of the boot, only the first time it is reached.
+ * @note The cycles since the previous timestamp are converted at the core clock
+ *       which was running then, so the time before the PLL is counted at HSI.
+ */
+void boot_mark(uint8_t phase)
+{
+    bool scheduled = (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED);
+    uint32_t cycles, elapsed_us;
+    TickType_t ticks;
+
+    if (phase >= BOOT_PHASES || (reached & (1U << phase)))
+    {
+        return;
+    }
+
+    // phases after the start of the scheduler are reached by different tasks
+    if (scheduled)
+    {
+        taskENTER_CRITICAL();
+    }
+
+    cycles = DWT->CYCCNT;
+    ticks = scheduled ? xTaskGetTickCount() : 0;
+    if (ticks - last_ticks < pdMS_TO_TICKS(BOOT_CYCLE_INTERVAL_MS))
+    {
+        elapsed_us = (cycles - last_cycles) / last_clock_mhz;
+    }
+    else
+    {
+        elapsed_us = (ticks - last_ticks) * portTICK_PERIOD_MS * 1000U;
+    }
+
+    last_us += elapsed_us;
+    last_cycles = cycles;
+    last_ticks = ticks;
+    last_clock_mhz = SystemCoreClock / 1000000U;
+
+    boot_time_us[phase] = last_us;
+    reached |= 1U << phase;
+
+    if (scheduled)
+    {
+        taskEXIT_CRITICAL();
+    }
+}
+
+/**
+ * @brief Get the time at which a phase of the boot was reached.
+ * @retval false if the phase has not been reached yet
+ */
+bool boot_get_time(uint8_t phase, uint32_t *time_us)
+{
+    if (phase >= BOOT_PHASES || !(reached & (1U << phase)))
+    {
+        return false;
+    }
+
+    *time_us = boot_time_us[phase];
+    return true;
+}
@@ -0,0 +1,219 @@
+#include "stm32f7xx_remote_io.h"
+
+static GPIO_TypeDef *const input_ports[NUMBER_OF_INPUT_PORTS] = INPUT_PORT_TABLE;
+static const uint16_t input_port_masks[NUMBER_OF_INPUT_PORTS] = INPUT_PORT_MASK_TABLE;
+
+// lookup from input number to its port and pin
+static const cpu_map_pin_t input_pins[NUMBER_OF_INPUTS] = INPUT_PIN_TABLE;
+
+// debounce state of each input port
+static debounce_port_t debounce_ports[NUMBER_OF_INPUT_PORTS];
+
+static TIM_HandleTypeDef *htim;
+
+/* Function Prototype */
+uint16_t __debounce_calculate_samples(uint16_t time_ms);
+void __debounce_write_threshold(uint8_t input, uint16_t samples);
+
+void debounce_init(TIM_HandleTypeDef *_htim)
+{
+    // save the timer handle
+    htim = _htim;
+
+    for (uint8_t port = 0; port < NUMBER_OF_INPUT_PORTS; port++)
+    {
+        debounce_ports[port].gpio = input_ports[port];
+        debounce_ports[port].mask = input_port_masks[port];
+
+        // start from the current level of the pins, so no change is reported at boot
+        debounce_ports[port].state = debounce_ports[port].gpio->IDR & debounce_ports[port].mask;
+        debounce_ports[port].changed = 0;
+    }
+
+    // apply the sampling period and the debounce time of each input
+    if (debounce_set_period(settings.debounce_period_us) != HAL_OK)
+    {
+        debounce_set_period(DEBOUNCE_DEFAULT_PERIOD_US);
+    }
+
+    // start sampling
+    HAL_TIM_Base_Start_IT(htim);
+}
+
+HAL_StatusTypeDef debounce_set_period(uint16_t period_us)
+{
+    if (period_us < DEBOUNCE_MIN_PERIOD_US || period_us > DEBOUNCE_MAX_PERIOD_US)
+    {
+        return HAL_ERROR;
+    }
+
+    settings.debounce_period_us = period_us;
+
+    // run the counter at 1MHz, so the auto-reload value is the period in microseconds
+    __HAL_TIM_SET_PRESCALER(htim, (utils_get_timer_clock(htim->Instance) / 1000000U) - 1U);
+    __HAL_TIM_SET_AUTORELOAD(htim, period_us - 1U);
+
+    // the number of samples of every input depends on the sampling period
+    for (uint8_t i = 0; i < NUMBER_OF_INPUTS; i++)
+    {
+        __debounce_write_threshold(i, __debounce_calculate_samples(settings.debounce_time_ms[i]));
+    }
+
+    return HAL_OK;
+}
+
+uint16_t debounce_get_period(void)
+{
+    return settings.debounce_period_us;
+}
+
+HAL_StatusTypeDef debounce_set_time(uint8_t input, uint16_t time_ms)
+{
+    if (input >= NUMBER_OF_INPUTS)
+    {
+        return HAL_ERROR;
+    }
+
+    uint16_t samples = __debounce_calculate_samples(time_ms);
+
+    // the longest debounce time is limited by the depth of the vertical counter
+    if (time_ms > (uint32_t)DEBOUNCE_MAX_SAMPLES * settings.debounce_period_us / 1000U)
+    {
+        return HAL_ERROR;
+    }
+
+    settings.debounce_time_ms[input] = time_ms;
+    __debounce_write_threshold(input, samples);
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Sample all input ports and advance their vertical counters.
+ * @note Called from the ISR of the sampling timer.
+ *       A pin which differs from its debounced state increments its counter,
+ *       a pin which agrees with it clears its counter. Once the counter of a pin
+ *       equals its threshold, the debounced state of the pin toggles.
+ */
+void debounce_sample(void)
+{
+    bool changed = false;
+
+    for (uint8_t port = 0; port < NUMBER_OF_INPUT_PORTS; port++)
+    {
+        debounce_port_t *p = &debounce_ports[port];
+
+        // pins whose sample differs from the debounced state
+        uint16_t delta = (p->gpio->IDR & p->mask) ^ p->state;
+
+        // increment the counters of the differing pins and clear the others
+        uint16_t carry = delta;
+        uint16_t mismatch = 0;
+        for (uint8_t i = 0; i < DEBOUNCE_COUNTER_BITS; i++)
+        {
+            uint16_t c = p->counter[i];
+            c ^= carry;
+            carry &= p->counter[i];
+            c &= delta;
+            p->counter[i] = c;
+
+            // collect the bits where the counter is not yet at the threshold
+            mismatch |= c ^ p->threshold[i];
+        }
+
+        // pins whose counters reached their thresholds
+        uint16_t toggled = delta & ~mismatch;
+        if (toggled == 0)
+        {
+            continue;
+        }
+
+        p->state ^= toggled;
+        p->changed |= toggled;
+        changed = true;
+        for (uint8_t i = 0; i < DEBOUNCE_COUNTER_BITS; i++)
+        {
+            p->counter[i] &= ~toggled;
+        }
+    }
+
+    // report the subscribed inputs
+    if (changed)
+    {
+        subscription_input_changed_from_isr();
+    }
+}
+
+uint16_t debounce_get_port_state(uint8_t port)
+{
+    if (port >= NUMBER_OF_INPUT_PORTS)
+    {
+        return 0;
+    }
+
+    return debounce_ports[port].state;
+}
+
+uint16_t debounce_take_changes(uint8_t port)
+{
+    if (port >= NUMBER_OF_INPUT_PORTS)
+    {
+        return 0;
+    }
+
+    // read and clear in one go, the sampling ISR may set new bits at any time
+    taskENTER_CRITICAL();
+    uint16_t changed = debounce_ports[port].changed;
+    debounce_ports[port].changed = 0;
+    taskEXIT_CRITICAL();
+
+    return changed;
+}
+
+int8_t debounce_read_input(uint8_t input)
+{
+    if (input >= NUMBER_OF_INPUTS)
+    {
+        return -1;
+    }
+
+    return (debounce_ports[input_pins[input].port].state & input_pins[input].mask) ? 1 : 0;
+}
+
+uint16_t __debounce_calculate_samples(uint16_t time_ms)
+{
+    // round up, so an input is never accepted earlier than requested
+    uint32_t samples = ((uint32_t)time_ms * 1000U + settings.debounce_period_us - 1U) / settings.debounce_period_us;
+
+    if (samples < 1)
+    {
+        samples = 1;
+    }
+    else if (samples > DEBOUNCE_MAX_SAMPLES)
+    {
+        samples = DEBOUNCE_MAX_SAMPLES;
+    }
+
+    return samples;
+}
+
+void __debounce_write_threshold(uint8_t input, uint16_t samples)
+{
+    debounce_port_t *p = &debounce_ports[input_pins[input].port];
+    uint16_t bit = input_pins[input].mask;
+
+    // the sampling ISR reads the threshold planes, so update them atomically
+    taskENTER_CRITICAL();
+    for (uint8_t i = 0; i < DEBOUNCE_COUNTER_BITS; i++)
+    {
+        if (samples & (1 << i))
+        {
+            p->threshold[i] |= bit;
+        }
+        else
+        {
+            p->threshold[i] &= ~bit;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
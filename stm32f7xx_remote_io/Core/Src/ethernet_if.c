@@ -1,15 +1,24 @@
-#include <stdio.h>
 #include "stm32f7xx_remote_io.h"
+#include "FreeRTOS_ARP.h"
 
 #define BUFFER_SIZE 512
 #define CONNECTION_CREATED_MSK 1
 
+// longest prefix of a reply to the client with data received from the serial port, "W13 4294967295 "
+#define SERIAL_REPLY_PREFIX_SIZE 15
+
 extern NetworkInterface_t *pxSTM32Fxx_FillInterfaceDescriptor(BaseType_t xEMACIndex,
                                                               NetworkInterface_t *pxInterface);
 static void prvCreateTCPServerSocketTasks(void *pvParameters);
 static void prvProcessRxTask(void *pvParameters);
 static void prvProcessTxTask(void *pvParameters);
 static void prvBlinkLED(void *pvParameters);
+static void prvFactoryResetTask(void *pvParameters);
+static void prvSerialTunnelTask(void *pvParameters);
+static void prvSerialTunnelTxTask(void *pvParameters);
+static uint16_t prvSerialReplyPrefix(char *str);
+static uint16_t prvReportPrefix(char *str, uint8_t id, uint32_t value);
+static void prvApplyAddress(Socket_t xSocket);
 
 NetworkInterface_t xInterfaces[1];
 struct xNetworkEndPoint xEndPoints[1];
@@ -21,11 +30,20 @@ static SemaphoreHandle_t connectionCreatedSemaphoreHandle;
 SemaphoreHandle_t deleteTaskSemaphoreHandle;
 static uint16_t listeningPort = 0;
 
+// set when settings 101, 103 or 104 have changed, they are applied once the reply is sent
+static volatile bool addressChanged = false;
+
+// raw serial tunnel, a transparent byte pipe between a client and the serial port
+static Socket_t serialTunnelSocket = NULL;
+static SemaphoreHandle_t serialTunnelMutex;
+static TaskHandle_t serialTunnelTxTaskHandle = NULL;
+
 BaseType_t tcp_server_init()
 {
     /* Initialize Semaphore handler to protect the critical section of
        safely shutting down connection */
     connectionCreatedSemaphoreHandle = xSemaphoreCreateBinary();
+    serialTunnelMutex = xSemaphoreCreateMutex();
 
     /* Initialise the interface descriptor for WinPCap for example. */
     pxSTM32Fxx_FillInterfaceDescriptor(0, &(xInterfaces[0]));
@@ -35,39 +53,23 @@ BaseType_t tcp_server_init()
         settings.ip_address_1,
         settings.ip_address_2,
         settings.ip_address_3};
+    uint8_t NetMask[4] = {
+        settings.netmask_0,
+        settings.netmask_1,
+        settings.netmask_2,
+        settings.netmask_3};
     uint8_t GatewayAddr[4] = {
-        settings.ip_address_0,
-        settings.ip_address_1,
-        settings.ip_address_2,
-        1};
+        settings.gateway_0,
+        settings.gateway_1,
+        settings.gateway_2,
+        settings.gateway_3};
     listeningPort = LISTENING_PORT + settings.tcp_port;
 
-    // check if USER Button is continuously pressed over 5 seconds,
-    // then use the default IP address and port
+    // if USER Button is pressed, check in the background if it is held over 5 seconds,
+    // the network is not kept waiting for it
     if (HAL_GPIO_ReadPin(USER_Btn_GPIO_Port, USER_Btn_Pin) == GPIO_PIN_SET)
     {
-        // wait for 5 seconds
-        vTaskDelay(pdMS_TO_TICKS(5000));
-
-        // check if USER Button is still pressed
-        if (HAL_GPIO_ReadPin(USER_Btn_GPIO_Port, USER_Btn_Pin) == GPIO_PIN_SET)
-        {
-            // use the default IP address and port
-            IPAddr[0] = 172;
-            IPAddr[1] = 16;
-            IPAddr[2] = 0;
-            IPAddr[3] = 10;
-
-            GatewayAddr[0] = 172;
-            GatewayAddr[1] = 16;
-            GatewayAddr[2] = 0;
-            GatewayAddr[3] = 1;
-
-            listeningPort = LISTENING_PORT;
-
-            // start the LED blinking task
-            xTaskCreate(prvBlinkLED, "BlinkLED", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY, NULL);
-        }
+        xTaskCreate(prvFactoryResetTask, "FactoryReset", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, NULL);
     }
 
     FreeRTOS_FillEndPoint(&(xInterfaces[0]), &(xEndPoints[0]), IPAddr,
@@ -87,6 +89,144 @@ BaseType_t tcp_server_init()
     return SUCCESS;
 }
 
+/**
+ * @brief Take the port of setting 102 for every listener.
+ * @note The listeners move to the new port on their own, see tcp_server_accept(),
+ *       the clients connected meanwhile keep their connections.
+ */
+void tcp_server_configure_port(void)
+{
+    listeningPort = LISTENING_PORT + settings.tcp_port;
+}
+
+/**
+ * @brief Take the address, netmask and gateway of settings 101, 103 and 104.
+ * @note The reply to the command is still sent from the old address, the new one
+ *       is applied by the task of the API client once it has been acknowledged.
+ *       The client then has to connect to the new address.
+ */
+void tcp_server_configure_address(void)
+{
+    addressChanged = true;
+}
+
+/**
+ * @brief Wait for a client of a listener which follows the port setting.
+ * @note The listening socket is created at the first call, and again at the new
+ *       port whenever setting 102 has changed. Closing it only drops the clients
+ *       not accepted yet, the connected ones keep their sockets. accept() gives up
+ *       every LISTENING_PORT_POLL_MS to look at the port. The accepted socket
+ *       inherits xSendBufferSize and xReceiveBufferSize, unless they are 0, and
+ *       blocks in recv() until data arrives.
+ * @retval the connected socket, NULL if no client has connected meanwhile
+ */
+Socket_t tcp_server_accept(Socket_t *pxListeningSocket, uint16_t usOffset, BaseType_t xSendBufferSize,
+                           BaseType_t xReceiveBufferSize)
+{
+    static const TickType_t xPollTime = pdMS_TO_TICKS(LISTENING_PORT_POLL_MS);
+    static const TickType_t xReceiveTimeOut = portMAX_DELAY;
+    struct freertos_sockaddr xAddress = {0};
+    uint16_t usPort = listeningPort + usOffset;
+    Socket_t xSocket = *pxListeningSocket;
+
+    if (xSocket != NULL)
+    {
+        FreeRTOS_GetLocalAddress(xSocket, &xAddress);
+        if (FreeRTOS_ntohs(xAddress.sin_port) != usPort)
+        {
+            FreeRTOS_closesocket(xSocket);
+            xSocket = NULL;
+        }
+    }
+
+    if (xSocket == NULL)
+    {
+        xSocket = FreeRTOS_socket(FREERTOS_AF_INET4, FREERTOS_SOCK_STREAM, FREERTOS_IPPROTO_TCP);
+        configASSERT(xSocket != FREERTOS_INVALID_SOCKET);
+
+        FreeRTOS_setsockopt(xSocket, 0, FREERTOS_SO_RCVTIMEO, &xPollTime, sizeof(xPollTime));
+        if (xReceiveBufferSize > 0)
+        {
+            // the windows are half of the buffers, as the stack sizes them for the default buffers
+            WinProperties_t xWinProperties = {
+                .lTxBufSize = (xSendBufferSize > 0) ? xSendBufferSize : ipconfigTCP_TX_BUFFER_LENGTH,
+                .lRxBufSize = xReceiveBufferSize,
+            };
+            xWinProperties.lTxWinSize = FreeRTOS_max_int32(1, xWinProperties.lTxBufSize / 2 / ipconfigTCP_MSS);
+            xWinProperties.lRxWinSize = FreeRTOS_max_int32(1, xWinProperties.lRxBufSize / 2 / ipconfigTCP_MSS);
+            FreeRTOS_setsockopt(xSocket, 0, FREERTOS_SO_WIN_PROPERTIES, &xWinProperties, sizeof(xWinProperties));
+        }
+        else if (xSendBufferSize > 0)
+        {
+            FreeRTOS_setsockopt(xSocket, 0, FREERTOS_SO_SNDBUF, &xSendBufferSize, sizeof(xSendBufferSize));
+        }
+
+        memset(&xAddress, 0, sizeof(xAddress));
+        xAddress.sin_port = FreeRTOS_htons(usPort);
+        xAddress.sin_family = FREERTOS_AF_INET;
+
+        // the port may still be held by the socket closed for the previous port, or
+        // the stack may be out of buffers, try again at the next poll
+        if (FreeRTOS_bind(xSocket, &xAddress, sizeof(xAddress)) != 0 || FreeRTOS_listen(xSocket, 1) != 0)
+        {
+            FreeRTOS_closesocket(xSocket);
+            *pxListeningSocket = NULL;
+            vTaskDelay(xPollTime);
+            return NULL;
+        }
+        *pxListeningSocket = xSocket;
+
+        if (usOffset == 0)
+        {
+            boot_mark(BOOT_PHASE_LISTENING);
+        }
+    }
+
+    xSocket = FreeRTOS_accept(*pxListeningSocket, NULL, NULL);
+    if (xSocket == NULL || xSocket == FREERTOS_INVALID_SOCKET)
+    {
+        return NULL;
+    }
+
+    FreeRTOS_setsockopt(xSocket, 0, FREERTOS_SO_RCVTIMEO, &xReceiveTimeOut, sizeof(xReceiveTimeOut));
+    return xSocket;
+}
+
+/**
+ * @brief Apply the address, netmask and gateway in settings to the end-point.
+ * @note Called by the task of the API client after the reply of the command which
+ *       changed them. The reply is given time to be acknowledged, since anything
+ *       sent afterwards leaves from the new address. The ARP cache is cleared, as
+ *       the subnet may have changed, and the new address is announced. xSocket is
+ *       NULL when there is no reply to wait for.
+ */
+static void prvApplyAddress(Socket_t xSocket)
+{
+    TickType_t xStart = xTaskGetTickCount();
+    uint32_t ulIPAddress = FreeRTOS_inet_addr_quick(settings.ip_address_0, settings.ip_address_1,
+                                                    settings.ip_address_2, settings.ip_address_3);
+    uint32_t ulNetMask = FreeRTOS_inet_addr_quick(settings.netmask_0, settings.netmask_1,
+                                                  settings.netmask_2, settings.netmask_3);
+    uint32_t ulGatewayAddress = FreeRTOS_inet_addr_quick(settings.gateway_0, settings.gateway_1,
+                                                         settings.gateway_2, settings.gateway_3);
+
+    addressChanged = false;
+
+    while (xSocket != NULL && FreeRTOS_outstanding(xSocket) > 0
+           && xTaskGetTickCount() - xStart < pdMS_TO_TICKS(ADDRESS_CHANGE_TIMEOUT_MS))
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    // the IP task reads the end-point, it must not see half of the change
+    vTaskSuspendAll();
+    FreeRTOS_SetEndPointConfiguration(&ulIPAddress, &ulNetMask, &ulGatewayAddress, NULL, &(xEndPoints[0]));
+    FreeRTOS_ClearARP(&(xEndPoints[0]));
+    xTaskResumeAll();
+
+    vARPSendGratuitous();
+}
+
 /**
  * @brief  Initializes the ETH MSP.
  * @param  ethHandle: ETH handle
@@ -167,6 +307,8 @@ void vApplicationIPNetworkEventHook_Multi(eIPCallbackEvent_t eNetworkEvent,
     /* Both eNetworkUp and eNetworkDown events can be processed here. */
     if (eNetworkEvent == eNetworkUp)
     {
+        boot_mark(BOOT_PHASE_LINK);
+
         /* Create the tasks that use the TCP/IP stack if they have not already
         been created. */
         if (xTasksAlreadyCreated == pdFALSE)
@@ -179,6 +321,19 @@ void vApplicationIPNetworkEventHook_Multi(eIPCallbackEvent_t eNetworkEvent,
             xTasksAlreadyCreated = pdTRUE;
 
             vStartSimpleTCPServerTasks(4 * configMINIMAL_STACK_SIZE, tskIDLE_PRIORITY);
+
+            // data socket of the logic capture
+            logic_capture_start_task();
+
+            // data socket of the analog stream
+            analog_start_task();
+
+            // update socket
+            ota_start_task();
+
+            // raw serial tunnel
+            xTaskCreate(prvSerialTunnelTask, "SerialTunnel", 4 * configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, NULL);
+            xTaskCreate(prvSerialTunnelTxTask, "SerialTunnelTx", 2 * configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, &serialTunnelTxTaskHandle);
         }
     }
     /* Print out the network configuration, which may have come from a DHCP
@@ -218,56 +373,15 @@ void vStartSimpleTCPServerTasks(uint16_t usStackSize, UBaseType_t uxPriority)
 
 static void prvCreateTCPServerSocketTasks(void *pvParameters)
 {
-    struct freertos_sockaddr xClient, xBindAddress;
-    Socket_t xListeningSocket, xConnectedSocket;
-    socklen_t xSize = sizeof(xClient);
-    static const TickType_t xReceiveTimeOut = portMAX_DELAY;
-    const BaseType_t xBacklog = 1;
-
-    /* Attempt to open the socket. */
-    xListeningSocket = FreeRTOS_socket(FREERTOS_AF_INET4,    /* Or FREERTOS_AF_INET6 for IPv6. */
-                                       FREERTOS_SOCK_STREAM, /* SOCK_STREAM for TCP. */
-                                       FREERTOS_IPPROTO_TCP);
-
-    /* Check the socket was created. */
-    configASSERT(xListeningSocket != FREERTOS_INVALID_SOCKET);
-
-    /* If FREERTOS_SO_RCVBUF or FREERTOS_SO_SNDBUF are to be used with
-    FreeRTOS_setsockopt() to change the buffer sizes from their default then do
-    it here!.  (see the FreeRTOS_setsockopt() documentation. */
-
-    /* If ipconfigUSE_TCP_WIN is set to 1 and FREERTOS_SO_WIN_PROPERTIES is to
-    be used with FreeRTOS_setsockopt() to change the sliding window size from
-    its default then do it here! (see the FreeRTOS_setsockopt()
-    documentation. */
-
-    /* Set a time out so accept() will just wait for a connection. */
-    FreeRTOS_setsockopt(xListeningSocket,
-                        0,
-                        FREERTOS_SO_RCVTIMEO,
-                        &xReceiveTimeOut,
-                        sizeof(xReceiveTimeOut));
-
-    /* Set the listening port to 10000. */
-    // xBindAddress.sin_address = (IP_Address_t)FreeRTOS_inet_addr_quick(0, 0, 0, 0);
-    xBindAddress.sin_port = listeningPort;
-    xBindAddress.sin_port = FreeRTOS_htons(xBindAddress.sin_port);
-    xBindAddress.sin_family = FREERTOS_AF_INET;
-
-    /* Bind the socket to the port that the client RTOS task will send to. */
-    FreeRTOS_bind(xListeningSocket, &xBindAddress, sizeof(xBindAddress));
-
-    /* Set the socket into a listening state so it can accept connections.
-    The maximum number of simultaneous connections is limited to 20. */
-    FreeRTOS_listen(xListeningSocket, xBacklog);
+    Socket_t xListeningSocket = NULL, xConnectedSocket;
 
     for (;;)
     {
-        if (xSocketValid(xListeningSocket) == pdTRUE)
+        /* Wait for incoming connections, at the port of the moment. */
+        xConnectedSocket = tcp_server_accept(&xListeningSocket, 0, 0, 0);
+        if (xConnectedSocket != NULL)
         {
-            /* Wait for incoming connections. */
-            xConnectedSocket = FreeRTOS_accept(xListeningSocket, &xClient, &xSize);
-            configASSERT(xConnectedSocket != FREERTOS_INVALID_SOCKET);
+            boot_mark(BOOT_PHASE_ACCEPT);
 
             /* Give semaphore a count to represent there is a connection that can be shut down. */
             xSemaphoreGive(connectionCreatedSemaphoreHandle);
@@ -300,6 +414,10 @@ static void prvCreateTCPServerSocketTasks(void *pvParameters)
             }
             if (processTxTaskHandle != NULL)
             {
+                // stop notifying the task of serial data and subscriptions before it is gone
+                serial_set_reader(NULL);
+                subscription_set_reader(NULL);
+
                 // delete the task
                 vTaskDelete(processTxTaskHandle);
                 processTxTaskHandle = NULL;
@@ -420,6 +538,9 @@ static void prvProcessRxTask(void *pvParameters)
     // print welcome message
     FreeRTOS_send(xSocket, "Welcome to the server\r\n", sizeof("Welcome to the server\r\n"), 0);
 
+    // bind the API to the new connection
+    api_init(xSocket);
+
     for (;;)
     {
         /* Receive another block of data into the cRxedData buffer. */
@@ -428,7 +549,14 @@ static void prvProcessRxTask(void *pvParameters)
         if (lBytesReceived > 0)
         {
             /* Data was received, process it here. */
-            api_append_data(cRxedData, lBytesReceived);
+            api_process_data(cRxedData, lBytesReceived, xSocket);
+
+            // the session is left on the old address, the client connects to the new one
+            if (addressChanged)
+            {
+                prvApplyAddress(xSocket);
+                break;
+            }
         }
         else if (lBytesReceived == 0)
         {
@@ -467,58 +595,129 @@ static void prvProcessRxTask(void *pvParameters)
 static void prvProcessTxTask(void *pvParameters)
 {
     Socket_t xSocket = (Socket_t)pvParameters;
-    char str[105] = {'\0'};
-    uint8_t strIndex = 0;
+    static uint8_t chunk[SERIAL_CHUNK_SIZE];
+    static char str[SERIAL_CHUNK_SIZE * 5]; // room for a prefix before every few bytes
+    uint16_t strIndex = 0;
+    bool lineStart = true;
+
+    _Static_assert(sizeof(str) >= SERIAL_FRAME_SIZE + SERIAL_REPLY_PREFIX_SIZE + 1, "a framed reply does not fit");
+
+    // drop what has been received before the connection, then get notified of new data
+    serial_flush();
+    transaction_reset();
+    serial_set_reader(xTaskGetCurrentTaskHandle());
+
+    // the subscriptions of the previous client are dropped too
+    subscription_clear();
+    subscription_set_reader(xTaskGetCurrentTaskHandle());
 
     for (;;)
     {
-        // Wait for a notification from serial task in serial.c of grbl
-        ulTaskNotifyTake(pdFALSE, portMAX_DELAY); // decrement the notification count
+        // Wait for a notification from the receive interrupts of the serial port or of
+        // a subscribed input, for the oldest serial transaction to time out, or for the
+        // next heartbeat or minimum interval of a subscription
+        TickType_t wait = transaction_get_wait();
+        TickType_t subscriptionWait = subscription_get_wait();
+        ulTaskNotifyTake(pdTRUE, (subscriptionWait < wait) ? subscriptionWait : wait);
+
+        size_t len;
+        BaseType_t bytesSent = 0;
+        const uint8_t *frame;
+        uint32_t tag, pin;
+        int32_t value;
+
+        // reply every frame received from the serial port in one go
+        while (serial_is_framed() && (len = serial_frame_peek(&frame)) > 0)
+        {
+            strIndex = prvSerialReplyPrefix(str);
+            memcpy(&str[strIndex], frame, len);
+            strIndex += len;
+            if (frame[len - 1] != '\n')
+            {
+                str[strIndex++] = '\n';
+            }
+            serial_frame_consume(len);
 
-        /**
-         * TODO: Implement serial task
-         * - check if ethernet is ready to send data
-         * - concatenate the data to be sent until a newline character, '\n', is received
-         */
-        // uint8_t chr = serial_tx_irq();
-        uint8_t chr = '\0';
+            bytesSent = FreeRTOS_send(xSocket, str, strIndex, 0);
+            strIndex = 0;
 
-        // concatenate the data to be sent until a newline character, '\n', is received
-        str[strIndex] = chr;
+            if (bytesSent < 0)
+            {
+                FreeRTOS_debug_printf(("Failed to send data\n"));
+                break;
+            }
+        }
 
-        if (++strIndex >= sizeof(str))
+        while (!serial_is_framed() && (len = serial_read(chunk, sizeof(chunk))) > 0)
         {
-            FreeRTOS_debug_printf(("Buffer overflow\n"));
+            // prefix every line received from the serial port with the command code
+            for (size_t i = 0; i < len && bytesSent >= 0; i++)
+            {
+                if (lineStart)
+                {
+                    // a line per byte does not fit, send what there is so far
+                    if ((size_t)strIndex + SERIAL_REPLY_PREFIX_SIZE + 1 > sizeof(str))
+                    {
+                        bytesSent = FreeRTOS_send(xSocket, str, strIndex, 0);
+                        strIndex = 0;
+                    }
+
+                    strIndex += prvSerialReplyPrefix(&str[strIndex]);
+                    lineStart = false;
+                }
+
+                str[strIndex++] = chunk[i];
+                lineStart = (chunk[i] == '\n');
+            }
+
+            // send the whole chunk at once, at most one line is left open at its end
+            if (bytesSent >= 0)
+            {
+                bytesSent = FreeRTOS_send(xSocket, str, strIndex, 0);
+            }
             strIndex = 0;
+
+            if (bytesSent < 0)
+            {
+                FreeRTOS_debug_printf(("Failed to send data\n"));
+                break;
+            }
         }
 
-        // Check if the character is a newline character
-        if (chr != '\n')
+        // report the transactions whose response is overdue, after the responses received in time
+        while (bytesSent >= 0 && transaction_expire(&tag))
         {
-            continue;
+            strIndex = prvReportPrefix(str, API_ID_SERIAL_TRANSACTION, tag);
+            memcpy(&str[strIndex], " ERR", 4);
+            strIndex += 4;
+            strIndex += utils_format_uint(&str[strIndex], API_ERROR_TIMEOUT, 2);
+            memcpy(&str[strIndex], "\r\n", 2);
+            strIndex += 2;
+            bytesSent = FreeRTOS_send(xSocket, str, strIndex, 0);
+            strIndex = 0;
         }
 
-        // Send the data
-        BaseType_t bytesSent = FreeRTOS_send(xSocket, str, strIndex, 0);
-
-        // Check if the data was sent successfully
-        if (bytesSent > 0)
+        // report the subscribed inputs, a digital input as 0 or 1 and an analog input in volts
+        while (bytesSent >= 0 && subscription_take(&pin, &value))
         {
-            FreeRTOS_debug_printf(("Data sent: %s\n", str));
+            strIndex = prvReportPrefix(str, API_ID_SUBSCRIBE, pin);
+            str[strIndex++] = ' ';
+            strIndex += utils_format_decimal(&str[strIndex], value, (pin < ANALOG_INPUT_ID_OFFSET) ? 0 : 6);
+            memcpy(&str[strIndex], "\r\n", 2);
+            strIndex += 2;
+            bytesSent = FreeRTOS_send(xSocket, str, strIndex, 0);
+            strIndex = 0;
         }
-        else if (bytesSent < 0)
+
+        if (bytesSent < 0)
         {
-            FreeRTOS_debug_printf(("Failed to send data\n"));
             break;
         }
-
-        // Clear the string buffer
-        memset(str, '\0', sizeof(str));
-
-        // Reset the string index
-        strIndex = 0;
     }
 
+    serial_set_reader(NULL);
+    subscription_set_reader(NULL);
+
     /**
      * The RTOS task will get here if an error is received on a read.
      * Ensure the socket has shut down before leaving the task.
@@ -539,6 +738,166 @@ static void prvProcessTxTask(void *pvParameters)
     vTaskDelete(NULL);
 }
 
+/**
+ * @brief Write the prefix of the reply with data received from the serial port.
+ * @note The data completes the oldest serial transaction in flight if there is
+ *       one, and is an unsolicited W05 reply otherwise.
+ * @retval length of the prefix
+ */
+static uint16_t prvSerialReplyPrefix(char *str)
+{
+    uint32_t tag;
+
+    if (transaction_match(&tag))
+    {
+        uint16_t len = prvReportPrefix(str, API_ID_SERIAL_TRANSACTION, tag);
+        str[len++] = ' ';
+        return len;
+    }
+
+    memcpy(str, "W05 ", 4);
+    return 4;
+}
+
+// Write the command code of an unsolicited reply and its first value, e.g. "W04 3"
+static uint16_t prvReportPrefix(char *str, uint8_t id, uint32_t value)
+{
+    uint16_t len = 0;
+
+    str[len++] = 'W';
+    len += utils_format_uint(&str[len], id, 2);
+    str[len++] = ' ';
+    len += utils_format_uint(&str[len], value, 1);
+    return len;
+}
+
+/**
+ * @brief Serve the raw serial tunnel.
+ * @note Data from the client is sent by the UART DMA straight out of the receive
+ *       stream of the socket, and released once the DMA is done with it.
+ *       While a client is connected, data received by the UART is routed to the
+ *       tunnel instead of W05.
+ */
+static void prvSerialTunnelTask(void *pvParameters)
+{
+    Socket_t xListeningSocket = NULL, xSocket;
+    uint8_t *pucData;
+    BaseType_t xLength;
+
+    for (;;)
+    {
+        xSocket = tcp_server_accept(&xListeningSocket, SERIAL_TUNNEL_PORT_OFFSET, 0, 0);
+        if (xSocket == NULL)
+        {
+            continue;
+        }
+
+        // hand the received serial data to the client
+        xSemaphoreTake(serialTunnelMutex, portMAX_DELAY);
+        serialTunnelSocket = xSocket;
+        xSemaphoreGive(serialTunnelMutex);
+        serial_open_tunnel(serialTunnelTxTaskHandle);
+
+        for (;;)
+        {
+            // get the contiguous data in the receive stream of the socket in place
+            xLength = FreeRTOS_recv(xSocket, &pucData, ipconfigTCP_RX_BUFFER_LENGTH, FREERTOS_ZERO_COPY);
+            if (xLength < 0)
+            {
+                break;
+            }
+
+            if (xLength > 0)
+            {
+                // release only what the UART took, the rest stays in the socket and
+                // its receive window closes while the UART is held off
+                uint16_t sent = serial_write_some(pucData, xLength, pdMS_TO_TICKS(SERIAL_TX_TIMEOUT_MS));
+                FreeRTOS_ReleaseTCPPayloadBuffer(xSocket, pucData, sent);
+            }
+        }
+
+        serial_close_tunnel();
+        xSemaphoreTake(serialTunnelMutex, portMAX_DELAY);
+        serialTunnelSocket = NULL;
+        xSemaphoreGive(serialTunnelMutex);
+
+        // wait for the client to acknowledge the shutdown before closing the socket
+        FreeRTOS_shutdown(xSocket, FREERTOS_SHUT_RDWR);
+        for (uint8_t i = 0; i < 4 && FreeRTOS_recv(xSocket, NULL, 0, 0) >= 0; i++)
+        {
+            vTaskDelay(pdMS_TO_TICKS(250));
+        }
+        FreeRTOS_closesocket(xSocket);
+    }
+}
+
+/**
+ * @brief Forward data received by the UART to the tunnel client.
+ * @note Without framing, the data is copied once, from the UART DMA buffer straight
+ *       into the transmit stream of the socket. Otherwise every frame is sent by one
+ *       FreeRTOS_send() once the socket has room for all of it.
+ */
+static void prvSerialTunnelTxTask(void *pvParameters)
+{
+    TickType_t xWait = portMAX_DELAY;
+
+    for (;;)
+    {
+        // Wait for a notification from the receive interrupts of the serial port
+        ulTaskNotifyTake(pdTRUE, xWait);
+        xWait = portMAX_DELAY;
+
+        xSemaphoreTake(serialTunnelMutex, portMAX_DELAY);
+        if (serialTunnelSocket != NULL)
+        {
+            const uint8_t *pucData;
+            size_t len;
+
+            while ((len = serial_tunnel_peek(&pucData)) > 0)
+            {
+                BaseType_t xSpace;
+                uint8_t *pucHead = FreeRTOS_get_tx_head(serialTunnelSocket, &xSpace);
+
+                if (pucHead == NULL || xSpace <= 0)
+                {
+                    // the socket is congested, try again later
+                    xWait = pdMS_TO_TICKS(SERIAL_TUNNEL_RETRY_MS);
+                    break;
+                }
+
+                if (len > (size_t)xSpace)
+                {
+                    len = xSpace;
+                }
+
+                memcpy(pucHead, pucData, len);
+                if (FreeRTOS_send(serialTunnelSocket, NULL, len, 0) < 0)
+                {
+                    break;
+                }
+                serial_tunnel_consume(len);
+            }
+
+            while (serial_is_framed() && (len = serial_frame_peek(&pucData)) > 0)
+            {
+                if (FreeRTOS_tx_space(serialTunnelSocket) < (BaseType_t)len)
+                {
+                    // the socket is congested, try again later
+                    xWait = pdMS_TO_TICKS(SERIAL_TUNNEL_RETRY_MS);
+                    break;
+                }
+
+                if (FreeRTOS_send(serialTunnelSocket, pucData, len, 0) < 0)
+                {
+                    break;
+                }
+                serial_frame_consume(len);
+            }
+        }
+        xSemaphoreGive(serialTunnelMutex);
+    }
+}
+
 void HAL_ETH_ErrorCallback(ETH_HandleTypeDef *heth)
 {
     if ((heth->Instance->DMASR & ETH_DMA_FLAG_AIS) != 0)
@@ -549,6 +908,36 @@ void HAL_ETH_ErrorCallback(ETH_HandleTypeDef *heth)
     }
 }
 
+/**
+ * @brief Restore the default address and port if the USER button is held.
+ * @note Started at boot when the button is pressed. Gives up as soon as it is
+ *       released, otherwise the defaults are applied once FACTORY_RESET_HOLD_MS has
+ *       passed, the clients connected to the old address are lost, and the LEDs
+ *       blink. The defaults are saved to flash, so they survive a power cycle.
+ */
+static void prvFactoryResetTask(void *pvParameters)
+{
+    for (uint32_t ulHeld = 0; ulHeld < FACTORY_RESET_HOLD_MS; ulHeld += FACTORY_RESET_POLL_MS)
+    {
+        if (HAL_GPIO_ReadPin(USER_Btn_GPIO_Port, USER_Btn_Pin) != GPIO_PIN_SET)
+        {
+            vTaskDelete(NULL);
+        }
+        vTaskDelay(pdMS_TO_TICKS(FACTORY_RESET_POLL_MS));
+    }
+
+    taskENTER_CRITICAL();
+    settings_restore(SETTINGS_RESTORE_NETWORK);
+    taskEXIT_CRITICAL();
+    settings_save();
+
+    tcp_server_configure_port();
+    prvApplyAddress(NULL);
+
+    // the task carries on blinking the LEDs
+    prvBlinkLED(pvParameters);
+}
+
 static void prvBlinkLED(void *pvParameters)
 {
     for (;;)
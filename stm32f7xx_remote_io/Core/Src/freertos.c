@@ -3,6 +3,11 @@
 #include "stm32f7xx_remote_io.h"
 
 SemaphoreHandle_t loggingSemaphoreHandle;
+
+/* The heap holds the task stacks, so it is in the DTCM. The network buffers are
+allocated from it by BufferAllocation_2.c, and the ethernet DMA receives and sends
+them in place with the zero copy drivers, which the DTCM allows as it is not cached. */
+uint8_t ucHeap[configTOTAL_HEAP_SIZE] UTILS_DTCM_DATA;
 extern SemaphoreHandle_t deleteTaskSemaphoreHandle;
 
 extern void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer,
@@ -24,7 +29,7 @@ void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer,
     function then they must be declared static - otherwise they will be allocated on
     the stack and so not exists after this function exits. */
     static StaticTask_t xIdleTaskTCB;
-    static StackType_t uxIdleTaskStack[configMINIMAL_STACK_SIZE];
+    static StackType_t uxIdleTaskStack[configMINIMAL_STACK_SIZE] UTILS_DTCM_DATA;
 
     /* Pass out a pointer to the StaticTask_t structure in which the Idle task's
     state will be stored. */
@@ -51,7 +56,7 @@ void vApplicationGetTimerTaskMemory(StaticTask_t **ppxTimerTaskTCBBuffer,
     function then they must be declared static - otherwise they will be allocated on
     the stack and so not exists after this function exits. */
     static StaticTask_t xTimerTaskTCB;
-    static StackType_t uxTimerTaskStack[configTIMER_TASK_STACK_DEPTH];
+    static StackType_t uxTimerTaskStack[configTIMER_TASK_STACK_DEPTH] UTILS_DTCM_DATA;
 
     /* Pass out a pointer to the StaticTask_t structure in which the Timer
     task's state will be stored. */
@@ -112,6 +117,8 @@ void vApplicationIdleHook(void)
 {
     // vLoggingPrintf("Idle Hook\n");
 
+    ota_refresh_watchdog();
+
     // check if delete task semaphore is not null
     if (deleteTaskSemaphoreHandle != NULL)
     {
@@ -0,0 +1,414 @@
+#include "stm32f7xx_remote_io.h"
+
+// ring of segments filled by the DMA
+static uint16_t logic_capture_buffer[LOGIC_CAPTURE_BUFFER_SIZE] UTILS_DMA_BUFFER;
+
+static GPIO_TypeDef *const input_ports[NUMBER_OF_INPUT_PORTS] = INPUT_PORT_TABLE;
+static const uint16_t input_port_masks[NUMBER_OF_INPUT_PORTS] = INPUT_PORT_MASK_TABLE;
+
+static TIM_HandleTypeDef *htim;
+static DMA_HandleTypeDef *hdma;
+static TaskHandle_t logicCaptureTaskHandle = NULL;
+
+static logic_capture_config_t config;
+static volatile logic_capture_state_t state = LOGIC_CAPTURE_IDLE;
+static volatile uint32_t segments_completed = 0; // number of segments filled since the start
+static volatile uint32_t trigger_segment = 0;    // number of the segment holding the trigger
+static volatile uint32_t trigger_index = 0;      // index in the ring of the trigger sample
+static uint16_t last_sample = 0;                 // last sample of the previous segment
+
+// buffer for the run-length encoded data to be sent
+static uint8_t send_buffer[LOGIC_CAPTURE_SEND_BUFFER_SIZE];
+
+/* Function Prototype */
+void __logic_capture_m0_complete_callback(DMA_HandleTypeDef *_hdma);
+void __logic_capture_m1_complete_callback(DMA_HandleTypeDef *_hdma);
+void __logic_capture_segment_complete(HAL_DMA_MemoryTypeDef memory);
+void __logic_capture_stop(void);
+uint32_t __logic_capture_configure_timer(uint32_t sample_rate);
+static void prvLogicCaptureTask(void *pvParameters);
+BaseType_t __logic_capture_send(Socket_t xSocket);
+uint32_t __logic_capture_encode(Socket_t xSocket, uint32_t start, uint32_t count, uint16_t mask);
+BaseType_t __logic_capture_send_all(Socket_t xSocket, const uint8_t *data, size_t len);
+
+void logic_capture_init(TIM_HandleTypeDef *_htim, DMA_HandleTypeDef *_hdma)
+{
+    // save the timer and DMA handles
+    htim = _htim;
+    hdma = _hdma;
+
+    // the DMA callbacks are called when a segment of the ring has been filled
+    hdma->XferCpltCallback = __logic_capture_m0_complete_callback;
+    hdma->XferM1CpltCallback = __logic_capture_m1_complete_callback;
+    hdma->XferHalfCpltCallback = NULL;
+    hdma->XferM1HalfCpltCallback = NULL;
+    hdma->XferErrorCallback = NULL;
+
+    state = LOGIC_CAPTURE_IDLE;
+}
+
+void logic_capture_start_task(void)
+{
+    xTaskCreate(prvLogicCaptureTask, "LogicCapture", configMINIMAL_STACK_SIZE * 2, NULL, tskIDLE_PRIORITY + 1, &logicCaptureTaskHandle);
+}
+
+HAL_StatusTypeDef logic_capture_start(logic_capture_config_t *_config)
+{
+    BaseType_t busy;
+
+    if (_config->port >= NUMBER_OF_INPUT_PORTS
+        || _config->sample_rate < LOGIC_CAPTURE_MIN_SAMPLE_RATE
+        || _config->sample_rate > LOGIC_CAPTURE_MAX_SAMPLE_RATE
+        || _config->depth == 0
+        || _config->depth > LOGIC_CAPTURE_MAX_DEPTH
+        || _config->pre_trigger >= _config->depth
+        || _config->trigger > LOGIC_CAPTURE_TRIGGER_CHANGE)
+    {
+        return HAL_ERROR;
+    }
+
+    // only one capture at a time, and not over the one being sent, a capture done
+    // but not sent yet is dropped before the task can start sending it
+    taskENTER_CRITICAL();
+    busy = (state == LOGIC_CAPTURE_ARMED || state == LOGIC_CAPTURE_TRIGGERED || state == LOGIC_CAPTURE_SENDING);
+    if (!busy)
+    {
+        state = LOGIC_CAPTURE_IDLE;
+    }
+    taskEXIT_CRITICAL();
+
+    if (busy)
+    {
+        return HAL_BUSY;
+    }
+
+    config = *_config;
+    config.mask &= input_port_masks[config.port];
+    config.value &= config.mask;
+
+    // without a trigger, there is nothing before the first sample
+    if (config.trigger == LOGIC_CAPTURE_TRIGGER_NONE)
+    {
+        config.pre_trigger = 0;
+    }
+
+    // report the sample rate which the timer can actually achieve
+    config.sample_rate = __logic_capture_configure_timer(config.sample_rate);
+    _config->sample_rate = config.sample_rate;
+    _config->pre_trigger = config.pre_trigger;
+
+    segments_completed = 0;
+    trigger_segment = 0;
+    trigger_index = 0;
+    last_sample = input_ports[config.port]->IDR;
+    state = (config.trigger == LOGIC_CAPTURE_TRIGGER_NONE) ? LOGIC_CAPTURE_TRIGGERED : LOGIC_CAPTURE_ARMED;
+
+    // the DMA starts with the first two segments, the others are chained by the callbacks
+    if (HAL_DMAEx_MultiBufferStart_IT(hdma,
+                                      (uint32_t)&input_ports[config.port]->IDR,
+                                      (uint32_t)&logic_capture_buffer[0],
+                                      (uint32_t)&logic_capture_buffer[LOGIC_CAPTURE_SEGMENT_SIZE],
+                                      LOGIC_CAPTURE_SEGMENT_SIZE) != HAL_OK)
+    {
+        state = LOGIC_CAPTURE_IDLE;
+        return HAL_ERROR;
+    }
+
+    // each update event of the timer requests one sample
+    __HAL_TIM_SET_COUNTER(htim, 0);
+    __HAL_TIM_ENABLE_DMA(htim, TIM_DMA_UPDATE);
+    __HAL_TIM_ENABLE(htim);
+
+    return HAL_OK;
+}
+
+void logic_capture_abort(void)
+{
+    taskENTER_CRITICAL();
+    if (state == LOGIC_CAPTURE_ARMED || state == LOGIC_CAPTURE_TRIGGERED)
+    {
+        __logic_capture_stop();
+    }
+    // a capture being sent is left to the task
+    if (state != LOGIC_CAPTURE_SENDING)
+    {
+        state = LOGIC_CAPTURE_IDLE;
+    }
+    taskEXIT_CRITICAL();
+}
+
+logic_capture_state_t logic_capture_get_state(void)
+{
+    return state;
+}
+
+uint32_t logic_capture_get_length(void)
+{
+    return (state == LOGIC_CAPTURE_DONE || state == LOGIC_CAPTURE_SENDING) ? config.depth : 0;
+}
+
+void __logic_capture_m0_complete_callback(DMA_HandleTypeDef *_hdma)
+{
+    __logic_capture_segment_complete(MEMORY0);
+}
+
+void __logic_capture_m1_complete_callback(DMA_HandleTypeDef *_hdma)
+{
+    __logic_capture_segment_complete(MEMORY1);
+}
+
+/**
+ * @brief Handle a completed segment of the ring.
+ * @note The memory register which has just completed is idle now,
+ *       so it is pointed at the segment after the one being written.
+ *       While armed, the completed segment is scanned for the trigger.
+ */
+void __logic_capture_segment_complete(HAL_DMA_MemoryTypeDef memory)
+{
+    uint32_t segment = segments_completed++;
+    uint32_t next = (segment + 2) % LOGIC_CAPTURE_SEGMENTS;
+
+    HAL_DMAEx_ChangeMemory(hdma, (uint32_t)&logic_capture_buffer[next * LOGIC_CAPTURE_SEGMENT_SIZE], memory);
+
+    if (state == LOGIC_CAPTURE_ARMED)
+    {
+        uint32_t base = (segment % LOGIC_CAPTURE_SEGMENTS) * LOGIC_CAPTURE_SEGMENT_SIZE;
+        const uint16_t *samples = &logic_capture_buffer[base];
+        uint32_t i = 0;
+        uint16_t mask = config.mask;
+        uint16_t value = config.value;
+        uint16_t previous = last_sample;
+
+        // the trigger is only accepted once the pre-trigger samples are available, which
+        // takes less than the ring, the samples are not counted past it as they would wrap
+        if (segment < LOGIC_CAPTURE_SEGMENTS && config.pre_trigger > segment * LOGIC_CAPTURE_SEGMENT_SIZE)
+        {
+            i = config.pre_trigger - segment * LOGIC_CAPTURE_SEGMENT_SIZE;
+            if (i >= LOGIC_CAPTURE_SEGMENT_SIZE)
+            {
+                last_sample = samples[LOGIC_CAPTURE_SEGMENT_SIZE - 1];
+                return;
+            }
+            previous = samples[i - 1];
+        }
+
+        if (config.trigger == LOGIC_CAPTURE_TRIGGER_PATTERN)
+        {
+            bool matched = ((previous & mask) == value);
+            for (; i < LOGIC_CAPTURE_SEGMENT_SIZE; i++)
+            {
+                bool matching = ((samples[i] & mask) == value);
+                if (matching && !matched)
+                {
+                    break;
+                }
+                matched = matching;
+            }
+        }
+        else
+        {
+            for (; i < LOGIC_CAPTURE_SEGMENT_SIZE; i++)
+            {
+                if ((samples[i] ^ previous) & mask)
+                {
+                    break;
+                }
+                previous = samples[i];
+            }
+        }
+
+        last_sample = samples[LOGIC_CAPTURE_SEGMENT_SIZE - 1];
+        if (i == LOGIC_CAPTURE_SEGMENT_SIZE)
+        {
+            return;
+        }
+
+        trigger_segment = segment;
+        trigger_index = base + i;
+        state = LOGIC_CAPTURE_TRIGGERED;
+    }
+
+    // counted from the trigger segment, so it holds however long the capture was armed
+    if (state == LOGIC_CAPTURE_TRIGGERED
+        && (segments_completed - trigger_segment) * LOGIC_CAPTURE_SEGMENT_SIZE
+               >= trigger_index % LOGIC_CAPTURE_SEGMENT_SIZE + config.depth - config.pre_trigger)
+    {
+        __logic_capture_stop();
+        state = LOGIC_CAPTURE_DONE;
+
+        // wake the task to send the capture
+        if (logicCaptureTaskHandle != NULL)
+        {
+            BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+            vTaskNotifyGiveFromISR(logicCaptureTaskHandle, &xHigherPriorityTaskWoken);
+            portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+        }
+    }
+}
+
+void __logic_capture_stop(void)
+{
+    // stop the requests first, then the DMA
+    __HAL_TIM_DISABLE(htim);
+    __HAL_TIM_DISABLE_DMA(htim, TIM_DMA_UPDATE);
+    HAL_DMA_Abort_IT(hdma);
+}
+
+// Configure the update rate of the timer, return the achieved sample rate
+uint32_t __logic_capture_configure_timer(uint32_t sample_rate)
+{
+    uint32_t clock = utils_get_timer_clock(htim->Instance);
+    uint32_t ticks = clock / sample_rate;
+    uint32_t prescaler = (ticks - 1) / 65536U;
+    uint32_t period = ticks / (prescaler + 1);
+
+    __HAL_TIM_SET_PRESCALER(htim, prescaler);
+    __HAL_TIM_SET_AUTORELOAD(htim, period - 1);
+
+    // load the prescaler now instead of at the next update event
+    htim->Instance->EGR = TIM_EGR_UG;
+
+    return clock / ((prescaler + 1) * period);
+}
+
+static void prvLogicCaptureTask(void *pvParameters)
+{
+    Socket_t xListeningSocket = NULL, xConnectedSocket;
+    BaseType_t sending, result;
+
+    for (;;)
+    {
+        xConnectedSocket = tcp_server_accept(&xListeningSocket, LOGIC_CAPTURE_PORT_OFFSET, 0, 0);
+        if (xConnectedSocket == NULL)
+        {
+            continue;
+        }
+
+        FreeRTOS_debug_printf(("Logic capture client connected\n"));
+
+        while (FreeRTOS_issocketconnected(xConnectedSocket) == pdTRUE)
+        {
+            // a capture may have completed before the client connected, it is taken
+            // from W09 for as long as it is being sent
+            taskENTER_CRITICAL();
+            sending = (state == LOGIC_CAPTURE_DONE);
+            if (sending)
+            {
+                state = LOGIC_CAPTURE_SENDING;
+            }
+            taskEXIT_CRITICAL();
+
+            if (sending)
+            {
+                // a capture which failed to be sent waits for the next client
+                result = __logic_capture_send(xConnectedSocket);
+                state = (result == pdPASS) ? LOGIC_CAPTURE_IDLE : LOGIC_CAPTURE_DONE;
+                if (result != pdPASS)
+                {
+                    break;
+                }
+            }
+
+            // wait for the next capture, check the connection once in a while
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        }
+
+        FreeRTOS_shutdown(xConnectedSocket, FREERTOS_SHUT_RDWR);
+        FreeRTOS_closesocket(xConnectedSocket);
+    }
+}
+
+// Send the completed capture, run-length encoded
+BaseType_t __logic_capture_send(Socket_t xSocket)
+{
+    uint32_t start = (trigger_index + LOGIC_CAPTURE_BUFFER_SIZE - config.pre_trigger) % LOGIC_CAPTURE_BUFFER_SIZE;
+    uint16_t mask = input_port_masks[config.port];
+
+    logic_capture_header_t header = {
+        .magic = LOGIC_CAPTURE_MAGIC,
+        .sample_rate = config.sample_rate,
+        .samples = config.depth,
+        .pre_trigger = config.pre_trigger,
+        .mask = mask,
+        // count the runs first, so the client knows how much data follows
+        .records = __logic_capture_encode(NULL, start, config.depth, mask),
+    };
+
+    if (__logic_capture_send_all(xSocket, (uint8_t *)&header, sizeof(header)) != pdPASS)
+    {
+        return pdFAIL;
+    }
+
+    if (__logic_capture_encode(xSocket, start, config.depth, mask) != header.records)
+    {
+        return pdFAIL;
+    }
+
+    return pdPASS;
+}
+
+/**
+ * @brief Run-length encode samples of the ring.
+ * @param xSocket: the socket to send the records to, NULL to count the records only
+ * @param start: index in the ring of the first sample
+ * @retval number of records encoded, 0 on a send error
+ */
+uint32_t __logic_capture_encode(Socket_t xSocket, uint32_t start, uint32_t count, uint16_t mask)
+{
+    uint32_t records = 0;
+    uint16_t len = 0;
+    uint16_t value = logic_capture_buffer[start % LOGIC_CAPTURE_BUFFER_SIZE] & mask;
+    uint16_t run = 0;
+
+    for (uint32_t i = 0; i <= count; i++)
+    {
+        uint16_t sample = (i < count) ? (logic_capture_buffer[(start + i) % LOGIC_CAPTURE_BUFFER_SIZE] & mask) : ~value;
+
+        if (sample == value && run < UINT16_MAX)
+        {
+            run++;
+            continue;
+        }
+
+        // the run ends here, emit [VALUE] [COUNT]
+        records++;
+        if (xSocket != NULL)
+        {
+            send_buffer[len++] = value & 0xFF;
+            send_buffer[len++] = value >> 8;
+            send_buffer[len++] = run & 0xFF;
+            send_buffer[len++] = run >> 8;
+
+            if (len == LOGIC_CAPTURE_SEND_BUFFER_SIZE || i == count)
+            {
+                if (__logic_capture_send_all(xSocket, send_buffer, len) != pdPASS)
+                {
+                    return 0;
+                }
+                len = 0;
+            }
+        }
+
+        value = sample;
+        run = 1;
+    }
+
+    return records;
+}
+
+BaseType_t __logic_capture_send_all(Socket_t xSocket, const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        BaseType_t bytesSent = FreeRTOS_send(xSocket, data, len, 0);
+        if (bytesSent < 0)
+        {
+            return pdFAIL;
+        }
+
+        data += bytesSent;
+        len -= bytesSent;
+    }
+
+    return pdPASS;
+}
@@ -0,0 +1,422 @@
+#include "stm32f7xx_remote_io.h"
+
+static USART_TypeDef *uart;
+static DMA_HandleTypeDef *hdma_tx;
+static TaskHandle_t modbusTaskHandle = NULL;
+static SemaphoreHandle_t busMutex;
+
+static modbus_poll_t polls[MODBUS_MAX_POLLS];
+static modbus_stats_t stats[MODBUS_MAX_POLLS];
+static uint32_t last_poll[MODBUS_MAX_POLLS]; // cycle counter at the last poll of each entry
+
+// registers read from the slaves, big endian on the bus
+static uint16_t image[MODBUS_IMAGE_SIZE];
+
+static uint8_t request[8] UTILS_DMA_BUFFER; // sent by the DMA
+static uint8_t response[MODBUS_FRAME_SIZE];
+static volatile uint16_t response_length = 0;
+static volatile bool response_error = false;
+
+/* Function Prototype */
+bool __modbus_poll(uint8_t index);
+void __modbus_handle_response(uint8_t index, const modbus_poll_t *poll);
+uint16_t __modbus_crc16(const uint8_t *data, uint16_t len);
+uint32_t __modbus_get_t35_bits(void);
+static void prvModbusTask(void *pvParameters);
+
+/**
+ * @brief Initialize the Modbus RTU master.
+ * @note The UART is driven at register level, and drives the DE pin of the RS-485
+ *       transceiver by itself. The receiver of the transceiver must be disabled
+ *       while DE is active, so the requests are not echoed.
+ *       The requests are sent by DMA, the responses are received by interrupt since
+ *       both DMA streams of USART6_RX are used by the timers.
+ */
+void modbus_init(USART_TypeDef *_uart, DMA_HandleTypeDef *_hdma_tx)
+{
+    uart = _uart;
+    hdma_tx = _hdma_tx;
+
+    busMutex = xSemaphoreCreateMutex();
+    configASSERT(busMutex != NULL);
+
+    // the cycle counter measures the poll cycle times
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    if (uart == USART6)
+    {
+        __HAL_RCC_USART6_CLK_ENABLE();
+    }
+
+    // transmit DMA, memory to peripheral, one request at a time
+    hdma_tx->Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_tx->Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_tx->Init.MemInc = DMA_MINC_ENABLE;
+    hdma_tx->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_tx->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_tx->Init.Mode = DMA_NORMAL;
+    hdma_tx->Init.Priority = DMA_PRIORITY_MEDIUM;
+    hdma_tx->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(hdma_tx) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    if (modbus_configure() != HAL_OK)
+    {
+        settings.modbus_baud_rate = MODBUS_DEFAULT_BAUD_RATE;
+        settings.modbus_parity = MODBUS_DEFAULT_PARITY;
+        settings.modbus_timeout_ms = MODBUS_DEFAULT_TIMEOUT_MS;
+        modbus_configure();
+    }
+
+    xTaskCreate(prvModbusTask, "Modbus", configMINIMAL_STACK_SIZE * 2, NULL, tskIDLE_PRIORITY + 1, &modbusTaskHandle);
+}
+
+/**
+ * @brief Apply the line parameters in settings.
+ * @note A frame is 11 bits, 8 data bits and 1 stop bit with parity, or 2 stop bits
+ *       without. The receiver timeout of the UART detects the silent interval of
+ *       3.5 characters which ends a frame.
+ */
+HAL_StatusTypeDef modbus_configure(void)
+{
+    uint32_t cr1 = USART_CR1_TE | USART_CR1_RE | USART_CR1_RXNEIE | USART_CR1_RTOIE;
+    uint32_t cr2 = USART_CR2_RTOEN;
+    uint32_t cr3 = USART_CR3_DEM | USART_CR3_DMAT | USART_CR3_EIE;
+
+    if (settings.modbus_baud_rate < SERIAL_MIN_BAUD_RATE || settings.modbus_baud_rate > SERIAL_MAX_BAUD_RATE
+        || settings.modbus_parity > SERIAL_PARITY_EVEN
+        || settings.modbus_timeout_ms < MODBUS_MIN_TIMEOUT_MS || settings.modbus_timeout_ms > MODBUS_MAX_TIMEOUT_MS)
+    {
+        return HAL_ERROR;
+    }
+
+    if (settings.modbus_parity != SERIAL_PARITY_NONE)
+    {
+        // the word length includes the parity bit
+        cr1 |= USART_CR1_M0 | USART_CR1_PCE;
+        if (settings.modbus_parity == SERIAL_PARITY_ODD)
+        {
+            cr1 |= USART_CR1_PS;
+        }
+    }
+    else
+    {
+        cr2 |= USART_CR2_STOP_1;
+    }
+
+    // DE is asserted one bit time before the start bit and released one bit time after the stop bit
+    cr1 |= (16U << USART_CR1_DEAT_Pos) | (16U << USART_CR1_DEDT_Pos);
+
+    // wait for the transaction in progress
+    xSemaphoreTake(busMutex, portMAX_DELAY);
+
+    HAL_NVIC_DisableIRQ(USART6_IRQn);
+    CLEAR_BIT(uart->CR1, USART_CR1_UE);
+
+    uart->CR2 = cr2;
+    uart->CR3 = cr3;
+    uart->BRR = (HAL_RCC_GetPCLK2Freq() + settings.modbus_baud_rate / 2) / settings.modbus_baud_rate;
+    uart->RTOR = __modbus_get_t35_bits();
+    uart->ICR = USART_ICR_RTOCF | USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF | USART_ICR_PECF | USART_ICR_TCCF;
+    uart->CR1 = cr1;
+    SET_BIT(uart->CR1, USART_CR1_UE);
+
+    HAL_NVIC_SetPriority(USART6_IRQn, 6, 0);
+    HAL_NVIC_EnableIRQ(USART6_IRQn);
+
+    xSemaphoreGive(busMutex);
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Set an entry of the poll list, and clear its statistics.
+ * @note The registers of the slave are written to the image at offset, a slave of
+ *       0 disables the entry.
+ */
+HAL_StatusTypeDef modbus_set_poll(uint8_t index, const modbus_poll_t *poll)
+{
+    if (index >= MODBUS_MAX_POLLS)
+    {
+        return HAL_ERROR;
+    }
+
+    if (poll->slave != 0
+        && (poll->slave > 247
+            || (poll->function != MODBUS_READ_HOLDING_REGISTERS && poll->function != MODBUS_READ_INPUT_REGISTERS)
+            || poll->count < 1 || poll->count > MODBUS_MAX_COUNT
+            || (uint32_t)poll->offset + poll->count > MODBUS_IMAGE_SIZE))
+    {
+        return HAL_ERROR;
+    }
+
+    taskENTER_CRITICAL();
+    polls[index] = *poll;
+    memset(&stats[index], 0, sizeof(stats[index]));
+    taskEXIT_CRITICAL();
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef modbus_get_poll(uint8_t index, modbus_poll_t *poll)
+{
+    if (index >= MODBUS_MAX_POLLS)
+    {
+        return HAL_ERROR;
+    }
+
+    taskENTER_CRITICAL();
+    *poll = polls[index];
+    taskEXIT_CRITICAL();
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Copy a block of the register image.
+ * @note The block is copied at once, so the registers of one response are consistent.
+ */
+HAL_StatusTypeDef modbus_read_image(uint16_t offset, uint16_t count, uint16_t *values)
+{
+    if (count < 1 || count > MODBUS_MAX_READ || (uint32_t)offset + count > MODBUS_IMAGE_SIZE)
+    {
+        return HAL_ERROR;
+    }
+
+    taskENTER_CRITICAL();
+    memcpy(values, &image[offset], count * sizeof(uint16_t));
+    taskEXIT_CRITICAL();
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Get the statistics of a slave over all of its entries in the poll list.
+ * @note The cycle time is the longest of its entries.
+ * @retval HAL_ERROR if the slave is not polled
+ */
+HAL_StatusTypeDef modbus_get_stats(uint8_t slave, modbus_stats_t *_stats)
+{
+    HAL_StatusTypeDef status = HAL_ERROR;
+
+    memset(_stats, 0, sizeof(*_stats));
+
+    taskENTER_CRITICAL();
+    for (uint8_t i = 0; i < MODBUS_MAX_POLLS; i++)
+    {
+        if (slave == 0 || polls[i].slave != slave)
+        {
+            continue;
+        }
+
+        if (stats[i].cycle_us > _stats->cycle_us)
+        {
+            _stats->cycle_us = stats[i].cycle_us;
+        }
+        _stats->polls += stats[i].polls;
+        _stats->timeouts += stats[i].timeouts;
+        _stats->errors += stats[i].errors;
+        _stats->exceptions += stats[i].exceptions;
+        status = HAL_OK;
+    }
+    taskEXIT_CRITICAL();
+
+    return status;
+}
+
+// Called from USART6_IRQHandler
+void modbus_irq_handler(void)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    uint32_t isr = uart->ISR;
+
+    // the frame is discarded if any of its bytes is corrupted
+    if (isr & (USART_ISR_ORE | USART_ISR_FE | USART_ISR_NE | USART_ISR_PE))
+    {
+        uart->ICR = USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF | USART_ICR_PECF;
+        response_error = true;
+    }
+
+    if (isr & USART_ISR_RXNE)
+    {
+        uint8_t data = uart->RDR;
+        if (response_length < MODBUS_FRAME_SIZE)
+        {
+            response[response_length++] = data;
+        }
+        else
+        {
+            response_error = true;
+        }
+    }
+
+    // the line has been silent for 3.5 characters, the frame is complete
+    if (isr & USART_ISR_RTOF)
+    {
+        uart->ICR = USART_ICR_RTOCF;
+        if (modbusTaskHandle != NULL)
+        {
+            vTaskNotifyGiveFromISR(modbusTaskHandle, &xHigherPriorityTaskWoken);
+        }
+    }
+
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief Poll the entries of the poll list one after another.
+ * @note The end of a response is detected after the silent interval, which is also
+ *       the least time before the next request, so the requests follow each other
+ *       as fast as the bus allows.
+ */
+static void prvModbusTask(void *pvParameters)
+{
+    for (;;)
+    {
+        bool polled = false;
+
+        for (uint8_t i = 0; i < MODBUS_MAX_POLLS; i++)
+        {
+            polled |= __modbus_poll(i);
+        }
+
+        // nothing to poll, check the poll list again later
+        if (!polled)
+        {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+    }
+}
+
+// Send the request of an entry and wait for the response, false if it is disabled
+bool __modbus_poll(uint8_t index)
+{
+    modbus_poll_t poll;
+    uint16_t crc;
+    uint32_t now, wait_us;
+
+    taskENTER_CRITICAL();
+    poll = polls[index];
+    taskEXIT_CRITICAL();
+
+    if (poll.slave == 0)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(busMutex, portMAX_DELAY);
+
+    // the cycle time of an entry is the time between two of its polls
+    now = DWT->CYCCNT;
+    taskENTER_CRITICAL();
+    if (stats[index].polls > 0)
+    {
+        stats[index].cycle_us = (now - last_poll[index]) / (SystemCoreClock / 1000000);
+    }
+    stats[index].polls++;
+    taskEXIT_CRITICAL();
+    last_poll[index] = now;
+
+    request[0] = poll.slave;
+    request[1] = poll.function;
+    request[2] = poll.address >> 8;
+    request[3] = poll.address & 0xFF;
+    request[4] = poll.count >> 8;
+    request[5] = poll.count & 0xFF;
+    crc = __modbus_crc16(request, 6);
+    request[6] = crc & 0xFF;
+    request[7] = crc >> 8;
+
+    // forget whatever has been received since the last response
+    taskENTER_CRITICAL();
+    response_length = 0;
+    response_error = false;
+    taskEXIT_CRITICAL();
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    uart->ICR = USART_ICR_TCCF;
+    HAL_DMA_Start_IT(hdma_tx, (uint32_t)request, (uint32_t)&uart->TDR, sizeof(request));
+
+    // the request and the response on the wire, the silent interval, and the response timeout
+    wait_us = (uint32_t)((uint64_t)(sizeof(request) + 5 + 2 * poll.count) * 11 * 1000000 / settings.modbus_baud_rate)
+              + __modbus_get_t35_bits() * 1000000 / settings.modbus_baud_rate
+              + settings.modbus_timeout_ms * 1000U;
+
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_us / 1000) + 1) == 0)
+    {
+        taskENTER_CRITICAL();
+        stats[index].timeouts++;
+        taskEXIT_CRITICAL();
+    }
+    else
+    {
+        __modbus_handle_response(index, &poll);
+    }
+
+    xSemaphoreGive(busMutex);
+
+    return true;
+}
+
+// Check the response to the request of an entry, and copy its registers to the image
+void __modbus_handle_response(uint8_t index, const modbus_poll_t *poll)
+{
+    uint16_t len = response_length;
+    uint32_t *counter = &stats[index].errors;
+
+    if (response_error || len < 5 || response[0] != poll->slave
+        || __modbus_crc16(response, len - 2) != (response[len - 2] | response[len - 1] << 8))
+    {
+        // corrupted, or from another slave
+    }
+    else if (response[1] == (poll->function | MODBUS_EXCEPTION))
+    {
+        counter = &stats[index].exceptions;
+    }
+    else if (response[1] == poll->function && response[2] == 2 * poll->count && len == 5 + 2 * poll->count)
+    {
+        taskENTER_CRITICAL();
+        for (uint16_t i = 0; i < poll->count; i++)
+        {
+            image[poll->offset + i] = response[3 + 2 * i] << 8 | response[4 + 2 * i];
+        }
+        taskEXIT_CRITICAL();
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    (*counter)++;
+    taskEXIT_CRITICAL();
+}
+
+// CRC-16 of Modbus, polynomial 0xA001 reflected, initial value 0xFFFF, low byte sent first
+uint16_t __modbus_crc16(const uint8_t *data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    for (uint16_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+
+    return crc;
+}
+
+// Silent interval of 3.5 characters in bit times, at least 1750us
+uint32_t __modbus_get_t35_bits(void)
+{
+    if (settings.modbus_baud_rate > MODBUS_FIXED_T35_BAUD_RATE)
+    {
+        return (uint32_t)((uint64_t)MODBUS_FIXED_T35_US * settings.modbus_baud_rate / 1000000);
+    }
+
+    // 3.5 characters of 11 bits
+    return 39;
+}
@@ -0,0 +1,732 @@
+#include "stm32f7xx_remote_io.h"
+
+_Static_assert(sizeof(ota_trailer_t) == 32, "the trailer is 32 bytes at the end of the slot");
+
+static const uint32_t bank_addresses[2] = {OTA_BANK_1_ADDRESS, OTA_BANK_2_ADDRESS};
+static const uint32_t bank_sectors[2] = {OTA_BANK_1_SECTOR, OTA_BANK_2_SECTOR};
+static const uint32_t boot_addresses[2] = {OTA_BOOT_ADDRESS_1, OTA_BOOT_ADDRESS_2};
+
+// offsets of the sectors of a slot, in dual bank mode, and the end of the slot
+static const uint32_t sector_offsets[OTA_SLOT_SECTORS + 1] = {
+    0x00000, 0x04000, 0x08000, 0x0C000, 0x10000, 0x20000,
+    0x40000, 0x60000, 0x80000, 0xA0000, 0xC0000};
+
+// the flash interface and the CRC unit are shared with the settings
+static SemaphoreHandle_t flashMutex = NULL;
+
+// set while the running image has not passed the health check
+static bool dualBank = false;
+static bool trial = false;
+static bool watchdogStarted = false;
+
+// the slot being written, and the image decoded into it
+static uint8_t slotBank;
+static uint32_t slotBase;
+static uint32_t imageLength;
+static uint32_t imageCrc;
+static uint32_t written;     // bytes decoded
+static uint32_t flushed;     // bytes programmed, the rest is in the chunk
+static uint8_t nextSector;   // the next sector of the slot to be erased
+static uint32_t chunk[OTA_CHUNK_SIZE / 4];
+
+// the running image a delta is made against
+static uint32_t runningBase;
+static uint32_t runningLength;
+
+// payload received and not decoded yet
+static uint8_t input[OTA_INPUT_SIZE];
+static uint16_t inputHead;
+static uint16_t inputCount;
+
+/* Function Prototype */
+const ota_trailer_t *__ota_trailer(uint8_t bank);
+bool __ota_is_valid(uint8_t bank);
+uint32_t __ota_crc(uint32_t crc, const uint8_t *data, uint32_t length);
+HAL_StatusTypeDef __ota_program(uint32_t address, const uint32_t *data, uint32_t words);
+HAL_StatusTypeDef __ota_erase(uint32_t sector);
+HAL_StatusTypeDef __ota_set_boot_bank(uint8_t bank);
+void __ota_start_watchdog(void);
+void __ota_confirm(void);
+void __ota_map_flash(void);
+BaseType_t __ota_recv_all(Socket_t xSocket, uint8_t *buffer, uint32_t length);
+bool __ota_get(Socket_t xSocket, uint8_t *byte);
+bool __ota_get_varint(Socket_t xSocket, uint32_t *value);
+uint8_t __ota_flush(void);
+uint8_t __ota_put(uint8_t byte);
+uint8_t __ota_output(uint32_t position);
+uint8_t __ota_running(uint32_t offset);
+uint8_t __ota_decode(Socket_t xSocket, bool delta);
+uint8_t __ota_update(Socket_t xSocket);
+static void prvOtaTask(void *pvParameters);
+
+/**
+ * @brief Start the trial of a new image, or go back to the previous one.
+ * @note Called first thing in main, before HAL_Init, so that a new image which
+ *       hangs in the initialization of the clocks or the peripherals is caught by
+ *       the watchdog. The caches are still off and the tick is not running, the
+ *       flash is programmed by polling. The first boot of a new image marks its
+ *       trailer and starts the watchdog. A second boot before the image has passed
+ *       the health check switches the boot address to the other bank and resets,
+ *       unless there is no valid image to go back to. In single bank mode there is
+ *       no other bank, the image is neither put on trial nor updated.
+ */
+void ota_start_trial(void)
+{
+    const ota_trailer_t *trailer = __ota_trailer(ota_get_bank());
+    const uint32_t zero = 0;
+
+    __HAL_RCC_CRC_CLK_ENABLE();
+
+    // the sectors and the boot addresses of the banks only exist in dual bank mode
+    dualBank = (READ_BIT(FLASH->OPTCR, FLASH_OPTCR_nDBANK) == 0);
+    if (!dualBank)
+    {
+        return;
+    }
+
+    // an image loaded by the debugger has no trailer, it is taken as confirmed
+    if (trailer->magic != OTA_TRAILER_MAGIC || trailer->confirmed == 0)
+    {
+        return;
+    }
+
+    if (trailer->trial == 0xFFFFFFFF)
+    {
+        __ota_program((uint32_t)&trailer->trial, &zero, 1);
+    }
+    else if (__ota_is_valid(ota_get_bank() ^ 1) && __ota_set_boot_bank(ota_get_bank() ^ 1) == HAL_OK)
+    {
+        NVIC_SystemReset();
+    }
+
+    trial = true;
+    __ota_start_watchdog();
+}
+
+/**
+ * @brief Map the flash programmed at run time non-cacheable and create its lock.
+ * @note Called before the settings are loaded, once the MPU is configured.
+ */
+void ota_init(void)
+{
+    flashMutex = xSemaphoreCreateMutex();
+
+    if (dualBank)
+    {
+        __ota_map_flash();
+    }
+}
+
+void ota_start_task(void)
+{
+    xTaskCreate(prvOtaTask, "OTA", configMINIMAL_STACK_SIZE * 2, NULL, tskIDLE_PRIORITY + 1, NULL);
+}
+
+/**
+ * @brief Get the bank the code runs from.
+ * @retval 0 for bank 1, 1 for bank 2
+ */
+uint8_t ota_get_bank(void)
+{
+    return ((uint32_t)&ota_get_bank >= OTA_BANK_2_ADDRESS) ? 1 : 0;
+}
+
+bool ota_is_trial(void)
+{
+    return trial;
+}
+
+void ota_lock_flash(void)
+{
+    xSemaphoreTake(flashMutex, portMAX_DELAY);
+}
+
+void ota_unlock_flash(void)
+{
+    xSemaphoreGive(flashMutex);
+}
+
+// Called by the idle task, the watchdog runs from the trial of an image to the next reset
+void ota_refresh_watchdog(void)
+{
+    if (watchdogStarted)
+    {
+        IWDG->KR = 0xAAAA;
+    }
+}
+
+const ota_trailer_t *__ota_trailer(uint8_t bank)
+{
+    return (const ota_trailer_t *)(bank_addresses[bank] + OTA_SLOT_SIZE - sizeof(ota_trailer_t));
+}
+
+/**
+ * @brief Check the image in a slot before booting it.
+ * @note The reset vector has to point into the slot. An image with a trailer has
+ *       to have passed the health check and still match its CRC. A slot left
+ *       incomplete by an update has no trailer either, but it is never the image
+ *       which ran before the one on trial.
+ */
+bool __ota_is_valid(uint8_t bank)
+{
+    const uint32_t *vectors = (const uint32_t *)bank_addresses[bank];
+    const ota_trailer_t *trailer = __ota_trailer(bank);
+
+    if (vectors[1] < bank_addresses[bank] || vectors[1] >= bank_addresses[bank] + OTA_IMAGE_MAX_SIZE)
+    {
+        return false;
+    }
+
+    if (trailer->magic != OTA_TRAILER_MAGIC)
+    {
+        return true;
+    }
+
+    return trailer->confirmed == 0 && trailer->length <= OTA_IMAGE_MAX_SIZE
+           && __ota_crc(0xFFFFFFFF, (const uint8_t *)vectors, trailer->length) == trailer->crc;
+}
+
+/**
+ * @brief Continue the CRC-32/MPEG-2 of an image by the CRC unit.
+ * @note The unit is fed byte by byte, so the CRC is the one of the image as a byte
+ *       stream, whatever its length. The running value is carried over in the INIT
+ *       register, which is left at its default for the settings.
+ */
+uint32_t __ota_crc(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+    CRC->INIT = crc;
+    CRC->CR = CRC_CR_RESET;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        *(__IO uint8_t *)&CRC->DR = data[i];
+    }
+    crc = CRC->DR;
+    CRC->INIT = 0xFFFFFFFF;
+
+    return crc;
+}
+
+HAL_StatusTypeDef __ota_program(uint32_t address, const uint32_t *data, uint32_t words)
+{
+    HAL_StatusTypeDef status = HAL_OK;
+
+    HAL_FLASH_Unlock();
+    for (uint32_t i = 0; i < words && status == HAL_OK; i++)
+    {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address + i * 4, data[i]);
+    }
+    HAL_FLASH_Lock();
+
+    return status;
+}
+
+// Erase a sector of the other bank, the code keeps running and the task sleeps meanwhile
+HAL_StatusTypeDef __ota_erase(uint32_t sector)
+{
+    HAL_StatusTypeDef status = HAL_OK;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_ALL_ERRORS);
+
+    FLASH_Erase_Sector(sector, FLASH_VOLTAGE_RANGE_3);
+    while (__HAL_FLASH_GET_FLAG(FLASH_FLAG_BSY))
+    {
+        vTaskDelay(pdMS_TO_TICKS(OTA_ERASE_POLL_MS));
+    }
+
+    if (__HAL_FLASH_GET_FLAG(FLASH_FLAG_ALL_ERRORS))
+    {
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+        status = HAL_ERROR;
+    }
+
+    CLEAR_BIT(FLASH->CR, FLASH_CR_SER | FLASH_CR_SNB);
+    HAL_FLASH_Lock();
+
+    return status;
+}
+
+// Boot from a bank from the next reset on
+HAL_StatusTypeDef __ota_set_boot_bank(uint8_t bank)
+{
+    FLASH_OBProgramInitTypeDef ob = {0};
+    HAL_StatusTypeDef status;
+
+    ob.OptionType = OPTIONBYTE_BOOTADDR_0;
+    ob.BootAddr0 = boot_addresses[bank];
+
+    HAL_FLASH_Unlock();
+    HAL_FLASH_OB_Unlock();
+    status = HAL_FLASHEx_OBProgram(&ob);
+    if (status == HAL_OK)
+    {
+        status = HAL_FLASH_OB_Launch();
+    }
+    HAL_FLASH_OB_Lock();
+    HAL_FLASH_Lock();
+
+    return status;
+}
+
+// Start the independent watchdog, it cannot be stopped until the next reset
+void __ota_start_watchdog(void)
+{
+    IWDG->KR = 0xCCCC;
+    IWDG->KR = 0x5555;
+    IWDG->PR = OTA_WATCHDOG_PRESCALER;
+    IWDG->RLR = OTA_WATCHDOG_RELOAD;
+    while (IWDG->SR != 0)
+    {
+    }
+    IWDG->KR = 0xAAAA;
+
+    watchdogStarted = true;
+}
+
+// The image has passed the health check, it keeps being booted
+void __ota_confirm(void)
+{
+    const ota_trailer_t *trailer = __ota_trailer(ota_get_bank());
+    const uint32_t zero = 0;
+
+    ota_lock_flash();
+    if (__ota_program((uint32_t)&trailer->confirmed, &zero, 1) == HAL_OK)
+    {
+        trial = false;
+    }
+    ota_unlock_flash();
+}
+
+/**
+ * @brief Map the flash programmed at run time non-cacheable.
+ * @note The data cache keeps the lines read from the flash across an erase or a
+ *       programming, so the other bank and the trailer of the running image are
+ *       read past it. Every other region of the flash never changes while running.
+ */
+void __ota_map_flash(void)
+{
+    MPU_Region_InitTypeDef region = {0};
+
+    region.Enable = MPU_REGION_ENABLE;
+    region.TypeExtField = MPU_TEX_LEVEL1;
+    region.AccessPermission = MPU_REGION_FULL_ACCESS;
+    region.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+    region.IsShareable = MPU_ACCESS_NOT_SHAREABLE;
+    region.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+    region.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+
+    HAL_MPU_Disable();
+
+    region.Number = OTA_MPU_REGION_BANK;
+    region.BaseAddress = bank_addresses[ota_get_bank() ^ 1];
+    region.Size = MPU_REGION_SIZE_1MB;
+    HAL_MPU_ConfigRegion(&region);
+
+    region.Number = OTA_MPU_REGION_TRAILER;
+    region.BaseAddress = (uint32_t)__ota_trailer(ota_get_bank());
+    region.Size = MPU_REGION_SIZE_32B;
+    HAL_MPU_ConfigRegion(&region);
+
+    HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+}
+
+// Receive exactly length bytes, within the receive timeout of the socket
+BaseType_t __ota_recv_all(Socket_t xSocket, uint8_t *buffer, uint32_t length)
+{
+    while (length > 0)
+    {
+        BaseType_t received = FreeRTOS_recv(xSocket, buffer, length, 0);
+        if (received <= 0)
+        {
+            return pdFAIL;
+        }
+        buffer += received;
+        length -= received;
+    }
+
+    return pdPASS;
+}
+
+// Take the next byte of the payload, refilling the input from the socket
+bool __ota_get(Socket_t xSocket, uint8_t *byte)
+{
+    if (inputHead == inputCount)
+    {
+        BaseType_t received = FreeRTOS_recv(xSocket, input, sizeof(input), 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+        inputHead = 0;
+        inputCount = received;
+    }
+
+    *byte = input[inputHead++];
+    return true;
+}
+
+// Take a LEB128 varint of the payload, 7 bits per byte from the lowest, bit 7 set if more follow
+bool __ota_get_varint(Socket_t xSocket, uint32_t *value)
+{
+    uint8_t byte;
+
+    *value = 0;
+    for (uint8_t shift = 0; shift < 32; shift += 7)
+    {
+        if (!__ota_get(xSocket, &byte))
+        {
+            return false;
+        }
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Program the decoded bytes held in the chunk.
+ * @note The first chunk is checked to be linked for the slot before anything is
+ *       erased. Then the trailer sector is erased, so the slot is never taken as
+ *       valid while it is written, and every other sector just before the image
+ *       reaches it. The CRC is taken from the flash once programmed.
+ */
+uint8_t __ota_flush(void)
+{
+    uint32_t length = written - flushed;
+    HAL_StatusTypeDef status = HAL_OK;
+
+    // the last word is padded with the erased value
+    for (uint32_t i = length; i % 4 != 0; i++)
+    {
+        ((uint8_t *)chunk)[i] = 0xFF;
+    }
+
+    ota_lock_flash();
+
+    if (flushed == 0)
+    {
+        // the reset vector of an image linked for the running bank points there
+        if (chunk[1] < slotBase || chunk[1] >= slotBase + OTA_IMAGE_MAX_SIZE)
+        {
+            ota_unlock_flash();
+            return OTA_ERROR_BANK;
+        }
+
+        status = __ota_erase(bank_sectors[slotBank] + OTA_SLOT_SECTORS - 1);
+    }
+
+    while (nextSector < OTA_SLOT_SECTORS - 1 && sector_offsets[nextSector] < written && status == HAL_OK)
+    {
+        status = __ota_erase(bank_sectors[slotBank] + nextSector);
+        nextSector++;
+    }
+
+    if (status == HAL_OK)
+    {
+        status = __ota_program(slotBase + flushed, chunk, (length + 3) / 4);
+        imageCrc = __ota_crc(imageCrc, (const uint8_t *)(slotBase + flushed), length);
+    }
+
+    ota_unlock_flash();
+    ota_refresh_watchdog();
+
+    flushed = written;
+    return (status == HAL_OK) ? OTA_OK : OTA_ERROR_FLASH;
+}
+
+// Append a decoded byte to the image, the chunk is programmed once full
+uint8_t __ota_put(uint8_t byte)
+{
+    if (written >= imageLength)
+    {
+        return OTA_ERROR_DECODE;
+    }
+
+    ((uint8_t *)chunk)[written - flushed] = byte;
+    written++;
+
+    if (written - flushed == OTA_CHUNK_SIZE || written == imageLength)
+    {
+        return __ota_flush();
+    }
+    return OTA_OK;
+}
+
+// A byte decoded before, from the chunk or from the flash once programmed
+uint8_t __ota_output(uint32_t position)
+{
+    return (position >= flushed) ? ((uint8_t *)chunk)[position - flushed] : *(const uint8_t *)(slotBase + position);
+}
+
+// A byte of the running image, relocated to the slot being written
+uint8_t __ota_running(uint32_t offset)
+{
+    uint32_t word = *(const uint32_t *)(runningBase + (offset & ~3U));
+
+    if (word >= runningBase && word < runningBase + OTA_SLOT_SIZE)
+    {
+        word = word - runningBase + slotBase;
+    }
+
+    return word >> (8 * (offset & 3));
+}
+
+/**
+ * @brief Decode the sequences of a compressed or delta payload into the image.
+ * @note A match may overlap the bytes it produces, e.g. a run of one byte repeated
+ *       is a match at distance 1, so it is copied byte by byte.
+ */
+uint8_t __ota_decode(Socket_t xSocket, bool delta)
+{
+    uint32_t literals, match, reference, extra, source;
+    uint8_t token, byte, result = OTA_OK;
+
+    while (written < imageLength && result == OTA_OK)
+    {
+        if (!__ota_get(xSocket, &token))
+        {
+            return OTA_ERROR_DATA;
+        }
+
+        literals = token >> 4;
+        match = token & 0x0F;
+        if (literals == 15)
+        {
+            if (!__ota_get_varint(xSocket, &extra))
+            {
+                return OTA_ERROR_DATA;
+            }
+            literals += extra;
+        }
+
+        for (uint32_t i = 0; i < literals && result == OTA_OK; i++)
+        {
+            if (!__ota_get(xSocket, &byte))
+            {
+                return OTA_ERROR_DATA;
+            }
+            result = __ota_put(byte);
+        }
+
+        if (match == 0 || result != OTA_OK)
+        {
+            continue;
+        }
+
+        match += OTA_MIN_MATCH - 1;
+        if (match == 15 + OTA_MIN_MATCH - 1)
+        {
+            if (!__ota_get_varint(xSocket, &extra))
+            {
+                return OTA_ERROR_DATA;
+            }
+            match += extra;
+        }
+
+        if (!__ota_get_varint(xSocket, &reference))
+        {
+            return OTA_ERROR_DATA;
+        }
+
+        if (reference & 1)
+        {
+            // the offset in the running image relative to the position, zigzag encoded
+            reference >>= 1;
+            source = written + ((reference & 1) ? ~(reference >> 1) : (reference >> 1));
+            if (!delta || source >= runningLength || match > runningLength - source)
+            {
+                return OTA_ERROR_DECODE;
+            }
+
+            for (uint32_t i = 0; i < match && result == OTA_OK; i++)
+            {
+                result = __ota_put(__ota_running(source + i));
+            }
+        }
+        else
+        {
+            // the distance back in the new image
+            reference >>= 1;
+            if (reference == 0 || reference > written)
+            {
+                return OTA_ERROR_DECODE;
+            }
+
+            for (uint32_t i = 0; i < match && result == OTA_OK; i++)
+            {
+                result = __ota_put(__ota_output(written - reference));
+            }
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Receive an image into the other bank and boot from it at the next reset.
+ * @note The image is programmed chunk by chunk as it is decoded, while the following
+ *       payload is received into the window of the socket. A raw payload is the image
+ *       itself. A delta has to be made against the running image, checked by its CRC.
+ *       The image in the running bank is not touched.
+ * @retval OTA_OK, or OTA_ERROR_x
+ */
+uint8_t __ota_update(Socket_t xSocket)
+{
+    const ota_trailer_t *slot_trailer;
+    ota_trailer_t trailer;
+    ota_header_t header;
+    HAL_StatusTypeDef status;
+    uint8_t result = OTA_OK, byte;
+
+    if (!dualBank)
+    {
+        return OTA_ERROR_SINGLE_BANK;
+    }
+
+    if (trial)
+    {
+        return OTA_ERROR_BUSY;
+    }
+
+    if (__ota_recv_all(xSocket, (uint8_t *)&header, sizeof(header)) != pdPASS
+        || header.magic != OTA_MAGIC || header.length < 8 || header.length > OTA_IMAGE_MAX_SIZE
+        || header.encoding > OTA_ENCODING_DELTA)
+    {
+        return OTA_ERROR_HEADER;
+    }
+
+    slotBank = ota_get_bank() ^ 1;
+    slotBase = bank_addresses[slotBank];
+    slot_trailer = __ota_trailer(slotBank);
+    runningBase = bank_addresses[ota_get_bank()];
+    runningLength = header.base_length;
+    imageLength = header.length;
+    imageCrc = 0xFFFFFFFF;
+    written = 0;
+    flushed = 0;
+    nextSector = 0;
+    inputHead = 0;
+    inputCount = 0;
+
+    if (header.encoding == OTA_ENCODING_DELTA)
+    {
+        ota_lock_flash();
+        if (runningLength > OTA_IMAGE_MAX_SIZE
+            || __ota_crc(0xFFFFFFFF, (const uint8_t *)runningBase, runningLength) != header.base_crc)
+        {
+            result = OTA_ERROR_BASE;
+        }
+        ota_unlock_flash();
+    }
+
+    if (header.encoding == OTA_ENCODING_RAW)
+    {
+        while (written < imageLength && result == OTA_OK)
+        {
+            result = __ota_get(xSocket, &byte) ? __ota_put(byte) : OTA_ERROR_DATA;
+        }
+    }
+    else if (result == OTA_OK)
+    {
+        result = __ota_decode(xSocket, header.encoding == OTA_ENCODING_DELTA);
+    }
+
+    if (result != OTA_OK)
+    {
+        return result;
+    }
+
+    if (imageCrc != header.crc)
+    {
+        return OTA_ERROR_CRC;
+    }
+
+    // the magic is programmed last, after the length and the CRC
+    trailer.magic = OTA_TRAILER_MAGIC;
+    trailer.length = header.length;
+    trailer.crc = header.crc;
+
+    ota_lock_flash();
+    status = __ota_program((uint32_t)&slot_trailer->length, &trailer.length, 2);
+    if (status == HAL_OK)
+    {
+        status = __ota_program((uint32_t)&slot_trailer->magic, &trailer.magic, 1);
+    }
+    if (status == HAL_OK && __ota_set_boot_bank(slotBank) != HAL_OK)
+    {
+        result = OTA_ERROR_BOOT;
+    }
+    ota_unlock_flash();
+
+    if (status != HAL_OK)
+    {
+        return OTA_ERROR_FLASH;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Serve the update socket, and confirm the running image once it is healthy.
+ */
+static void prvOtaTask(void *pvParameters)
+{
+    static const TickType_t xReceiveTimeOut = pdMS_TO_TICKS(OTA_RECEIVE_TIMEOUT_MS);
+    Socket_t xListeningSocket = NULL, xConnectedSocket;
+    uint32_t accept_us;
+    char reply[8];
+    uint8_t result, len;
+
+    for (;;)
+    {
+        if (trial && boot_get_time(BOOT_PHASE_ACCEPT, &accept_us)
+            && xTaskGetTickCount() >= pdMS_TO_TICKS(OTA_HEALTH_CHECK_MS))
+        {
+            __ota_confirm();
+        }
+
+        xConnectedSocket = tcp_server_accept(&xListeningSocket, OTA_PORT_OFFSET, 0, OTA_RX_BUFFER_SIZE);
+        if (xConnectedSocket == NULL)
+        {
+            continue;
+        }
+
+        FreeRTOS_setsockopt(xConnectedSocket, 0, FREERTOS_SO_RCVTIMEO, &xReceiveTimeOut, sizeof(xReceiveTimeOut));
+        result = __ota_update(xConnectedSocket);
+
+        if (result == OTA_OK)
+        {
+            memcpy(reply, "OK", 2);
+            len = 2;
+        }
+        else
+        {
+            memcpy(reply, "ERR", 3);
+            len = 3 + utils_format_uint(reply + 3, result, 1);
+        }
+        reply[len++] = '\r';
+        reply[len++] = '\n';
+        FreeRTOS_send(xConnectedSocket, reply, len, 0);
+
+        if (result == OTA_OK)
+        {
+            // let the reply be acknowledged before the restart
+            for (uint8_t i = 0; i < 100 && FreeRTOS_outstanding(xConnectedSocket) > 0; i++)
+            {
+                vTaskDelay(pdMS_TO_TICKS(10));
+            }
+        }
+
+        FreeRTOS_shutdown(xConnectedSocket, FREERTOS_SHUT_RDWR);
+        FreeRTOS_closesocket(xConnectedSocket);
+
+        if (result == OTA_OK)
+        {
+            NVIC_SystemReset();
+        }
+    }
+}
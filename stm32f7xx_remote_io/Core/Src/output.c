@@ -0,0 +1,116 @@
+#include "stm32f7xx_remote_io.h"
+
+static GPIO_TypeDef *const output_ports[NUMBER_OF_OUTPUT_PORTS] = OUTPUT_PORT_TABLE;
+
+// lookup from output number to its port and pin
+static const cpu_map_pin_t output_pins[NUMBER_OF_OUTPUTS] = OUTPUT_PIN_TABLE;
+
+HAL_StatusTypeDef output_write(uint8_t output, uint8_t value)
+{
+    if (output >= NUMBER_OF_OUTPUTS)
+    {
+        return HAL_ERROR;
+    }
+
+    // the upper half of BSRR resets pins, the lower half sets them
+    output_ports[output_pins[output].port]->BSRR = value ? output_pins[output].mask : ((uint32_t)output_pins[output].mask << 16);
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Write the outputs selected by mask to the corresponding bits of value.
+ * @note The BSRR words of all ports are prepared first, then stored back to back,
+ *       so outputs on the same port change at the same time and outputs on
+ *       different ports change within a few bus cycles of each other.
+ */
+HAL_StatusTypeDef output_write_masked(uint32_t mask, uint32_t value)
+{
+    uint32_t bsrr[NUMBER_OF_OUTPUT_PORTS] = {0};
+
+    if (mask & ~OUTPUT_ALL_MASK)
+    {
+        return HAL_ERROR;
+    }
+
+    // visit only the selected outputs
+    while (mask)
+    {
+        uint8_t output = __builtin_ctz(mask);
+        uint32_t pin = output_pins[output].mask;
+
+        bsrr[output_pins[output].port] |= (value & (1UL << output)) ? pin : (pin << 16);
+        mask &= mask - 1;
+    }
+
+    // keep the stores together, an interrupt in between would skew the ports
+    taskENTER_CRITICAL();
+    for (uint8_t port = 0; port < NUMBER_OF_OUTPUT_PORTS; port++)
+    {
+        if (bsrr[port])
+        {
+            output_ports[port]->BSRR = bsrr[port];
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return HAL_OK;
+}
+
+int8_t output_read(uint8_t output)
+{
+    if (output >= NUMBER_OF_OUTPUTS)
+    {
+        return -1;
+    }
+
+    return (output_ports[output_pins[output].port]->ODR & output_pins[output].mask) ? 1 : 0;
+}
+
+// Read all outputs as a bitmap, bit n is output n
+uint32_t output_read_all(void)
+{
+    uint16_t odr[NUMBER_OF_OUTPUT_PORTS];
+    uint32_t outputs = 0;
+
+    // snapshot the ports first so the bitmap is as coherent as possible
+    for (uint8_t port = 0; port < NUMBER_OF_OUTPUT_PORTS; port++)
+    {
+        odr[port] = output_ports[port]->ODR;
+    }
+
+    for (uint8_t output = 0; output < NUMBER_OF_OUTPUTS; output++)
+    {
+        if (odr[output_pins[output].port] & output_pins[output].mask)
+        {
+            outputs |= 1UL << output;
+        }
+    }
+
+    return outputs;
+}
+
+// Map a bitmap of outputs to the pins of each output port
+void output_map(uint32_t outputs, uint16_t pins[NUMBER_OF_OUTPUT_PORTS])
+{
+    memset(pins, 0, NUMBER_OF_OUTPUT_PORTS * sizeof(uint16_t));
+
+    outputs &= OUTPUT_ALL_MASK;
+    while (outputs)
+    {
+        uint8_t output = __builtin_ctz(outputs);
+
+        pins[output_pins[output].port] |= output_pins[output].mask;
+        outputs &= outputs - 1;
+    }
+}
+
+GPIO_TypeDef *output_get_port(uint8_t port)
+{
+    if (port >= NUMBER_OF_OUTPUT_PORTS)
+    {
+        return NULL;
+    }
+
+    return output_ports[port];
+}
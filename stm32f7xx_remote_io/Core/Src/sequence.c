@@ -0,0 +1,251 @@
+#include "stm32f7xx_remote_io.h"
+
+// entries as uploaded by the client
+static sequence_entry_t sequence_entries[SEQUENCE_MAX_LENGTH];
+
+// DMA data compiled from the entries
+static uint32_t sequence_bsrr[SEQUENCE_MAX_LENGTH] UTILS_DMA_BUFFER; // written to GPIOx->BSRR at the update event
+static uint32_t sequence_arr[SEQUENCE_MAX_LENGTH] UTILS_DMA_BUFFER;  // written to TIMx->ARR at the compare event of channel 2
+
+static TIM_HandleTypeDef *htim;
+static DMA_HandleTypeDef *hdma_bsrr;
+static DMA_HandleTypeDef *hdma_arr;
+
+static volatile sequence_state_t state = SEQUENCE_IDLE;
+static volatile uint32_t cycles = 0; // number of times the sequence has been played
+static uint8_t mode = 0;
+
+/* Function Prototype */
+HAL_StatusTypeDef __sequence_compile(uint16_t length, uint8_t *port);
+void __sequence_bsrr_complete_callback(DMA_HandleTypeDef *_hdma);
+HAL_StatusTypeDef __sequence_set_dma_mode(DMA_HandleTypeDef *_hdma, uint32_t dma_mode);
+
+void sequence_init(TIM_HandleTypeDef *_htim, DMA_HandleTypeDef *_hdma_bsrr, DMA_HandleTypeDef *_hdma_arr)
+{
+    // save the timer and DMA handles
+    htim = _htim;
+    hdma_bsrr = _hdma_bsrr;
+    hdma_arr = _hdma_arr;
+
+    // count the played sequences, and stop at the end of a one-shot sequence
+    hdma_bsrr->XferCpltCallback = __sequence_bsrr_complete_callback;
+
+    // run the counter at 1MHz
+    __HAL_TIM_SET_PRESCALER(htim, (utils_get_timer_clock(htim->Instance) / SEQUENCE_TICK_FREQ) - 1U);
+    __HAL_TIM_SET_COMPARE(htim, TIM_CHANNEL_2, SEQUENCE_COMPARE_TICK);
+
+    // the trigger input is only enabled while waiting for a trigger
+    CLEAR_BIT(htim->Instance->SMCR, TIM_SMCR_SMS);
+
+    state = SEQUENCE_IDLE;
+}
+
+HAL_StatusTypeDef sequence_set_entry(uint16_t index, sequence_entry_t *entry)
+{
+    if (index >= SEQUENCE_MAX_LENGTH
+        || entry->delay_us < SEQUENCE_MIN_DELAY_US
+        || entry->set > 1
+        || (entry->outputs & ~OUTPUT_ALL_MASK) != 0)
+    {
+        return HAL_ERROR;
+    }
+
+    // the entries are compiled into DMA data on start, so they can be edited during playback
+    sequence_entries[index] = *entry;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef sequence_get_entry(uint16_t index, sequence_entry_t *entry)
+{
+    if (index >= SEQUENCE_MAX_LENGTH)
+    {
+        return HAL_ERROR;
+    }
+
+    *entry = sequence_entries[index];
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Start playing the first length entries.
+ * @note At every update event of the timer, the DMA writes the next BSRR value to
+ *       the output port, so edges land on timer ticks without CPU involvement.
+ *       Shortly after the update event, the compare event of channel 2 makes another
+ *       DMA write the delay of the entry into the preloaded auto-reload register,
+ *       which becomes the length of the period at the next update event.
+ */
+HAL_StatusTypeDef sequence_start(uint16_t length, uint8_t _mode)
+{
+    uint8_t port;
+
+    if (state != SEQUENCE_IDLE)
+    {
+        return HAL_BUSY;
+    }
+
+    if (length == 0 || length > SEQUENCE_MAX_LENGTH || _mode > (SEQUENCE_MODE_LOOP | SEQUENCE_MODE_TRIGGER))
+    {
+        return HAL_ERROR;
+    }
+
+    // all outputs of a sequence must be on one port
+    if (__sequence_compile(length, &port) != HAL_OK)
+    {
+        return HAL_ERROR;
+    }
+
+    // both streams are released at the end of the previous sequence, one still
+    // busy would refuse to start and fail every sequence after it
+    if (hdma_bsrr->State != HAL_DMA_STATE_READY || hdma_arr->State != HAL_DMA_STATE_READY)
+    {
+        return HAL_ERROR;
+    }
+
+    mode = _mode;
+    cycles = 0;
+
+    uint32_t dma_mode = (mode & SEQUENCE_MODE_LOOP) ? DMA_CIRCULAR : DMA_NORMAL;
+    if (__sequence_set_dma_mode(hdma_bsrr, dma_mode) != HAL_OK || __sequence_set_dma_mode(hdma_arr, dma_mode) != HAL_OK)
+    {
+        return HAL_ERROR;
+    }
+
+    // the first period is the shortest possible, the first entry is written at its end
+    __HAL_TIM_DISABLE(htim);
+    __HAL_TIM_DISABLE_DMA(htim, TIM_DMA_UPDATE | TIM_DMA_CC2);
+    __HAL_TIM_SET_AUTORELOAD(htim, SEQUENCE_MIN_DELAY_US);
+    htim->Instance->EGR = TIM_EGR_UG;
+    __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE | TIM_FLAG_CC2);
+
+    if (HAL_DMA_Start(hdma_arr, (uint32_t)sequence_arr, (uint32_t)&htim->Instance->ARR, length) != HAL_OK)
+    {
+        return HAL_ERROR;
+    }
+
+    if (HAL_DMA_Start_IT(hdma_bsrr, (uint32_t)sequence_bsrr, (uint32_t)&output_get_port(port)->BSRR, length) != HAL_OK)
+    {
+        HAL_DMA_Abort(hdma_arr);
+        return HAL_ERROR;
+    }
+
+    __HAL_TIM_ENABLE_DMA(htim, TIM_DMA_UPDATE | TIM_DMA_CC2);
+
+    if (mode & SEQUENCE_MODE_TRIGGER)
+    {
+        // the counter is enabled by the hardware at the rising edge of TI1
+        MODIFY_REG(htim->Instance->SMCR, TIM_SMCR_TS | TIM_SMCR_SMS, TIM_TS_TI1FP1 | TIM_SLAVEMODE_TRIGGER);
+        state = SEQUENCE_WAITING_TRIGGER;
+    }
+    else
+    {
+        CLEAR_BIT(htim->Instance->SMCR, TIM_SMCR_SMS);
+        state = SEQUENCE_RUNNING;
+        __HAL_TIM_ENABLE(htim);
+    }
+
+    return HAL_OK;
+}
+
+void sequence_stop(void)
+{
+    taskENTER_CRITICAL();
+    __HAL_TIM_DISABLE(htim);
+    __HAL_TIM_DISABLE_DMA(htim, TIM_DMA_UPDATE | TIM_DMA_CC2);
+    CLEAR_BIT(htim->Instance->SMCR, TIM_SMCR_SMS);
+    state = SEQUENCE_IDLE;
+    taskEXIT_CRITICAL();
+
+    HAL_DMA_Abort(hdma_bsrr);
+    HAL_DMA_Abort(hdma_arr);
+}
+
+sequence_state_t sequence_get_state(void)
+{
+    // the counter has been started by the trigger
+    if (state == SEQUENCE_WAITING_TRIGGER && (htim->Instance->CR1 & TIM_CR1_CEN))
+    {
+        state = SEQUENCE_RUNNING;
+    }
+
+    return state;
+}
+
+uint32_t sequence_get_cycles(void)
+{
+    return cycles;
+}
+
+// Compile the entries into BSRR and ARR values for the DMA
+HAL_StatusTypeDef __sequence_compile(uint16_t length, uint8_t *port)
+{
+    int8_t sequence_port = -1;
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        sequence_entry_t *entry = &sequence_entries[i];
+        uint16_t port_pins[NUMBER_OF_OUTPUT_PORTS];
+        uint16_t pins = 0;
+
+        if (entry->delay_us < SEQUENCE_MIN_DELAY_US)
+        {
+            return HAL_ERROR;
+        }
+
+        output_map(entry->outputs, port_pins);
+        for (uint8_t p = 0; p < NUMBER_OF_OUTPUT_PORTS; p++)
+        {
+            if (!port_pins[p])
+            {
+                continue;
+            }
+
+            // all outputs of a sequence must be on one port
+            if (sequence_port >= 0 && sequence_port != p)
+            {
+                return HAL_ERROR;
+            }
+            sequence_port = p;
+            pins = port_pins[p];
+        }
+
+        // the upper half of BSRR resets pins, the lower half sets them
+        sequence_bsrr[i] = entry->set ? pins : ((uint32_t)pins << 16);
+        sequence_arr[i] = entry->delay_us - 1U;
+    }
+
+    // a sequence without any output only produces delays
+    *port = (sequence_port < 0) ? 0 : sequence_port;
+
+    return HAL_OK;
+}
+
+void __sequence_bsrr_complete_callback(DMA_HandleTypeDef *_hdma)
+{
+    cycles++;
+
+    if (!(mode & SEQUENCE_MODE_LOOP))
+    {
+        // the last entry has been written, stop the timer before it requests more data
+        __HAL_TIM_DISABLE(htim);
+        __HAL_TIM_DISABLE_DMA(htim, TIM_DMA_UPDATE | TIM_DMA_CC2);
+        CLEAR_BIT(htim->Instance->SMCR, TIM_SMCR_SMS);
+
+        // the stream of ARR has no interrupt, so an abort by interrupt would never
+        // complete and leave it busy, it is drained by now so the abort is immediate
+        HAL_DMA_Abort(hdma_arr);
+        state = SEQUENCE_IDLE;
+    }
+}
+
+HAL_StatusTypeDef __sequence_set_dma_mode(DMA_HandleTypeDef *_hdma, uint32_t dma_mode)
+{
+    if (_hdma->Init.Mode == dma_mode)
+    {
+        return HAL_OK;
+    }
+
+    _hdma->Init.Mode = dma_mode;
+    return HAL_DMA_Init(_hdma);
+}
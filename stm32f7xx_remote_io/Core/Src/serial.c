@@ -0,0 +1,826 @@
+#include "stm32f7xx_remote_io.h"
+#include "stream_buffer.h"
+
+// circular buffer written by the receive DMA
+static uint8_t serial_rx_buffer[SERIAL_RX_BUFFER_SIZE] UTILS_DMA_BUFFER;
+static uint16_t rx_tail = 0; // position up to which data has been handed to the stream buffer
+
+static USART_TypeDef *uart;
+static DMA_HandleTypeDef *hdma_rx;
+static DMA_HandleTypeDef *hdma_tx;
+
+static StreamBufferHandle_t rxStreamBuffer;
+static SemaphoreHandle_t txDoneSemaphore;
+static SemaphoreHandle_t txMutex;
+static TaskHandle_t readerTaskHandle = NULL;
+
+// while a tunnel is open, received data is read in place from the DMA buffer
+static TaskHandle_t tunnelTaskHandle = NULL;
+static volatile uint32_t tunnel_received = 0; // bytes received since the tunnel was opened
+static uint32_t tunnel_consumed = 0;          // bytes handed to the tunnel
+static uint16_t tunnel_read = 0;              // position of the next byte to hand to the tunnel
+static bool tunnel_in_place = false;          // set if the tunnel reads unframed data from the DMA buffer
+
+// frames are assembled from the stream buffer by the reader, positions count the bytes ever passed
+static uint8_t frame_buffer[SERIAL_FRAME_SIZE];
+static size_t frame_fill = 0;              // bytes in the frame buffer
+static uint32_t frame_read = 0;            // bytes moved from the stream buffer to the frame buffer
+static volatile uint32_t rx_pushed = 0;    // bytes written into the stream buffer
+static volatile bool frame_reset = false;  // set when the framing has changed
+static uint8_t frame_mode = UINT8_MAX;     // framing applied by serial_configure(), none yet
+static uint16_t frame_length = 0;
+static uint8_t frame_delimiter = 0;
+static uint8_t reader_mode = SERIAL_FRAME_NONE; // framing in use by the reader, taken over at a restart
+static uint16_t reader_length = 0;
+static uint8_t reader_delimiter = 0;
+static uint32_t frame_marks[SERIAL_FRAME_MARKS]; // positions of the frame ends in timeout mode
+static volatile uint8_t marks_head = 0;
+static uint8_t marks_tail = 0;
+
+static volatile serial_stats_t stats;
+
+// set while RTS holds off the peer because received data is piling up
+static volatile bool throttled = false;
+
+/* Function Prototype */
+void __serial_rx_push(bool frame_end);
+size_t __serial_frame_find(void);
+void __serial_frame_restart(void);
+void __serial_update_rts(void);
+void __serial_wait_idle(void);
+uint32_t __serial_get_pending(uint32_t *capacity);
+void __serial_rx_dma_callback(DMA_HandleTypeDef *_hdma);
+void __serial_tx_dma_callback(DMA_HandleTypeDef *_hdma);
+uint32_t __serial_get_clock(void);
+
+/**
+ * @brief Initialize the serial bridge.
+ * @note The UART is driven at register level, its DMA streams through the HAL.
+ *       The DMA handles only need their Instance and Channel to be set.
+ */
+void serial_init(USART_TypeDef *_uart, DMA_HandleTypeDef *_hdma_rx, DMA_HandleTypeDef *_hdma_tx)
+{
+    // save the UART and DMA handles
+    uart = _uart;
+    hdma_rx = _hdma_rx;
+    hdma_tx = _hdma_tx;
+
+    rxStreamBuffer = xStreamBufferCreate(SERIAL_STREAM_BUFFER_SIZE, 1);
+    txDoneSemaphore = xSemaphoreCreateBinary();
+    txMutex = xSemaphoreCreateMutex();
+    configASSERT(rxStreamBuffer != NULL && txDoneSemaphore != NULL && txMutex != NULL);
+
+    // the cycle counter measures the time spent in the receive interrupts
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    if (uart == USART3)
+    {
+        __HAL_RCC_USART3_CLK_ENABLE();
+    }
+
+    // receive DMA, peripheral to memory, circular
+    hdma_rx->Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_rx->Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_rx->Init.MemInc = DMA_MINC_ENABLE;
+    hdma_rx->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_rx->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_rx->Init.Mode = DMA_CIRCULAR;
+    hdma_rx->Init.Priority = DMA_PRIORITY_HIGH;
+    hdma_rx->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(hdma_rx) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    hdma_rx->XferHalfCpltCallback = __serial_rx_dma_callback;
+    hdma_rx->XferCpltCallback = __serial_rx_dma_callback;
+
+    // transmit DMA, memory to peripheral, one block at a time
+    hdma_tx->Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_tx->Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_tx->Init.MemInc = DMA_MINC_ENABLE;
+    hdma_tx->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_tx->Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_tx->Init.Mode = DMA_NORMAL;
+    hdma_tx->Init.Priority = DMA_PRIORITY_MEDIUM;
+    hdma_tx->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(hdma_tx) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    hdma_tx->XferCpltCallback = __serial_tx_dma_callback;
+
+    if (serial_configure() != HAL_OK)
+    {
+        settings.serial_baud_rate = SERIAL_DEFAULT_BAUD_RATE;
+        settings.serial_data_bits = SERIAL_DEFAULT_DATA_BITS;
+        settings.serial_parity = SERIAL_DEFAULT_PARITY;
+        settings.serial_stop_bits = SERIAL_DEFAULT_STOP_BITS;
+        settings.serial_flow_control = SERIAL_DEFAULT_FLOW_CONTROL;
+        settings.serial_high_watermark = SERIAL_DEFAULT_HIGH_WATERMARK;
+        settings.serial_low_watermark = SERIAL_DEFAULT_LOW_WATERMARK;
+        settings.serial_frame_mode = SERIAL_DEFAULT_FRAME_MODE;
+        settings.serial_frame_delimiter = SERIAL_DEFAULT_FRAME_DELIMITER;
+        settings.serial_frame_length = SERIAL_DEFAULT_FRAME_LENGTH;
+        settings.serial_frame_timeout_us = SERIAL_DEFAULT_FRAME_TIMEOUT_US;
+        serial_configure();
+    }
+}
+
+/**
+ * @brief Apply the line parameters in settings while the serial port is in use.
+ * @note The UART is switched between characters, once the transmit DMA is done and
+ *       the receiver is not in the middle of a character. The receive DMA keeps
+ *       running through the change, so no byte received before or after it is
+ *       dropped. Only a change of the framing mode, length or delimiter starts the
+ *       framing over with the data received next.
+ *       With flow control, CTS is handled by the UART, so the DMA stalls while the
+ *       peer is not ready. RTS is driven by software instead, from the fill level of
+ *       the receive path up to the socket, see __serial_update_rts(). Without flow
+ *       control, RTS is kept low.
+ */
+HAL_StatusTypeDef serial_configure(void)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    HAL_StatusTypeDef status = HAL_OK;
+    bool running;
+    uint32_t cr1 = USART_CR1_TE | USART_CR1_RE | USART_CR1_IDLEIE;
+    uint32_t cr2 = 0;
+    uint32_t cr3 = USART_CR3_DMAR | USART_CR3_DMAT | USART_CR3_EIE;
+    uint8_t frame_bits = settings.serial_data_bits + (settings.serial_parity != SERIAL_PARITY_NONE);
+    // the receiver timeout counts in bit times from the end of the last stop bit
+    uint64_t timeout_bits = (uint64_t)settings.serial_frame_timeout_us * settings.serial_baud_rate / 1000000U;
+
+    if (settings.serial_baud_rate < SERIAL_MIN_BAUD_RATE || settings.serial_baud_rate > SERIAL_MAX_BAUD_RATE
+        || settings.serial_data_bits < 7 || settings.serial_data_bits > 8
+        || settings.serial_parity > SERIAL_PARITY_EVEN
+        || settings.serial_stop_bits < 1 || settings.serial_stop_bits > 2
+        || settings.serial_high_watermark > 100
+        || settings.serial_low_watermark >= settings.serial_high_watermark
+        || settings.serial_frame_mode > SERIAL_FRAME_TIMEOUT
+        || (settings.serial_frame_mode == SERIAL_FRAME_FIXED
+            && (settings.serial_frame_length < 1 || settings.serial_frame_length > SERIAL_FRAME_SIZE))
+        || (settings.serial_frame_mode == SERIAL_FRAME_PREFIXED
+            && (settings.serial_frame_length < 1 || settings.serial_frame_length > 2))
+        || (settings.serial_frame_mode == SERIAL_FRAME_TIMEOUT
+            && (timeout_bits < 1 || timeout_bits > USART_RTOR_RTO)))
+    {
+        return HAL_ERROR;
+    }
+
+    // the word length includes the parity bit
+    if (frame_bits == 7)
+    {
+        cr1 |= USART_CR1_M1;
+    }
+    else if (frame_bits == 9)
+    {
+        cr1 |= USART_CR1_M0;
+    }
+
+    if (settings.serial_parity != SERIAL_PARITY_NONE)
+    {
+        cr1 |= USART_CR1_PCE;
+        if (settings.serial_parity == SERIAL_PARITY_ODD)
+        {
+            cr1 |= USART_CR1_PS;
+        }
+    }
+
+    if (settings.serial_stop_bits == 2)
+    {
+        cr2 |= USART_CR2_STOP_1;
+    }
+
+    if (settings.serial_flow_control)
+    {
+        cr3 |= USART_CR3_CTSE;
+    }
+
+    if (settings.serial_frame_mode == SERIAL_FRAME_TIMEOUT)
+    {
+        cr1 |= USART_CR1_RTOIE;
+        cr2 |= USART_CR2_RTOEN;
+    }
+
+    // the UART is running unless this is the first configuration at start-up
+    running = READ_BIT(uart->CR1, USART_CR1_UE) != 0;
+    if (running)
+    {
+        // hold the writers off until the UART has been switched
+        if (xSemaphoreTake(txMutex, pdMS_TO_TICKS(SERIAL_TX_TIMEOUT_MS)) != pdTRUE)
+        {
+            return HAL_BUSY;
+        }
+    }
+
+    HAL_NVIC_DisableIRQ(USART3_IRQn);
+    if (running)
+    {
+        __serial_wait_idle();
+    }
+
+    // hand over what has been received so far, the idle line interrupt is cleared below
+    taskENTER_CRITICAL();
+    if (running)
+    {
+        __serial_rx_push(false);
+    }
+    CLEAR_BIT(uart->CR1, USART_CR1_UE);
+    taskEXIT_CRITICAL();
+
+    uart->CR2 = cr2;
+    uart->CR3 = cr3;
+    uart->BRR = (__serial_get_clock() + settings.serial_baud_rate / 2) / settings.serial_baud_rate;
+    uart->RTOR = (uint32_t)timeout_bits & USART_RTOR_RTO;
+    uart->ICR = USART_ICR_RTOCF | USART_ICR_IDLECF | USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF | USART_ICR_PECF;
+    uart->CR1 = cr1;
+
+    // the framing in use is only dropped if it has changed
+    if (settings.serial_frame_mode != frame_mode || settings.serial_frame_length != frame_length
+        || settings.serial_frame_delimiter != frame_delimiter)
+    {
+        taskENTER_CRITICAL();
+        frame_mode = settings.serial_frame_mode;
+        frame_length = settings.serial_frame_length;
+        frame_delimiter = settings.serial_frame_delimiter;
+        frame_reset = true;
+
+        // an open tunnel reads in place only without framing, it starts at the data received next
+        if (tunnelTaskHandle != NULL && tunnel_in_place != (frame_mode == SERIAL_FRAME_NONE))
+        {
+            tunnel_received = tunnel_consumed = 0;
+            tunnel_read = rx_tail;
+            tunnel_in_place = (frame_mode == SERIAL_FRAME_NONE);
+        }
+        taskEXIT_CRITICAL();
+    }
+
+    // the circular receive DMA is started once and left running
+    if (hdma_rx->State == HAL_DMA_STATE_READY)
+    {
+        rx_tail = 0;
+        if (HAL_DMA_Start_IT(hdma_rx, (uint32_t)&uart->RDR, (uint32_t)serial_rx_buffer, SERIAL_RX_BUFFER_SIZE) != HAL_OK)
+        {
+            status = HAL_ERROR;
+        }
+    }
+
+    SET_BIT(uart->CR1, USART_CR1_UE);
+
+    // RTS is always a GPIO, as hardware RTS is never enabled. With flow control it keeps
+    // holding off the peer if it did, without it stays low so the peer may always send
+    taskENTER_CRITICAL();
+    if (!settings.serial_flow_control)
+    {
+        throttled = false;
+    }
+    HAL_GPIO_WritePin(SERIAL_RTS_GPIO_Port, SERIAL_RTS_Pin, throttled ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    taskEXIT_CRITICAL();
+    GPIO_InitStruct.Pin = SERIAL_RTS_Pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+    HAL_GPIO_Init(SERIAL_RTS_GPIO_Port, &GPIO_InitStruct);
+
+    HAL_NVIC_SetPriority(USART3_IRQn, 6, 0);
+    HAL_NVIC_EnableIRQ(USART3_IRQn);
+
+    taskENTER_CRITICAL();
+    __serial_update_rts();
+    taskEXIT_CRITICAL();
+
+    if (running)
+    {
+        xSemaphoreGive(txMutex);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Set the task notified whenever received data is available.
+ * @note The task is notified rather than blocked on the stream buffer, so it
+ *       can be deleted at any time after being unset here.
+ */
+void serial_set_reader(TaskHandle_t task)
+{
+    taskENTER_CRITICAL();
+    readerTaskHandle = task;
+    taskEXIT_CRITICAL();
+}
+
+// Wake the reader up, e.g. to wait for a new deadline
+void serial_notify_reader(void)
+{
+    taskENTER_CRITICAL();
+    if (readerTaskHandle != NULL)
+    {
+        xTaskNotifyGive(readerTaskHandle);
+    }
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Route received data to a tunnel instead of the reader.
+ * @note The task is notified whenever data is available. Without framing it reads
+ *       the data in place from the DMA buffer with serial_tunnel_peek() and
+ *       serial_tunnel_consume(), otherwise frame by frame with serial_frame_peek()
+ *       and serial_frame_consume().
+ */
+void serial_open_tunnel(TaskHandle_t task)
+{
+    taskENTER_CRITICAL();
+    tunnel_received = 0;
+    tunnel_consumed = 0;
+    tunnel_read = rx_tail;
+    tunnel_in_place = (frame_mode == SERIAL_FRAME_NONE);
+    tunnelTaskHandle = task;
+    frame_reset = true;
+    taskEXIT_CRITICAL();
+}
+
+void serial_close_tunnel(void)
+{
+    taskENTER_CRITICAL();
+    tunnelTaskHandle = NULL;
+    tunnel_in_place = false;
+    frame_reset = true;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Get the contiguous block of received data not handed to the tunnel yet.
+ * @retval number of bytes at *data, 0 if there is none
+ */
+size_t serial_tunnel_peek(const uint8_t **data)
+{
+    uint32_t pending = tunnel_received - tunnel_consumed;
+
+    // the DMA has lapped the reader, what is left in the buffer is not in order anymore
+    if (pending > SERIAL_RX_BUFFER_SIZE)
+    {
+        taskENTER_CRITICAL();
+        stats.rx_dropped += tunnel_received - tunnel_consumed;
+        tunnel_consumed = tunnel_received;
+        tunnel_read = rx_tail;
+        taskEXIT_CRITICAL();
+        pending = 0;
+    }
+
+    if (pending > (uint32_t)(SERIAL_RX_BUFFER_SIZE - tunnel_read))
+    {
+        pending = SERIAL_RX_BUFFER_SIZE - tunnel_read;
+    }
+
+    *data = &serial_rx_buffer[tunnel_read];
+    return pending;
+}
+
+// Release len bytes returned by serial_tunnel_peek()
+void serial_tunnel_consume(size_t len)
+{
+    tunnel_consumed += len;
+    tunnel_read = (tunnel_read + len) % SERIAL_RX_BUFFER_SIZE;
+
+    taskENTER_CRITICAL();
+    __serial_update_rts();
+    taskEXIT_CRITICAL();
+}
+
+// Read up to len received bytes without blocking
+size_t serial_read(uint8_t *data, size_t len)
+{
+    len = xStreamBufferReceive(rxStreamBuffer, data, len, 0);
+
+    taskENTER_CRITICAL();
+    __serial_update_rts();
+    taskEXIT_CRITICAL();
+
+    return len;
+}
+
+/**
+ * @brief Tell whether the received data is read by frames.
+ * @note Follows serial_configure(), not the settings being written, so the reader
+ *       switches between serial_read() and serial_frame_peek() along with the framing.
+ */
+bool serial_is_framed(void)
+{
+    return frame_mode != SERIAL_FRAME_NONE && frame_mode != UINT8_MAX;
+}
+
+// Discard all received data not read yet
+void serial_flush(void)
+{
+    uint8_t discard[32];
+
+    while (xStreamBufferReceive(rxStreamBuffer, discard, sizeof(discard), 0) > 0)
+    {
+    }
+
+    frame_reset = true;
+}
+
+/**
+ * @brief Get the next complete frame of the received data.
+ * @note The frame stays valid until serial_frame_consume(), the caller may retry
+ *       later e.g. while the socket is congested. Without framing, all data
+ *       received so far is returned as one frame.
+ * @retval number of bytes at *frame, 0 if no frame is complete yet
+ */
+size_t serial_frame_peek(const uint8_t **frame)
+{
+    size_t len;
+
+    if (frame_reset)
+    {
+        __serial_frame_restart();
+    }
+
+    // move as much as there is room for, the frame end may come with the last bytes
+    len = xStreamBufferReceive(rxStreamBuffer, &frame_buffer[frame_fill], SERIAL_FRAME_SIZE - frame_fill, 0);
+    frame_fill += len;
+    frame_read += len;
+
+    if (len > 0)
+    {
+        taskENTER_CRITICAL();
+        __serial_update_rts();
+        taskEXIT_CRITICAL();
+    }
+
+    *frame = frame_buffer;
+    return __serial_frame_find();
+}
+
+// Release the frame returned by serial_frame_peek()
+void serial_frame_consume(size_t len)
+{
+    uint32_t start;
+
+    if (len == 0 || len > frame_fill)
+    {
+        return;
+    }
+
+    frame_fill -= len;
+    memmove(frame_buffer, &frame_buffer[len], frame_fill);
+    stats.frames++;
+
+    // drop the frame ends passed in timeout mode
+    start = frame_read - frame_fill;
+    while (marks_tail != marks_head && (int32_t)(frame_marks[marks_tail] - start) <= 0)
+    {
+        marks_tail = (marks_tail + 1) % SERIAL_FRAME_MARKS;
+    }
+}
+
+/**
+ * @brief Send a block through the UART by DMA.
+ * @note The DMA reads the data in place, so the call blocks until the whole block
+ *       has been handed to the UART. Writers are serialized by a mutex.
+ */
+HAL_StatusTypeDef serial_write(const uint8_t *data, uint16_t len)
+{
+    if (serial_write_some(data, len, pdMS_TO_TICKS(SERIAL_TX_TIMEOUT_MS)) != len)
+    {
+        return HAL_TIMEOUT;
+    }
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Send as much of a block as the UART accepts within timeout.
+ * @note With flow control the DMA stalls while CTS is high, the bytes not sent
+ *       when the timeout expires are left to the caller, so nothing is lost. The
+ *       block may be anywhere in memory, e.g. on the stack of the caller, so the
+ *       lines of the data cache holding it are written back before the DMA reads it.
+ * @retval number of bytes handed to the UART
+ */
+uint16_t serial_write_some(const uint8_t *data, uint16_t len, TickType_t timeout)
+{
+    uint32_t line = (uint32_t)data & ~(UTILS_CACHE_LINE_SIZE - 1);
+    uint16_t sent = len;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    if (xSemaphoreTake(txMutex, timeout) != pdTRUE)
+    {
+        return 0;
+    }
+
+    xSemaphoreTake(txDoneSemaphore, 0);
+    SCB_CleanDCache_by_Addr((uint32_t *)line, (uint32_t)data + len - line);
+    if (HAL_DMA_Start_IT(hdma_tx, (uint32_t)data, (uint32_t)&uart->TDR, len) != HAL_OK)
+    {
+        sent = 0;
+    }
+    else if (xSemaphoreTake(txDoneSemaphore, timeout) != pdTRUE)
+    {
+        // e.g. the peer holds CTS, the counter tells how far the DMA got
+        HAL_DMA_Abort(hdma_tx);
+        sent = len - __HAL_DMA_GET_COUNTER(hdma_tx);
+        stats.tx_stalls++;
+    }
+
+    stats.tx_bytes += sent;
+    xSemaphoreGive(txMutex);
+
+    return sent;
+}
+
+void serial_get_stats(serial_stats_t *_stats)
+{
+    taskENTER_CRITICAL();
+    *_stats = *(serial_stats_t *)&stats;
+    taskEXIT_CRITICAL();
+}
+
+// Called from USART3_IRQHandler
+void serial_irq_handler(void)
+{
+    uint32_t isr = uart->ISR;
+
+    if (isr & USART_ISR_ORE)
+    {
+        uart->ICR = USART_ICR_ORECF;
+        stats.overruns++;
+    }
+
+    // framing, noise and parity errors only affect the byte received
+    uart->ICR = USART_ICR_FECF | USART_ICR_NCF | USART_ICR_PECF;
+
+    // the line has been idle for the frame timeout, what has been received is a frame
+    if (isr & USART_ISR_RTOF)
+    {
+        uart->ICR = USART_ICR_RTOCF | USART_ICR_IDLECF;
+        __serial_rx_push(true);
+    }
+    // the line went idle after a burst, hand over whatever has been received
+    else if (isr & USART_ISR_IDLE)
+    {
+        uart->ICR = USART_ICR_IDLECF;
+        __serial_rx_push(false);
+    }
+}
+
+/**
+ * @brief Hand the bytes received since the last call to the stream buffer.
+ * @note Called from the idle line and receiver timeout interrupts of the UART, and
+ *       the half and full transfer interrupts of the DMA, whichever comes first.
+ *       frame_end marks the end of the received data as the end of a frame.
+ */
+void __serial_rx_push(bool frame_end)
+{
+    uint32_t start = DWT->CYCCNT;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    uint16_t head = SERIAL_RX_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(hdma_rx);
+    size_t len, sent = 0;
+
+    if (head == rx_tail)
+    {
+        return;
+    }
+
+    if (tunnel_in_place)
+    {
+        // the tunnel reads the data in place
+        len = (head - rx_tail + SERIAL_RX_BUFFER_SIZE) % SERIAL_RX_BUFFER_SIZE;
+        tunnel_received += len;
+        sent = len;
+    }
+    else if (head > rx_tail)
+    {
+        len = head - rx_tail;
+        sent = xStreamBufferSendFromISR(rxStreamBuffer, &serial_rx_buffer[rx_tail], len, NULL);
+    }
+    else
+    {
+        // the data wraps around the end of the circular buffer
+        len = SERIAL_RX_BUFFER_SIZE - rx_tail + head;
+        sent = xStreamBufferSendFromISR(rxStreamBuffer, &serial_rx_buffer[rx_tail], SERIAL_RX_BUFFER_SIZE - rx_tail, NULL);
+        sent += xStreamBufferSendFromISR(rxStreamBuffer, serial_rx_buffer, head, NULL);
+    }
+    rx_tail = (head == SERIAL_RX_BUFFER_SIZE) ? 0 : head;
+
+    if (!tunnel_in_place)
+    {
+        rx_pushed += sent;
+
+        // if the reader lags behind by more frames than it can keep, the frames merge
+        if (frame_end && (uint8_t)((marks_head + 1) % SERIAL_FRAME_MARKS) != marks_tail)
+        {
+            frame_marks[marks_head] = rx_pushed;
+            marks_head = (marks_head + 1) % SERIAL_FRAME_MARKS;
+        }
+    }
+
+    stats.rx_bytes += len;
+    stats.rx_dropped += len - sent;
+    stats.rx_events++;
+
+    if (tunnelTaskHandle != NULL)
+    {
+        vTaskNotifyGiveFromISR(tunnelTaskHandle, &xHigherPriorityTaskWoken);
+    }
+    else if (readerTaskHandle != NULL)
+    {
+        vTaskNotifyGiveFromISR(readerTaskHandle, &xHigherPriorityTaskWoken);
+    }
+
+    __serial_update_rts();
+
+    stats.isr_cycles += DWT->CYCCNT - start;
+
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+void __serial_rx_dma_callback(DMA_HandleTypeDef *_hdma)
+{
+    __serial_rx_push(false);
+}
+
+void __serial_tx_dma_callback(DMA_HandleTypeDef *_hdma)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    xSemaphoreGiveFromISR(txDoneSemaphore, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief Hold off or release the peer by RTS according to the fill level.
+ * @note RTS goes high once the received data not yet taken by the socket side
+ *       reaches the high watermark, and low again once it drains to the low
+ *       watermark. Called with the receive interrupts masked.
+ */
+void __serial_update_rts(void)
+{
+    uint32_t capacity;
+    uint32_t level;
+
+    if (!settings.serial_flow_control)
+    {
+        return;
+    }
+
+    level = __serial_get_pending(&capacity) * 100U / capacity;
+
+    if (!throttled && level >= settings.serial_high_watermark)
+    {
+        SERIAL_RTS_GPIO_Port->BSRR = SERIAL_RTS_Pin;
+        throttled = true;
+        stats.rts_throttles++;
+    }
+    else if (throttled && level <= settings.serial_low_watermark)
+    {
+        SERIAL_RTS_GPIO_Port->BSRR = (uint32_t)SERIAL_RTS_Pin << 16;
+        throttled = false;
+    }
+}
+
+/**
+ * @brief Wait for the UART to be between characters in both directions.
+ * @note A character on the line while the UART is switched would be garbled. The
+ *       flags are polled up to SERIAL_RECONFIGURE_TIMEOUT_MS, so neither a peer which
+ *       keeps sending without gaps nor one holding CTS can hold the change off longer.
+ */
+void __serial_wait_idle(void)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    while ((READ_BIT(uart->ISR, USART_ISR_BUSY) || !READ_BIT(uart->ISR, USART_ISR_TC))
+           && xTaskGetTickCount() - start < pdMS_TO_TICKS(SERIAL_RECONFIGURE_TIMEOUT_MS))
+    {
+    }
+}
+
+// Received bytes not taken by the socket side yet, and the room for them
+uint32_t __serial_get_pending(uint32_t *capacity)
+{
+    if (tunnel_in_place)
+    {
+        *capacity = SERIAL_RX_BUFFER_SIZE;
+        return tunnel_received - tunnel_consumed;
+    }
+
+    *capacity = SERIAL_STREAM_BUFFER_SIZE;
+    return xStreamBufferBytesAvailable(rxStreamBuffer);
+}
+
+/**
+ * @brief Find the end of the first frame in the frame buffer.
+ * @note A full buffer without a frame end is returned as it is, a length field
+ *       larger than the buffer discards the data, both count as frame errors.
+ * @retval length of the frame, 0 if it is not complete yet
+ */
+size_t __serial_frame_find(void)
+{
+    uint8_t *end;
+    uint32_t start, header, length;
+
+    if (frame_fill == 0)
+    {
+        return 0;
+    }
+
+    switch (reader_mode)
+    {
+    case SERIAL_FRAME_DELIMITER:
+        end = memchr(frame_buffer, reader_delimiter, frame_fill);
+        if (end != NULL)
+        {
+            return end - frame_buffer + 1;
+        }
+        break;
+
+    case SERIAL_FRAME_FIXED:
+        if (frame_fill >= reader_length)
+        {
+            return reader_length;
+        }
+        return 0;
+
+    case SERIAL_FRAME_PREFIXED:
+        header = reader_length;
+        if (frame_fill < header)
+        {
+            return 0;
+        }
+
+        length = (header == 2) ? ((uint32_t)frame_buffer[0] << 8 | frame_buffer[1]) : frame_buffer[0];
+        if (header + length > SERIAL_FRAME_SIZE)
+        {
+            // the length field is corrupted, start over with the next data
+            stats.frame_errors++;
+            frame_fill = 0;
+            return 0;
+        }
+
+        if (frame_fill >= header + length)
+        {
+            return header + length;
+        }
+        return 0;
+
+    case SERIAL_FRAME_TIMEOUT:
+        // skip the ends of frames whose data has been dropped
+        start = frame_read - frame_fill;
+        while (marks_tail != marks_head && (int32_t)(frame_marks[marks_tail] - start) <= 0)
+        {
+            marks_tail = (marks_tail + 1) % SERIAL_FRAME_MARKS;
+        }
+
+        if (marks_tail != marks_head && frame_marks[marks_tail] - start <= frame_fill)
+        {
+            return frame_marks[marks_tail] - start;
+        }
+        break;
+
+    default:
+        return frame_fill;
+    }
+
+    if (frame_fill == SERIAL_FRAME_SIZE)
+    {
+        stats.frame_errors++;
+        return frame_fill;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Drop the partial frame after the framing has changed or the data has been flushed.
+ * @note The framing of serial_configure() is only taken over here, so every frame is
+ *       found with one set of rules, never with a change written in the middle of it.
+ */
+void __serial_frame_restart(void)
+{
+    taskENTER_CRITICAL();
+    frame_reset = false;
+    reader_mode = frame_mode;
+    reader_length = frame_length;
+    reader_delimiter = frame_delimiter;
+    xStreamBufferReset(rxStreamBuffer);
+    frame_fill = 0;
+    frame_read = rx_pushed;
+    marks_tail = marks_head;
+    taskEXIT_CRITICAL();
+}
+
+// Kernel clock of the UART, USART1 and USART6 are on APB2, the others on APB1
+uint32_t __serial_get_clock(void)
+{
+    if ((uint32_t)uart >= APB2PERIPH_BASE)
+    {
+        return HAL_RCC_GetPCLK2Freq();
+    }
+
+    return HAL_RCC_GetPCLK1Freq();
+}
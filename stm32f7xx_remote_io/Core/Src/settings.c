@@ -1,7 +1,35 @@
 #include "stm32f7xx_remote_io.h"
 
+_Static_assert(sizeof(settings_record_t) <= SETTINGS_SLOT_SIZE, "a record does not fit its slot");
+
 settings_t settings;
 
+static const uint32_t bank_sectors[2] = {SETTINGS_BANK_1_SECTOR, SETTINGS_BANK_2_SECTOR};
+static const uint32_t bank_addresses[2] = {SETTINGS_BANK_1_ADDRESS, SETTINGS_BANK_2_ADDRESS};
+
+// the two sectors of the log, in the bank the code does not run from
+static uint32_t sector_numbers[2];
+static uint32_t sector_addresses[2];
+
+// false in single bank mode, the settings are not saved then
+static bool storeEnabled = false;
+
+// sector holding the latest record, and its next slot to be written
+static uint8_t activeSector = 0;
+static uint16_t nextSlot = 0;
+static uint32_t sequence = 0;
+
+// set while the other sector is to be erased
+static bool erasePending = false;
+
+// set while the settings loaded from the running bank are to be moved to the log
+static bool movePending = false;
+
+// the settings to be saved, copied by settings_save(), and the record being written
+static settings_t pending;
+static settings_record_t record;
+static TaskHandle_t settingsTaskHandle = NULL;
+
 const settings_t defaults = {
     .ip_address_0 = 172,
     .ip_address_1 = 16,
@@ -22,17 +50,376 @@ const settings_t defaults = {
     .mac_address_4 = 0x02,
     .mac_address_5 = 0x03,
     .tcp_port = 0, // this value will be added to 8500 as the final tcp port, i.e. 8500 + tcp_port
+    .serial_baud_rate = SERIAL_DEFAULT_BAUD_RATE,
+    .serial_data_bits = SERIAL_DEFAULT_DATA_BITS,
+    .serial_parity = SERIAL_DEFAULT_PARITY,
+    .serial_stop_bits = SERIAL_DEFAULT_STOP_BITS,
+    .serial_flow_control = SERIAL_DEFAULT_FLOW_CONTROL,
+    .serial_high_watermark = SERIAL_DEFAULT_HIGH_WATERMARK,
+    .serial_low_watermark = SERIAL_DEFAULT_LOW_WATERMARK,
+    .serial_frame_mode = SERIAL_DEFAULT_FRAME_MODE,
+    .serial_frame_delimiter = SERIAL_DEFAULT_FRAME_DELIMITER,
+    .serial_frame_length = SERIAL_DEFAULT_FRAME_LENGTH,
+    .serial_frame_timeout_us = SERIAL_DEFAULT_FRAME_TIMEOUT_US,
+    .serial_transaction_timeout_ms = TRANSACTION_DEFAULT_TIMEOUT_MS,
+    .modbus_baud_rate = MODBUS_DEFAULT_BAUD_RATE,
+    .modbus_parity = MODBUS_DEFAULT_PARITY,
+    .modbus_timeout_ms = MODBUS_DEFAULT_TIMEOUT_MS,
+    .debounce_period_us = DEBOUNCE_DEFAULT_PERIOD_US,
+    .debounce_time_ms = {[0 ... NUMBER_OF_INPUTS - 1] = DEBOUNCE_DEFAULT_TIME_MS},
+    .analog_gain = {[0 ... NUMBER_OF_ANALOG_INPUTS - 1] = ANALOG_UNITY_GAIN},
+    .analog_offset_uv = {[0 ... NUMBER_OF_ANALOG_INPUTS - 1] = 0},
+    .analog_slew_rate = {[0 ... NUMBER_OF_ANALOG_OUTPUTS - 1] = 0},
+    .ws28xx_led_count = NUMBER_OF_LEDS,
 };
 
+/* Function Prototype */
+bool __settings_load(void);
+uint16_t __settings_scan(uint32_t address, const settings_record_t **latest);
+bool __settings_is_free(const settings_record_t *slot);
+uint32_t __settings_crc(const settings_record_t *slot);
+HAL_StatusTypeDef __settings_append(void);
+HAL_StatusTypeDef __settings_program(uint32_t address);
+HAL_StatusTypeDef __settings_erase(uint8_t sector);
+void __settings_move(void);
+static void prvSettingsTask(void *pvParameters);
+
 void settings_restore(uint8_t restore_flag)
 {
     if (restore_flag & SETTINGS_RESTORE_DEFAULTS)
     {
         settings = defaults;
     }
+
+    if (restore_flag & SETTINGS_RESTORE_NETWORK)
+    {
+        settings.ip_address_0 = defaults.ip_address_0;
+        settings.ip_address_1 = defaults.ip_address_1;
+        settings.ip_address_2 = defaults.ip_address_2;
+        settings.ip_address_3 = defaults.ip_address_3;
+        settings.netmask_0 = defaults.netmask_0;
+        settings.netmask_1 = defaults.netmask_1;
+        settings.netmask_2 = defaults.netmask_2;
+        settings.netmask_3 = defaults.netmask_3;
+        settings.gateway_0 = defaults.gateway_0;
+        settings.gateway_1 = defaults.gateway_1;
+        settings.gateway_2 = defaults.gateway_2;
+        settings.gateway_3 = defaults.gateway_3;
+        settings.tcp_port = defaults.tcp_port;
+    }
 }
 
+/**
+ * @brief Load the latest settings saved in flash, or the defaults.
+ * @note Called before the scheduler starts. Both sectors are scanned once, the
+ *       erase of a sector left over is started by the settings task.
+ */
 void settings_init()
 {
-    settings_restore(SETTINGS_RESTORE_DEFAULTS);
+    __HAL_RCC_CRC_CLK_ENABLE();
+
+    // one bank is only erased while the other keeps running in dual bank mode
+    storeEnabled = (READ_BIT(FLASH->OPTCR, FLASH_OPTCR_nDBANK) == 0);
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        sector_numbers[i] = bank_sectors[ota_get_bank() ^ 1] + i;
+        sector_addresses[i] = bank_addresses[ota_get_bank() ^ 1] + i * SETTINGS_SECTOR_SIZE;
+    }
+
+    if (!storeEnabled || !__settings_load())
+    {
+        settings_restore(SETTINGS_RESTORE_DEFAULTS);
+    }
+
+    if (storeEnabled)
+    {
+        xTaskCreate(prvSettingsTask, "Settings", configMINIMAL_STACK_SIZE * 2, NULL, tskIDLE_PRIORITY, &settingsTaskHandle);
+    }
+}
+
+/**
+ * @brief Save the settings to flash.
+ * @note Only takes a copy of the settings, the record is written by the settings
+ *       task, so the caller never waits for the flash.
+ */
+void settings_save(void)
+{
+    if (settingsTaskHandle == NULL)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    pending = settings;
+    taskEXIT_CRITICAL();
+
+    xTaskNotifyGive(settingsTaskHandle);
+}
+
+/**
+ * @brief Find the latest valid record and the slot to be written next.
+ * @retval false if there is no valid record of this version
+ */
+bool __settings_load(void)
+{
+    const settings_record_t *latest[2], *moved[2];
+    uint16_t used[2];
+
+    used[0] = __settings_scan(sector_addresses[0], &latest[0]);
+    used[1] = __settings_scan(sector_addresses[1], &latest[1]);
+
+    // the sector with the later record is the active one, the other one is to be erased
+    activeSector = (latest[1] != NULL && (latest[0] == NULL || latest[1]->sequence > latest[0]->sequence)) ? 1 : 0;
+    nextSlot = used[activeSector];
+    erasePending = (used[activeSector ^ 1] != 0);
+
+    const settings_record_t *r = latest[activeSector];
+
+    // the image which ran before an update kept its settings in the running bank
+    __settings_scan(bank_addresses[ota_get_bank()], &moved[0]);
+    __settings_scan(bank_addresses[ota_get_bank()] + SETTINGS_SECTOR_SIZE, &moved[1]);
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        if (moved[i] != NULL && (r == NULL || moved[i]->sequence > r->sequence))
+        {
+            r = moved[i];
+            movePending = true;
+        }
+    }
+
+    if (r == NULL)
+    {
+        return false;
+    }
+
+    // the fields missing from a shorter record keep their defaults
+    settings = defaults;
+    memcpy(&settings, &r->settings, r->length);
+    sequence = r->sequence;
+
+    return true;
+}
+
+/**
+ * @brief Scan the slots of a sector up to the first free one.
+ * @retval number of slots in use, including those left incomplete by a reset
+ */
+uint16_t __settings_scan(uint32_t address, const settings_record_t **latest)
+{
+    uint16_t slot;
+
+    *latest = NULL;
+
+    for (slot = 0; slot < SETTINGS_SLOTS; slot++)
+    {
+        const settings_record_t *r = (const settings_record_t *)(address + slot * SETTINGS_SLOT_SIZE);
+
+        if (__settings_is_free(r))
+        {
+            break;
+        }
+
+        if (r->magic == SETTINGS_MAGIC && r->version == SETTINGS_VERSION && r->length <= sizeof(settings_t)
+            && r->crc == __settings_crc(r) && (*latest == NULL || r->sequence > (*latest)->sequence))
+        {
+            *latest = r;
+        }
+    }
+
+    return slot;
+}
+
+// A slot is free if neither the magic nor the CRC is programmed, these are the last and the first words written
+bool __settings_is_free(const settings_record_t *slot)
+{
+    return slot->magic == 0xFFFFFFFF && slot->crc == 0xFFFFFFFF;
+}
+
+// CRC-32 of a record by the CRC unit, which is only used by the settings task once the scheduler runs
+uint32_t __settings_crc(const settings_record_t *slot)
+{
+    const uint32_t *data = &slot->sequence;
+    uint32_t words = (offsetof(settings_record_t, settings) - offsetof(settings_record_t, sequence) + slot->length + 3) / 4;
+
+    CRC->CR = CRC_CR_RESET;
+    for (uint32_t i = 0; i < words; i++)
+    {
+        CRC->DR = data[i];
+    }
+
+    return CRC->DR;
+}
+
+/**
+ * @brief Append the record to the log, starting the other sector once the active one is full.
+ * @note A slot which is not blank, e.g. one left over from a reset, or fails to
+ *       program is skipped.
+ */
+HAL_StatusTypeDef __settings_append(void)
+{
+    taskENTER_CRITICAL();
+    record.settings = pending;
+    taskEXIT_CRITICAL();
+
+    record.sequence = sequence + 1;
+    record.version = SETTINGS_VERSION;
+    record.length = sizeof(settings_t);
+    record.crc = __settings_crc(&record);
+    record.magic = SETTINGS_MAGIC;
+
+    // every slot of both sectors is tried once, the flash is worn out past that
+    for (uint32_t attempt = 0; attempt < 2 * SETTINGS_SLOTS; attempt++)
+    {
+        if (nextSlot >= SETTINGS_SLOTS)
+        {
+            // compaction, the record holds all settings, so the full sector is simply dropped
+            if (erasePending && __settings_erase(activeSector ^ 1) != HAL_OK)
+            {
+                return HAL_ERROR;
+            }
+            activeSector ^= 1;
+            nextSlot = 0;
+            erasePending = true;
+        }
+
+        uint32_t address = sector_addresses[activeSector] + nextSlot * SETTINGS_SLOT_SIZE;
+        nextSlot++;
+
+        if (__settings_program(address) == HAL_OK)
+        {
+            sequence = record.sequence;
+            return HAL_OK;
+        }
+    }
+
+    return HAL_ERROR;
+}
+
+// Program the record into a blank slot, the magic last, and verify it
+HAL_StatusTypeDef __settings_program(uint32_t address)
+{
+    const uint32_t *data = (const uint32_t *)&record;
+    const uint32_t *slot = (const uint32_t *)address;
+    uint32_t words = (offsetof(settings_record_t, settings) + record.length + 3) / 4;
+    HAL_StatusTypeDef status = HAL_OK;
+
+    for (uint32_t i = 0; i < SETTINGS_SLOT_SIZE / 4; i++)
+    {
+        if (slot[i] != 0xFFFFFFFF)
+        {
+            return HAL_ERROR;
+        }
+    }
+
+    HAL_FLASH_Unlock();
+    for (uint32_t i = 1; i <= words && status == HAL_OK; i++)
+    {
+        // the magic, word 0, is programmed at the end
+        uint32_t index = (i < words) ? i : 0;
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address + index * 4, data[index]);
+    }
+    HAL_FLASH_Lock();
+
+    if (status != HAL_OK || memcmp(slot, data, words * 4) != 0)
+    {
+        return HAL_ERROR;
+    }
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Erase a sector without stalling the other tasks.
+ * @note The erase of a sector takes about a second, the code in the running bank
+ *       keeps running meanwhile and the settings task sleeps until it is done.
+ */
+HAL_StatusTypeDef __settings_erase(uint8_t sector)
+{
+    HAL_StatusTypeDef status = HAL_OK;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_ALL_ERRORS);
+
+    FLASH_Erase_Sector(sector_numbers[sector], FLASH_VOLTAGE_RANGE_3);
+    while (__HAL_FLASH_GET_FLAG(FLASH_FLAG_BSY))
+    {
+        vTaskDelay(pdMS_TO_TICKS(SETTINGS_ERASE_POLL_MS));
+    }
+
+    if (__HAL_FLASH_GET_FLAG(FLASH_FLAG_ALL_ERRORS))
+    {
+        __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+        status = HAL_ERROR;
+    }
+
+    CLEAR_BIT(FLASH->CR, FLASH_CR_SER | FLASH_CR_SNB);
+    HAL_FLASH_Lock();
+
+    if (status == HAL_OK)
+    {
+        erasePending = false;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Move the settings loaded from the running bank to the log.
+ * @note The log may hold older records from before the last update, both sectors
+ *       are erased and the settings start over as the first record.
+ */
+void __settings_move(void)
+{
+    if (__settings_erase(0) != HAL_OK || __settings_erase(1) != HAL_OK)
+    {
+        return;
+    }
+
+    activeSector = 0;
+    nextSlot = 0;
+
+    taskENTER_CRITICAL();
+    pending = settings;
+    taskEXIT_CRITICAL();
+
+    if (__settings_append() == HAL_OK)
+    {
+        movePending = false;
+    }
+}
+
+/**
+ * @brief Write the records, and erase the sector left behind.
+ * @note Runs at the lowest priority. A burst of changes, e.g. a client setting up
+ *       the serial port, is saved as one record.
+ */
+static void prvSettingsTask(void *pvParameters)
+{
+    for (;;)
+    {
+        // the flash is shared with the update
+        ota_lock_flash();
+        if (movePending)
+        {
+            __settings_move();
+        }
+        else if (erasePending)
+        {
+            __settings_erase(activeSector ^ 1);
+        }
+        ota_unlock_flash();
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(SETTINGS_SAVE_DELAY_MS));
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        ota_lock_flash();
+        if (__settings_append() != HAL_OK)
+        {
+            // kept in RAM, the next setting written tries again
+            FreeRTOS_debug_printf(("Failed to save the settings\n"));
+        }
+        ota_unlock_flash();
+    }
 }
\ No newline at end of file
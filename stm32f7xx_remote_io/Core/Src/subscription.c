@@ -0,0 +1,342 @@
+#include "stm32f7xx_remote_io.h"
+
+// lookup from input number to its port and pin
+static const cpu_map_pin_t input_pins[NUMBER_OF_INPUTS] = INPUT_PIN_TABLE;
+
+// digital inputs first, then analog inputs
+static subscription_t subscriptions[SUBSCRIPTION_SLOTS];
+
+// bitmap of the subscribed digital inputs, read by the debounce interrupt
+static volatile uint32_t active_inputs = 0;
+
+static SemaphoreHandle_t subscriptionMutex;
+static TaskHandle_t readerTaskHandle = NULL;
+
+/* Function Prototype */
+bool __subscription_slot(uint32_t pin, uint8_t *slot);
+int32_t __subscription_read(uint8_t slot);
+bool __subscription_is_due(subscription_t *s, int32_t value, TickType_t now, TickType_t *wait);
+void __subscription_notify(void);
+
+void subscription_init(void)
+{
+    subscriptionMutex = xSemaphoreCreateMutex();
+    configASSERT(subscriptionMutex != NULL);
+}
+
+/**
+ * @brief Subscribe an input, or change the parameters of its subscription.
+ * @note The input is reported right away, which is the reference of its deadband.
+ */
+HAL_StatusTypeDef subscription_set(uint32_t pin, subscription_config_t *config)
+{
+    uint8_t slot;
+
+    if (!__subscription_slot(pin, &slot)
+        || config->min_interval_ms > SUBSCRIPTION_MAX_INTERVAL_MS || config->max_interval_ms > SUBSCRIPTION_MAX_INTERVAL_MS
+        || (config->percent && config->deadband > SUBSCRIPTION_MAX_PERCENT)
+        || (!config->percent && config->deadband > ANALOG_REFERENCE_UV))
+    {
+        return HAL_ERROR;
+    }
+
+    subscription_t *s = &subscriptions[slot];
+
+    xSemaphoreTake(subscriptionMutex, portMAX_DELAY);
+    s->config = *config;
+    s->deadband_uv = config->percent
+                         ? (uint32_t)((uint64_t)config->deadband * ANALOG_REFERENCE_UV / SUBSCRIPTION_MAX_PERCENT)
+                         : config->deadband;
+    s->due = true;
+    s->changed = false;
+    s->active = true;
+    if (slot < NUMBER_OF_INPUTS)
+    {
+        taskENTER_CRITICAL();
+        active_inputs |= 1UL << slot;
+        taskEXIT_CRITICAL();
+    }
+    xSemaphoreGive(subscriptionMutex);
+
+    __subscription_notify();
+    return HAL_OK;
+}
+
+bool subscription_get(uint32_t pin, subscription_config_t *config)
+{
+    uint8_t slot;
+    bool active = false;
+
+    if (!__subscription_slot(pin, &slot))
+    {
+        return false;
+    }
+
+    xSemaphoreTake(subscriptionMutex, portMAX_DELAY);
+    if (subscriptions[slot].active)
+    {
+        *config = subscriptions[slot].config;
+        active = true;
+    }
+    xSemaphoreGive(subscriptionMutex);
+
+    return active;
+}
+
+// List the pin IDs of the subscribed inputs, pins has room for SUBSCRIPTION_SLOTS
+uint32_t subscription_list(uint32_t *pins)
+{
+    uint32_t count = 0;
+
+    xSemaphoreTake(subscriptionMutex, portMAX_DELAY);
+    for (uint8_t slot = 0; slot < SUBSCRIPTION_SLOTS; slot++)
+    {
+        if (subscriptions[slot].active)
+        {
+            pins[count++] = (slot < NUMBER_OF_INPUTS) ? slot : slot - NUMBER_OF_INPUTS + ANALOG_INPUT_ID_OFFSET;
+        }
+    }
+    xSemaphoreGive(subscriptionMutex);
+
+    return count;
+}
+
+// Drop all subscriptions, e.g. those of the previous client
+void subscription_clear(void)
+{
+    xSemaphoreTake(subscriptionMutex, portMAX_DELAY);
+    taskENTER_CRITICAL();
+    active_inputs = 0;
+    taskEXIT_CRITICAL();
+    for (uint8_t slot = 0; slot < SUBSCRIPTION_SLOTS; slot++)
+    {
+        subscriptions[slot].active = false;
+    }
+    xSemaphoreGive(subscriptionMutex);
+}
+
+// Set the task to be notified when an input is to be reported, NULL to stop notifying
+void subscription_set_reader(TaskHandle_t task)
+{
+    taskENTER_CRITICAL();
+    readerTaskHandle = task;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Take the next input to be reported.
+ * @note The value becomes the reference of the deadband and the time of the report
+ *       the start of both intervals.
+ * @retval false if no input is to be reported now
+ */
+bool subscription_take(uint32_t *pin, int32_t *value)
+{
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wait = portMAX_DELAY;
+    bool found = false;
+
+    xSemaphoreTake(subscriptionMutex, portMAX_DELAY);
+
+    // collect the toggles since the last call, even a pulse shorter than the minimum interval
+    for (uint8_t port = 0; port < NUMBER_OF_INPUT_PORTS; port++)
+    {
+        uint16_t changes = debounce_take_changes(port);
+
+        for (uint8_t i = 0; changes != 0 && i < NUMBER_OF_INPUTS; i++)
+        {
+            if (input_pins[i].port == port && (changes & input_pins[i].mask))
+            {
+                subscriptions[i].changed = true;
+            }
+        }
+    }
+
+    for (uint8_t slot = 0; slot < SUBSCRIPTION_SLOTS && !found; slot++)
+    {
+        subscription_t *s = &subscriptions[slot];
+
+        if (!s->active)
+        {
+            continue;
+        }
+
+        int32_t v = __subscription_read(slot);
+        if (__subscription_is_due(s, v, now, &wait))
+        {
+            s->due = false;
+            s->changed = false;
+            s->reported = v;
+            s->reported_tick = now;
+
+            *pin = (slot < NUMBER_OF_INPUTS) ? slot : slot - NUMBER_OF_INPUTS + ANALOG_INPUT_ID_OFFSET;
+            *value = v;
+            found = true;
+        }
+    }
+
+    xSemaphoreGive(subscriptionMutex);
+
+    return found;
+}
+
+// Time until an input is to be reported, without a new change
+TickType_t subscription_get_wait(void)
+{
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wait = portMAX_DELAY;
+
+    xSemaphoreTake(subscriptionMutex, portMAX_DELAY);
+    for (uint8_t slot = 0; slot < SUBSCRIPTION_SLOTS; slot++)
+    {
+        subscription_t *s = &subscriptions[slot];
+
+        if (s->active && __subscription_is_due(s, __subscription_read(slot), now, &wait))
+        {
+            wait = 0;
+            break;
+        }
+    }
+    xSemaphoreGive(subscriptionMutex);
+
+    return wait;
+}
+
+// Wake the reporting task up, called from the interrupt of the debounce filter once an input toggles
+void subscription_input_changed_from_isr(void)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    if (active_inputs != 0 && readerTaskHandle != NULL)
+    {
+        vTaskNotifyGiveFromISR(readerTaskHandle, &xHigherPriorityTaskWoken);
+    }
+
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief Check the deadband of the analog inputs, called from the DMA interrupt
+ *        whenever their values are updated.
+ * @note The reporting task is only woken once a value is outside its deadband and
+ *       the minimum interval has passed, not at every block.
+ */
+void subscription_analog_updated_from_isr(void)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    if (readerTaskHandle == NULL)
+    {
+        return;
+    }
+
+    TickType_t now = xTaskGetTickCountFromISR();
+
+    for (uint8_t i = 0; i < NUMBER_OF_ANALOG_INPUTS; i++)
+    {
+        subscription_t *s = &subscriptions[NUMBER_OF_INPUTS + i];
+        int32_t delta = analog_read(i) - s->reported;
+
+        if (s->active && (uint32_t)((delta < 0) ? -delta : delta) > s->deadband_uv
+            && (TickType_t)(now - s->reported_tick) >= pdMS_TO_TICKS(s->config.min_interval_ms))
+        {
+            vTaskNotifyGiveFromISR(readerTaskHandle, &xHigherPriorityTaskWoken);
+            break;
+        }
+    }
+
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+// Slot of a pin ID, digital inputs first, then analog inputs
+bool __subscription_slot(uint32_t pin, uint8_t *slot)
+{
+    if (pin < NUMBER_OF_INPUTS)
+    {
+        *slot = pin;
+        return true;
+    }
+
+    if (pin >= ANALOG_INPUT_ID_OFFSET && pin < ANALOG_INPUT_ID_OFFSET + NUMBER_OF_ANALOG_INPUTS)
+    {
+        *slot = NUMBER_OF_INPUTS + pin - ANALOG_INPUT_ID_OFFSET;
+        return true;
+    }
+
+    return false;
+}
+
+// Debounced state of a digital input, or filtered value of an analog input in microvolts
+int32_t __subscription_read(uint8_t slot)
+{
+    if (slot < NUMBER_OF_INPUTS)
+    {
+        return debounce_read_input(slot);
+    }
+
+    return analog_read(slot - NUMBER_OF_INPUTS);
+}
+
+/**
+ * @brief Check if an input is to be reported now.
+ * @note Otherwise wait is lowered to the time left until it is, if it ever is
+ *       without a new change.
+ */
+bool __subscription_is_due(subscription_t *s, int32_t value, TickType_t now, TickType_t *wait)
+{
+    TickType_t elapsed = now - s->reported_tick;
+    TickType_t min_interval = pdMS_TO_TICKS(s->config.min_interval_ms);
+    TickType_t max_interval = pdMS_TO_TICKS(s->config.max_interval_ms);
+    bool changed;
+
+    if (s->due)
+    {
+        return true;
+    }
+
+    if (s < &subscriptions[NUMBER_OF_INPUTS])
+    {
+        changed = s->changed;
+    }
+    else
+    {
+        int32_t delta = value - s->reported;
+        changed = (uint32_t)((delta < 0) ? -delta : delta) > s->deadband_uv;
+    }
+
+    if (changed)
+    {
+        if (elapsed >= min_interval)
+        {
+            return true;
+        }
+        if (min_interval - elapsed < *wait)
+        {
+            *wait = min_interval - elapsed;
+        }
+    }
+
+    if (max_interval != 0)
+    {
+        if (elapsed >= max_interval)
+        {
+            return true;
+        }
+        if (max_interval - elapsed < *wait)
+        {
+            *wait = max_interval - elapsed;
+        }
+    }
+
+    return false;
+}
+
+// Wake the reporting task up, e.g. to report a new subscription
+void __subscription_notify(void)
+{
+    taskENTER_CRITICAL();
+    if (readerTaskHandle != NULL)
+    {
+        xTaskNotifyGive(readerTaskHandle);
+    }
+    taskEXIT_CRITICAL();
+}
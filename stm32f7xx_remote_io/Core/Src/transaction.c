@@ -0,0 +1,175 @@
+#include "stm32f7xx_remote_io.h"
+#include "queue.h"
+
+static QueueHandle_t requestQueue;
+static TaskHandle_t transactionTaskHandle = NULL;
+
+// the transactions in flight, oldest first
+static struct
+{
+    uint32_t tag;
+    TickType_t deadline;
+} pending[TRANSACTION_IN_FLIGHT];
+static uint8_t pending_head = 0;
+static uint8_t pending_count = 0;
+
+/* Function Prototype */
+bool __transaction_add(uint32_t tag);
+bool __transaction_remove(uint32_t *tag, bool expired_only);
+static void prvTransactionTask(void *pvParameters);
+
+void transaction_init(void)
+{
+    requestQueue = xQueueCreate(TRANSACTION_QUEUE_SIZE, sizeof(transaction_request_t));
+    configASSERT(requestQueue != NULL);
+
+    xTaskCreate(prvTransactionTask, "Transaction", configMINIMAL_STACK_SIZE * 2, NULL, tskIDLE_PRIORITY + 1, &transactionTaskHandle);
+}
+
+/**
+ * @brief Queue a message to be sent through the serial port.
+ * @note A tagged request expects a response, which is reported with its tag once
+ *       received, or as timed out after settings.serial_transaction_timeout_ms.
+ * @retval HAL_BUSY if the queue is full
+ */
+HAL_StatusTypeDef transaction_submit(bool tagged, uint32_t tag, const char *message)
+{
+    static transaction_request_t request;
+    size_t len = strlen(message);
+
+    if (len >= sizeof(request.message))
+    {
+        return HAL_ERROR;
+    }
+
+    // only the API task submits, so the static request is not shared
+    request.tag = tag;
+    request.tagged = tagged;
+    request.length = len;
+    memcpy(request.message, message, len);
+
+    if (xQueueSend(requestQueue, &request, 0) != pdTRUE)
+    {
+        return HAL_BUSY;
+    }
+
+    return HAL_OK;
+}
+
+// Drop the requests and transactions of the previous client
+void transaction_reset(void)
+{
+    xQueueReset(requestQueue);
+
+    taskENTER_CRITICAL();
+    pending_count = 0;
+    taskEXIT_CRITICAL();
+
+    xTaskNotifyGive(transactionTaskHandle);
+}
+
+/**
+ * @brief Complete the oldest transaction in flight with a received frame.
+ * @retval false if no transaction is waiting, the frame is not a response then
+ */
+bool transaction_match(uint32_t *tag)
+{
+    return __transaction_remove(tag, false);
+}
+
+// Remove the oldest transaction in flight if its response is overdue
+bool transaction_expire(uint32_t *tag)
+{
+    return __transaction_remove(tag, true);
+}
+
+// Ticks until the oldest transaction in flight times out
+TickType_t transaction_get_wait(void)
+{
+    TickType_t wait = portMAX_DELAY;
+
+    taskENTER_CRITICAL();
+    if (pending_count > 0)
+    {
+        int32_t left = (int32_t)(pending[pending_head].deadline - xTaskGetTickCount());
+        wait = (left > 0) ? (TickType_t)left : 0;
+    }
+    taskEXIT_CRITICAL();
+
+    return wait;
+}
+
+/**
+ * @brief Send the queued requests one after another.
+ * @note A tagged request takes a slot of the transactions in flight before it is
+ *       sent, so its response can be matched even if it arrives during the write.
+ */
+static void prvTransactionTask(void *pvParameters)
+{
+    static transaction_request_t request;
+
+    for (;;)
+    {
+        xQueueReceive(requestQueue, &request, portMAX_DELAY);
+
+        if (request.tagged)
+        {
+            // wait for a response or a timeout to free a slot
+            while (!__transaction_add(request.tag))
+            {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            }
+
+            // the reader waits for the new deadline
+            serial_notify_reader();
+        }
+
+        // a failed write is counted in the serial statistics, its response times out
+        if (serial_write((uint8_t *)request.message, request.length) == HAL_OK)
+        {
+            serial_write((uint8_t *)SERIAL_LINE_TERMINATOR, sizeof(SERIAL_LINE_TERMINATOR) - 1);
+        }
+    }
+}
+
+bool __transaction_add(uint32_t tag)
+{
+    bool added = false;
+
+    taskENTER_CRITICAL();
+    if (pending_count < TRANSACTION_IN_FLIGHT)
+    {
+        uint8_t index = (pending_head + pending_count) % TRANSACTION_IN_FLIGHT;
+        pending[index].tag = tag;
+        pending[index].deadline = xTaskGetTickCount() + pdMS_TO_TICKS(settings.serial_transaction_timeout_ms);
+        pending_count++;
+        added = true;
+    }
+    taskEXIT_CRITICAL();
+
+    return added;
+}
+
+bool __transaction_remove(uint32_t *tag, bool expired_only)
+{
+    bool removed = false;
+
+    taskENTER_CRITICAL();
+    if (pending_count > 0
+        && (!expired_only || (int32_t)(pending[pending_head].deadline - xTaskGetTickCount()) <= 0))
+    {
+        *tag = pending[pending_head].tag;
+        pending_head = (pending_head + 1) % TRANSACTION_IN_FLIGHT;
+        pending_count--;
+        removed = true;
+    }
+    taskEXIT_CRITICAL();
+
+    // a slot is free for the next request
+    if (removed)
+    {
+        xTaskNotifyGive(transactionTaskHandle);
+    }
+
+    return removed;
+}
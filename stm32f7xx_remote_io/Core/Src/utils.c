@@ -1,7 +1,39 @@
+#ifdef UTILS_HOST_BENCHMARK
+// built on the host by Tools/benchmark, without the HAL
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "utils.h"
+#else
 #include "stm32f7xx_remote_io.h"
+#endif
 
 #define MAX_INT_DIGITS 8
 
+static const uint32_t powers_of_ten[UTILS_MAX_DECIMALS + 2] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+// the two digits of 00 to 99, so a value is written with a division per two digits
+static const char digit_pairs[200] = {
+  '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+  '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+  '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+  '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+  '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+  '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+  '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+  '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+  '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+  '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'};
+
+static inline uint8_t __utils_swar_count(uint32_t word);
+static inline uint32_t __utils_swar_value(uint32_t word, uint8_t n);
+static inline uint8_t __utils_read_digits(const char *ptr, uint64_t *value, uint8_t max_digits);
+static uint8_t __utils_read_long_digits(const char *ptr, uint64_t *value, uint8_t max_digits);
+static inline uint8_t __utils_read_integer(char *line, uint8_t *char_counter, bool *negative, uint64_t *magnitude);
+static inline uint8_t __utils_read_number(char *line, uint8_t *char_counter, bool *negative, uint64_t *intval,
+                                          uint32_t *frac, uint8_t decimals);
+
 // Extracts a floating point value from a string. The following code is based loosely on
 // the avr-libc strtod() function by Michael Stumpf and Dmitry Xmelkov and many freely
 // available conversion method examples, but has been highly optimized for Grbl. For known
@@ -82,4 +114,311 @@ uint8_t utils_read_float(char *line, uint8_t *char_counter, float *float_ptr)
   *char_counter = ptr - line - 1; // Set char_counter to next statement
 
   return(true);
-}
\ No newline at end of file
+}
+
+// The tokenizer below reads the arguments of a command without floating point. The digits
+// are scanned 4 at a time, SIMD within a register: a word of 4 characters is loaded at once,
+// the digits at its start are counted with a few logic operations, and converted to their
+// value with 2 multiplications instead of one per digit. Little-endian, the first character
+// is the low byte of the word.
+
+// Count the digits at the start of a word of 4 characters.
+static inline uint8_t __utils_swar_count(uint32_t word)
+{
+  // a byte is a digit if its high nibble is 3, and adding 6 does not carry into the high
+  // nibble; a carry out of a byte only disturbs the bytes after a non-digit
+  uint32_t nondigit = ((word & 0xF0F0F0F0U) | (((word + 0x06060606U) & 0xF0F0F0F0U) >> 4)) ^ 0x33333333U;
+
+  return (nondigit == 0) ? 4 : __builtin_ctz(nondigit) >> 3;
+}
+
+// Convert the first n digits, 1 ~ 4, of a word of 4 characters.
+static inline uint32_t __utils_swar_value(uint32_t word, uint8_t n)
+{
+  // move the digits to the top of the word, and fill the bottom with leading '0'
+  if (n < 4) { word = (word << (8 * (4 - n))) | (0x30303030U >> (8 * n)); }
+
+  word -= 0x30303030U;
+  word = word * 10 + (word >> 8);                           // 2 digits in bytes 0 and 2
+  return ((word & 0x00FF00FFU) * (1 + (100U << 16))) >> 16; // byte 0 * 100 + byte 2
+}
+
+// Read a run of digits. The value of the first max_digits digits is returned, saturated
+// above UINT32_MAX, and the length of the whole run. Up to 3 bytes past the run are loaded.
+static inline uint8_t __utils_read_digits(const char *ptr, uint64_t *value, uint8_t max_digits)
+{
+  uint32_t word;
+  memcpy(&word, ptr, sizeof(word)); // an unaligned load
+
+  // most arguments have up to 3 digits, which take a single word
+  uint8_t n = __utils_swar_count(word);
+  if (n < 4 && n <= max_digits) {
+    *value = (n > 0) ? __utils_swar_value(word, n) : 0;
+    return n;
+  }
+
+  return __utils_read_long_digits(ptr, value, max_digits);
+}
+
+// Read a run of digits which does not fit a word, or is cut by max_digits.
+static uint8_t __utils_read_long_digits(const char *ptr, uint64_t *value, uint8_t max_digits)
+{
+  uint32_t word, next;
+  memcpy(&word, ptr, sizeof(word));
+  memcpy(&next, ptr + 4, sizeof(next));
+
+  // up to 7 digits take 2 words without 64-bit arithmetic
+  uint8_t n = __utils_swar_count(word);
+  uint8_t n_next = __utils_swar_count(next);
+  if (n == 4 && n_next < 4 && 4 + n_next <= max_digits) {
+    uint32_t v = __utils_swar_value(word, 4);
+    *value = (n_next > 0) ? v * powers_of_ten[n_next] + __utils_swar_value(next, n_next) : v;
+    return 4 + n_next;
+  }
+
+  uint8_t take = (n < max_digits) ? n : max_digits;
+  uint64_t v = (take > 0) ? __utils_swar_value(word, take) : 0;
+  uint8_t ndigit = n;
+  max_digits -= take;
+
+  while (n == 4) {
+    memcpy(&word, ptr + ndigit, sizeof(word));
+
+    n = __utils_swar_count(word);
+    take = (n < max_digits) ? n : max_digits;
+    if (take > 0) {
+      v = v * powers_of_ten[take] + __utils_swar_value(word, take);
+      if (v > UINT32_MAX) { v = (uint64_t)UINT32_MAX + 1; }
+      max_digits -= take;
+    }
+    ndigit += n;
+  }
+
+  *value = v;
+  return ndigit;
+}
+
+// Read [sign] digits, a fraction is accepted only if it is 0, e.g. "5.0".
+static inline uint8_t __utils_read_integer(char *line, uint8_t *char_counter, bool *negative, uint64_t *magnitude)
+{
+  char *ptr = line + *char_counter;
+
+  *negative = (*ptr == '-');
+  if (*ptr == '-' || *ptr == '+') { ptr++; }
+
+  uint8_t ndigit = __utils_read_digits(ptr, magnitude, UINT8_MAX);
+  ptr += ndigit;
+
+  if (*ptr == '.') {
+    char *fraction = ++ptr;
+    while (*ptr == '0') { ptr++; }
+    if ((uint8_t)(*ptr - '0') <= 9) { return(false); }
+    ndigit += ptr - fraction;
+  }
+
+  if (!ndigit) { return(false); }
+
+  *char_counter = ptr - line;
+  return(true);
+}
+
+// Read [sign] digits [. digits], the fraction scaled by 10^decimals and rounded half away
+// from zero. The fraction may round up to 10^decimals.
+static inline uint8_t __utils_read_number(char *line, uint8_t *char_counter, bool *negative, uint64_t *intval,
+                                          uint32_t *frac, uint8_t decimals)
+{
+  char *ptr = line + *char_counter;
+  uint64_t fraction = 0;
+  uint8_t nfrac = 0;
+
+  *negative = (*ptr == '-');
+  if (*ptr == '-' || *ptr == '+') { ptr++; }
+
+  uint8_t ndigit = __utils_read_digits(ptr, intval, UINT8_MAX);
+  ptr += ndigit;
+
+  // one more digit than the decimals is read to round
+  if (*ptr == '.') {
+    nfrac = __utils_read_digits(ptr + 1, &fraction, decimals + 1);
+    ptr += 1 + nfrac;
+  }
+
+  if (!ndigit && !nfrac) { return(false); }
+
+  if (nfrac > decimals) {
+    *frac = ((uint32_t)fraction + 5) / 10;
+  } else {
+    *frac = (uint32_t)fraction * powers_of_ten[decimals - nfrac];
+  }
+
+  *char_counter = ptr - line;
+  return(true);
+}
+
+// Read an unsigned integer up to max.
+uint8_t utils_read_uint(char *line, uint8_t *char_counter, uint32_t *value, uint32_t max)
+{
+  uint8_t counter = *char_counter;
+  uint64_t magnitude;
+  bool isnegative;
+
+  if (!__utils_read_integer(line, &counter, &isnegative, &magnitude)) { return(false); }
+  if ((isnegative && magnitude != 0) || magnitude > max) { return(false); }
+
+  *value = (uint32_t)magnitude;
+  *char_counter = counter;
+  return(true);
+}
+
+// Read a signed integer from min to max.
+uint8_t utils_read_int(char *line, uint8_t *char_counter, int32_t *value, int32_t min, int32_t max)
+{
+  uint8_t counter = *char_counter;
+  uint64_t magnitude;
+  bool isnegative;
+
+  if (!__utils_read_integer(line, &counter, &isnegative, &magnitude)) { return(false); }
+
+  // the magnitude saturates just above 32 bits, so it fits a 64-bit signed value
+  int64_t v = isnegative ? -(int64_t)magnitude : (int64_t)magnitude;
+  if (v < min || v > max) { return(false); }
+
+  *value = (int32_t)v;
+  *char_counter = counter;
+  return(true);
+}
+
+// Read a decimal number as an integer count of 10^-decimals, e.g. "1.25" with 6 decimals
+// is 1250000. Up to UTILS_MAX_DECIMALS decimals, the value must fit 32 bits.
+uint8_t utils_read_decimal(char *line, uint8_t *char_counter, int32_t *value, uint8_t decimals)
+{
+  uint8_t counter = *char_counter;
+  uint64_t intval;
+  uint32_t frac;
+  bool isnegative;
+
+  if (decimals > UTILS_MAX_DECIMALS
+      || !__utils_read_number(line, &counter, &isnegative, &intval, &frac, decimals)) { return(false); }
+
+  int64_t v = (int64_t)(intval * powers_of_ten[decimals] + frac);
+  if (isnegative) { v = -v; }
+  if (v < INT32_MIN || v > INT32_MAX) { return(false); }
+
+  *value = (int32_t)v;
+  *char_counter = counter;
+  return(true);
+}
+
+// Read a decimal number as Q16.16, from -32768 to 32767.99998.
+uint8_t utils_read_q16(char *line, uint8_t *char_counter, int32_t *value)
+{
+  uint8_t counter = *char_counter;
+  uint64_t intval;
+  uint32_t frac;
+  bool isnegative;
+
+  // micro units are finer than 2^-16
+  if (!__utils_read_number(line, &counter, &isnegative, &intval, &frac, 6) || intval > 32768) { return(false); }
+
+  // frac * 2^16 / 10^6, by the reciprocal 2^48 / 10^6 rounded
+  uint64_t q = (intval << 16) + (((uint64_t)frac * 281474977U + (1U << 31)) >> 32);
+  if (q > (isnegative ? (uint64_t)INT32_MAX + 1 : INT32_MAX)) { return(false); }
+
+  *value = isnegative ? -(int32_t)(q - 1) - 1 : (int32_t)q;
+  *char_counter = counter;
+  return(true);
+}
+
+// Read a list of unsigned integers up to max separated by spaces, in one pass, until the
+// end of the line, size values, or anything else. Returns the number of values read.
+uint8_t utils_read_uint_list(char *line, uint8_t *char_counter, uint32_t *values, uint8_t size, uint32_t max)
+{
+  char *ptr = line + *char_counter;
+  uint8_t count = 0;
+
+  while (count < size) {
+    while (*ptr == ' ') { ptr++; }
+    if (*ptr == '\0') { break; }
+
+    // plain digits are converted right away, a sign or a fraction takes the long way
+    uint64_t value;
+    uint8_t n = __utils_read_digits(ptr, &value, UINT8_MAX);
+    if (n > 0 && ptr[n] != '.') {
+      if (value > max) { break; }
+      values[count++] = (uint32_t)value;
+      ptr += n;
+      continue;
+    }
+
+    uint8_t counter = ptr - line;
+    if (!utils_read_uint(line, &counter, &values[count], max)) { break; }
+    ptr = line + counter;
+    count++;
+  }
+
+  *char_counter = ptr - line;
+  return count;
+}
+
+// Writes an unsigned integer in decimal, zero padded to at least width digits, up to 10.
+// No terminator is written. Returns the number of characters.
+uint8_t utils_format_uint(char *buffer, uint32_t value, uint8_t width)
+{
+  uint8_t n = 1;
+  while (n < 10 && value >= powers_of_ten[n]) { n++; }
+  if (n < width) { n = width; }
+
+  // two digits at a time from the end
+  char *ptr = buffer + n;
+  while (value >= 100) {
+    uint32_t pair = value % 100;
+    value /= 100;
+    ptr -= 2;
+    memcpy(ptr, &digit_pairs[2 * pair], 2);
+  }
+  if (value >= 10) {
+    ptr -= 2;
+    memcpy(ptr, &digit_pairs[2 * value], 2);
+  } else {
+    *--ptr = '0' + value;
+  }
+  while (ptr > buffer) { *--ptr = '0'; }
+
+  return(n);
+}
+
+// Writes a fixed point value in units of 10^-decimals with all its decimals, e.g. 1650250
+// with 6 decimals as "1.650250". No terminator is written. Returns the number of characters.
+uint8_t utils_format_decimal(char *buffer, int32_t value, uint8_t decimals)
+{
+  uint32_t magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+  uint8_t n = 0;
+
+  if (value < 0) { buffer[n++] = '-'; }
+  if (decimals == 0 || decimals > UTILS_MAX_DECIMALS) {
+    return(n + utils_format_uint(buffer + n, magnitude, 1));
+  }
+
+  n += utils_format_uint(buffer + n, magnitude / powers_of_ten[decimals], 1);
+  buffer[n++] = '.';
+  n += utils_format_uint(buffer + n, magnitude % powers_of_ten[decimals], decimals);
+  return(n);
+}
+
+#ifndef UTILS_HOST_BENCHMARK
+// Get the clock frequency of a timer, which runs at twice the frequency of its APB bus
+// unless the bus is not divided from HCLK.
+uint32_t utils_get_timer_clock(TIM_TypeDef *instance)
+{
+  RCC_ClkInitTypeDef clkconfig;
+  uint32_t pFLatency;
+
+  HAL_RCC_GetClockConfig(&clkconfig, &pFLatency);
+
+  if ((uint32_t)instance >= APB2PERIPH_BASE) {
+    return (clkconfig.APB2CLKDivider == RCC_HCLK_DIV1) ? HAL_RCC_GetPCLK2Freq() : 2U * HAL_RCC_GetPCLK2Freq();
+  }
+
+  return (clkconfig.APB1CLKDivider == RCC_HCLK_DIV1) ? HAL_RCC_GetPCLK1Freq() : 2U * HAL_RCC_GetPCLK1Freq();
+}
+#endif
@@ -1,13 +1,16 @@
 #include "ws28xx_pwm.h"
+#include "utils.h"
 
 // buffer for the PWM data
-static uint32_t ws28xx_pwm_buffer[WS28XX_PWM_BUFFER_SIZE] = {0};
+static uint32_t ws28xx_pwm_buffer[WS28XX_PWM_BUFFER_SIZE] UTILS_DMA_BUFFER = {0};
 
 // color data for each LED
 static ws_color_t ws28xx_pwm_color[NUMBER_OF_LEDS] = {0};
 
 static TIM_HandleTypeDef *htim;
 static uint32_t tim_channel;
+static volatile uint16_t led_count_requested = NUMBER_OF_LEDS; // number of LEDs to take at the next update
+static volatile uint16_t led_count = NUMBER_OF_LEDS;           // number of LEDs of the update in progress
 volatile uint16_t num_led_buffer_updated = 0; // number of LED whose PWM buffer has been updated
 volatile uint16_t flag_operation = 0;         // flag for the operation of the LED strip
 
@@ -52,10 +55,32 @@ void ws28xx_pwm_init(TIM_HandleTypeDef *_htim, uint32_t _tim_channel)
     num_isr_for_reset = 1 + (NUM_PWM_CYCLES_RESET / (WS28XX_PWM_BUFFER_SIZE / 2)) + (NUM_PWM_CYCLES_RESET % (WS28XX_PWM_BUFFER_SIZE / 2) > 0);
 }
 
+/**
+ * @brief Set the number of LEDs of the strip, 1 ~ NUMBER_OF_LEDS.
+ * @note An update in progress carries on with the previous number, the next one
+ *       takes the new number.
+ */
+HAL_StatusTypeDef ws28xx_pwm_set_led_count(uint16_t count)
+{
+    if (count < 1 || count > NUMBER_OF_LEDS)
+    {
+        return HAL_ERROR;
+    }
+
+    led_count_requested = count;
+
+    return HAL_OK;
+}
+
+uint16_t ws28xx_pwm_get_led_count(void)
+{
+    return led_count_requested;
+}
+
 HAL_StatusTypeDef ws28xx_pwm_set_color(uint8_t r, uint8_t g, uint8_t b, uint16_t led)
 {
     // check if the LED index is valid
-    if (led >= NUMBER_OF_LEDS)
+    if (led >= led_count_requested)
     {
         return HAL_ERROR;
     }
@@ -89,6 +114,9 @@ void ws28xx_pwm_update(void)
         return;
     }
 
+    // the number of LEDs only changes between updates
+    led_count = led_count_requested;
+
     // update the buffer for the PWM data
     __ws28xx_pwm_update_buffer(0, 2 * NUMBER_OF_LEDS_UPDATED_PER_ISR);
 
@@ -102,7 +130,7 @@ void ws28xx_pwm_update(void)
     flag_operation |= FLAG_OPERATION_UPDATING;
 }
 
-void ws28xx_pwm_dma_half_complete_callback(void)
+UTILS_ITCM_CODE void ws28xx_pwm_dma_half_complete_callback(void)
 {
     uint16_t _flag_operation = flag_operation;
 
@@ -149,14 +177,14 @@ void ws28xx_pwm_dma_half_complete_callback(void)
     num_led_buffer_updated += NUMBER_OF_LEDS_UPDATED_PER_ISR;
 
     // check if all the LED buffers have been updated
-    if (num_led_buffer_updated >= NUMBER_OF_LEDS)
+    if (num_led_buffer_updated >= led_count)
     {
         // set the flag for the operation of the LED strip
         flag_operation |= FLAG_OPERATION_RESET_SIGNAL;
     }
 }
 
-void ws28xx_pwm_dma_complete_callback(void)
+UTILS_ITCM_CODE void ws28xx_pwm_dma_complete_callback(void)
 {
     uint16_t _flag_operation = flag_operation;
 
@@ -204,7 +232,7 @@ void ws28xx_pwm_dma_complete_callback(void)
     num_led_buffer_updated += NUMBER_OF_LEDS_UPDATED_PER_ISR;
 
     // check if all the LED buffers have been updated
-    if (num_led_buffer_updated >= NUMBER_OF_LEDS)
+    if (num_led_buffer_updated >= led_count)
     {
         // set the flag for the operation of the LED strip
         flag_operation |= FLAG_OPERATION_RESET_SIGNAL;
@@ -218,7 +246,7 @@ void __ws28xx_pwm_dma_stop(void)
 }
 
 /** */
-void __ws28xx_pwm_update_buffer(uint16_t led, uint16_t length)
+UTILS_ITCM_CODE void __ws28xx_pwm_update_buffer(uint16_t led, uint16_t length)
 {
     // assert led index is valid
     ASSERT(led < NUMBER_OF_LEDS);
@@ -232,8 +260,8 @@ void __ws28xx_pwm_update_buffer(uint16_t led, uint16_t length)
     // set the PWM data for the LED
     for (uint16_t i = led; i < end_index; i++)
     {
-        // get the color of the LED
-        ws_color_t color = ws28xx_pwm_color[i];
+        // get the color of the LED, the ones past the strip are off
+        ws_color_t color = (i < led_count) ? ws28xx_pwm_color[i] : (ws_color_t){0};
 
         // calculate the start index for the PWM data
         uint16_t start_index = i * len_data % WS28XX_PWM_BUFFER_SIZE;
@@ -255,7 +283,7 @@ void __ws28xx_pwm_update_buffer(uint16_t led, uint16_t length)
     }
 }
 
-void __ws28xx_pwm_reset(void)
+UTILS_ITCM_CODE void __ws28xx_pwm_reset(void)
 {
     uint16_t len_data = 8 * NUMBER_OF_BASIC_COLORS * NUMBER_OF_LEDS_UPDATED_PER_ISR;
     uint16_t start_index = count_isr_for_reset * len_data % WS28XX_PWM_BUFFER_SIZE;
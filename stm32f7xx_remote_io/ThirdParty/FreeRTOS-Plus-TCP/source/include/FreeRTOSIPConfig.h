@@ -320,6 +320,13 @@ extern void vLoggingPrintf( const char * pcFormatString,
 
 #define ipconfigETHERNET_DRIVER_FILTERS_PACKETS    ( 1 )
 
+/* While the link is down the IP task retries to initialise the interface after
+ * ipINITIALISATION_RETRY_DELAY, 3 s by default, and the driver looks at the PHY
+ * every ipconfigPHY_LS_LOW_CHECK_TIME_MS, 1 s by default. Both are shortened so the
+ * server listens within a few hundred ms of the cable being plugged in. */
+#define ipINITIALISATION_RETRY_DELAY               ( pdMS_TO_TICKS( 100U ) )
+#define ipconfigPHY_LS_LOW_CHECK_TIME_MS           ( 100 )
+
 #endif /* FREERTOS_IP_CONFIG_H */
 
 /* TX/RX Zero-Copy function */
@@ -65,7 +65,13 @@
 #define configTICK_RATE_HZ                       ((TickType_t)1000)
 #define configMAX_PRIORITIES                     ( 56 )
 #define configMINIMAL_STACK_SIZE                 ((uint16_t)128)
-#define configTOTAL_HEAP_SIZE                    ((size_t) (30 * 1536)) // default: 15360
+/* The heap takes the 128 KB of the DTCM but the 8 KB left for its other data, the
+   MSP stack and the newlib heap. Worst case with every client connected: task
+   stacks and TCBs 20 KB, 25 network buffers 39 KB, TCP stream buffers 37 KB, 10
+   sockets 6 KB, TCP window segments 4 KB, queues, stream buffer and mutexes 4 KB,
+   110 KB in all. The link fails if the DTCM overflows. */
+#define configTOTAL_HEAP_SIZE                    ((size_t) (120 * 1024)) // default: 15360
+#define configAPPLICATION_ALLOCATED_HEAP         1 // ucHeap is in freertos.c, in the DTCM
 #define configMAX_TASK_NAME_LEN                  ( 16 )
 #define configUSE_TRACE_FACILITY                 1
 #define configUSE_16_BIT_TICKS                   0
@@ -0,0 +1,186 @@
+/**
+ * @brief Host micro-benchmark of the reply formatter against snprintf()
+ * @note Not part of the firmware, the project builds Core, Drivers and ThirdParty only.
+ *       Build and run it on a host from this directory:
+ *
+ *       gcc -O2 -DUTILS_HOST_BENCHMARK -I../../Core/Inc reply_benchmark.c ../../Core/Src/utils.c -o reply_benchmark
+ *       ./reply_benchmark
+ *
+ *       Every case formats the values of a typical reply, once the way the API did
+ *       with snprintf() and once with utils_format_uint() and utils_format_decimal(),
+ *       and checks both write the same text. The formatter is also checked against
+ *       snprintf() over a sweep of values. The host libc is glibc, not newlib, whose
+ *       vfprintf is slower still and takes far more stack than the formatter.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "utils.h"
+
+#define ITERATIONS 200000
+#define REPEATS 20 // the fastest of the repeats is taken, the host is shared
+#define MAX_VALUES 32
+
+typedef struct
+{
+    const char *name;
+    uint8_t decimals; // 0 for integers
+    uint8_t count;
+    int32_t values[MAX_VALUES];
+} benchmark_case_t;
+
+static const benchmark_case_t cases[] = {
+    {"pin", 0, 2, {7, 1}},
+    {"rgb", 0, 5, {1, 4, 127, 23, 255}},
+    {"serial stats", 0, 10, {1048576, 524288, 4096, 0, 0, 81234, 12, 3, 2048, 1}},
+    {"modbus image", 0, 17, {40001, 0, 1, 12, 123, 1234, 12345, 65535, 0, 99, 100, 999, 1000, 9999, 10000, 42, 7}},
+    {"volts", 6, 2, {100, 1650250}},
+    {"analog inputs", 6, 8, {1650250, 3299194, 0, 12, -1500, 2500000, 825125, 1}},
+};
+
+static char buffer[MAX_VALUES * (UTILS_FORMAT_SIZE + 1) + 1];
+
+// keep the results alive so the loops are not optimized away
+static volatile uint32_t sink;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// The values as the API replied them with snprintf()
+static uint16_t format_snprintf(const benchmark_case_t *bc, char *str)
+{
+    uint16_t len = 0;
+
+    for (uint8_t i = 0; i < bc->count; i++)
+    {
+        int32_t value = bc->values[i];
+
+        if (bc->decimals == 0)
+        {
+            len += snprintf(str + len, sizeof(buffer) - len, " %lu", (unsigned long)(uint32_t)value);
+        }
+        else
+        {
+            uint32_t magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+            len += snprintf(str + len, sizeof(buffer) - len, " %s%lu.%06lu", (value < 0) ? "-" : "",
+                            (unsigned long)(magnitude / 1000000U), (unsigned long)(magnitude % 1000000U));
+        }
+    }
+
+    return len;
+}
+
+// The same values written by the formatter
+static uint16_t format_utils(const benchmark_case_t *bc, char *str)
+{
+    uint16_t len = 0;
+
+    for (uint8_t i = 0; i < bc->count; i++)
+    {
+        str[len++] = ' ';
+        if (bc->decimals == 0)
+        {
+            len += utils_format_uint(str + len, bc->values[i], 1);
+        }
+        else
+        {
+            len += utils_format_decimal(str + len, bc->values[i], bc->decimals);
+        }
+    }
+    str[len] = '\0';
+
+    return len;
+}
+
+// Compare the formatter with snprintf() over a sweep of values, every digit count and sign
+static int check_sweep(void)
+{
+    char expected[32], actual[32];
+    int failures = 0;
+
+    for (uint64_t v = 0; v <= UINT32_MAX; v = (v < 100000) ? v + 1 : v * 3 / 2 + 7)
+    {
+        uint8_t len = utils_format_uint(actual, (uint32_t)v, 1);
+        actual[len] = '\0';
+        snprintf(expected, sizeof(expected), "%lu", (unsigned long)v);
+        failures += (strcmp(expected, actual) != 0);
+
+        len = utils_format_uint(actual, (uint32_t)v, 6);
+        actual[len] = '\0';
+        snprintf(expected, sizeof(expected), "%06lu", (unsigned long)v);
+        failures += (strcmp(expected, actual) != 0);
+
+        for (int sign = -1; sign <= 1 && v <= INT32_MAX; sign += 2)
+        {
+            int32_t value = (int32_t)(sign * (int64_t)v);
+            len = utils_format_decimal(actual, value, 6);
+            actual[len] = '\0';
+            snprintf(expected, sizeof(expected), "%s%lu.%06lu", (value < 0) ? "-" : "",
+                     (unsigned long)(v / 1000000U), (unsigned long)(v % 1000000U));
+            failures += (strcmp(expected, actual) != 0);
+        }
+    }
+
+    uint8_t len = utils_format_decimal(actual, INT32_MIN, 6);
+    actual[len] = '\0';
+    failures += (strcmp("-2147.483648", actual) != 0);
+
+    if (failures)
+    {
+        printf("sweep: %d values differ\n", failures);
+    }
+    return failures;
+}
+
+int main(void)
+{
+    char expected[sizeof(buffer)];
+    int failures = check_sweep();
+
+    printf("%-14s %12s %12s %8s\n", "case", "snprintf ns", "formatter ns", "speedup");
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        const benchmark_case_t *bc = &cases[c];
+
+        format_snprintf(bc, expected);
+        format_utils(bc, buffer);
+        if (strcmp(expected, buffer) != 0)
+        {
+            printf("%-14s results differ\n", bc->name);
+            failures++;
+            continue;
+        }
+
+        double snprintf_ns = 1e9, utils_ns = 1e9;
+        for (uint32_t r = 0; r < REPEATS; r++)
+        {
+            double start = now_ns();
+            for (uint32_t i = 0; i < ITERATIONS; i++)
+            {
+                sink += format_snprintf(bc, buffer);
+            }
+            double ns = (now_ns() - start) / ITERATIONS;
+            snprintf_ns = (ns < snprintf_ns) ? ns : snprintf_ns;
+
+            start = now_ns();
+            for (uint32_t i = 0; i < ITERATIONS; i++)
+            {
+                sink += format_utils(bc, buffer);
+            }
+            ns = (now_ns() - start) / ITERATIONS;
+            utils_ns = (ns < utils_ns) ? ns : utils_ns;
+        }
+
+        printf("%-14s %12.1f %12.1f %7.2fx\n", bc->name, snprintf_ns, utils_ns, snprintf_ns / utils_ns);
+    }
+
+    return failures;
+}
@@ -0,0 +1,155 @@
+/**
+ * @brief Host micro-benchmark of the command tokenizer against utils_read_float()
+ * @note Not part of the firmware, the project builds Core, Drivers and ThirdParty only.
+ *       Build and run it on a little-endian host from this directory:
+ *
+ *       gcc -O2 -DUTILS_HOST_BENCHMARK -I../../Core/Inc tokenizer_benchmark.c ../../Core/Src/utils.c -o tokenizer_benchmark
+ *       ./tokenizer_benchmark
+ *
+ *       Every case parses the arguments of a typical command line, once the way the API
+ *       did with utils_read_float() and once with the tokenizer, and checks both agree.
+ *       The host has a fast FPU, so the gap on the target, where the tasks run without
+ *       FPU context, is wider than shown.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "utils.h"
+
+#define ITERATIONS 200000
+#define REPEATS 20 // the fastest of the repeats is taken, the host is shared
+#define MAX_VALUES 64
+
+typedef struct
+{
+    const char *name;
+    const char *line;
+    uint8_t decimals; // 0 for integers
+} benchmark_case_t;
+
+static const benchmark_case_t cases[] = {
+    {"pin", "7", 0},
+    {"rgb", "1 19 255 255 0", 0},
+    {"modbus poll", "0 1 3 40001 125 512", 0},
+    {"table codes", "0 512 1024 1536 2048 2560 3072 3584 4095 3584 3072 2560 2048 1536 1024 512 0", 0},
+    {"volts", "100 1.650250", 6},
+    {"waveform", "100 1 50.5 1.25 1.65", 6},
+};
+
+// line buffer with the padding the tokenizer may read past the terminator
+static char line[128 + UTILS_READ_PADDING];
+
+// keep the results alive so the loops are not optimized away
+static volatile uint32_t sink;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void skip_spaces(uint8_t *char_counter)
+{
+    while (line[*char_counter] == ' ')
+    {
+        (*char_counter)++;
+    }
+}
+
+// The arguments as integers or in units of 10^-decimals, read by utils_read_float()
+static uint8_t parse_float(uint8_t decimals, int32_t *values)
+{
+    uint8_t char_counter = 0;
+    uint8_t count = 0;
+    float fval;
+
+    for (skip_spaces(&char_counter); line[char_counter] != '\0'; skip_spaces(&char_counter))
+    {
+        if (!utils_read_float(line, &char_counter, &fval))
+        {
+            break;
+        }
+
+        // the scaling and rounding the handlers did after reading a float
+        float scaled = (decimals == 0) ? fval : fval * (decimals == 6 ? 1000000.0f : 1000.0f);
+        values[count++] = (int32_t)(scaled + ((scaled < 0) ? -0.5f : 0.5f));
+    }
+
+    return count;
+}
+
+// The same arguments read by the tokenizer
+static uint8_t parse_tokenizer(uint8_t decimals, int32_t *values)
+{
+    uint8_t char_counter = 0;
+    uint8_t count = 0;
+
+    if (decimals == 0)
+    {
+        return utils_read_uint_list(line, &char_counter, (uint32_t *)values, MAX_VALUES, UINT32_MAX);
+    }
+
+    for (skip_spaces(&char_counter); line[char_counter] != '\0'; skip_spaces(&char_counter))
+    {
+        if (!utils_read_decimal(line, &char_counter, &values[count], decimals))
+        {
+            break;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+int main(void)
+{
+    int32_t expected[MAX_VALUES], actual[MAX_VALUES];
+    int failures = 0;
+
+    printf("%-14s %12s %12s %8s\n", "case", "float ns", "tokenizer ns", "speedup");
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        const benchmark_case_t *bc = &cases[c];
+
+        memset(line, 0, sizeof(line));
+        strcpy(line, bc->line);
+
+        uint8_t n_float = parse_float(bc->decimals, expected);
+        uint8_t n_tokenizer = parse_tokenizer(bc->decimals, actual);
+        if (n_float != n_tokenizer || memcmp(expected, actual, n_float * sizeof(int32_t)) != 0)
+        {
+            printf("%-14s results differ\n", bc->name);
+            failures++;
+            continue;
+        }
+
+        double float_ns = 1e9, tokenizer_ns = 1e9;
+        for (uint32_t r = 0; r < REPEATS; r++)
+        {
+            double start = now_ns();
+            for (uint32_t i = 0; i < ITERATIONS; i++)
+            {
+                sink += parse_float(bc->decimals, expected);
+            }
+            double ns = (now_ns() - start) / ITERATIONS;
+            float_ns = (ns < float_ns) ? ns : float_ns;
+
+            start = now_ns();
+            for (uint32_t i = 0; i < ITERATIONS; i++)
+            {
+                sink += parse_tokenizer(bc->decimals, actual);
+            }
+            ns = (now_ns() - start) / ITERATIONS;
+            tokenizer_ns = (ns < tokenizer_ns) ? ns : tokenizer_ns;
+        }
+
+        printf("%-14s %12.1f %12.1f %7.2fx\n", bc->name, float_ns, tokenizer_ns, float_ns / tokenizer_ns);
+    }
+
+    return failures;
+}
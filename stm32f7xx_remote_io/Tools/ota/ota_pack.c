@@ -0,0 +1,483 @@
+/**
+ * @brief Host tool making the payload of an over the air update
+ * @note Not part of the firmware, the project builds Core, Drivers and ThirdParty only.
+ *       Build it on a host from this directory:
+ *
+ *       gcc -O2 -I../../Core/Inc ota_pack.c -o ota_pack
+ *       ./ota_pack firmware.bin update.bin                 raw
+ *       ./ota_pack -c firmware.bin update.bin              compressed
+ *       ./ota_pack -d running.bin firmware.bin update.bin  delta against the running firmware
+ *
+ *       update.bin is the header and the payload, sent as it is to the update socket.
+ *       The bank of each firmware is taken from its reset vector. The words of the
+ *       running firmware pointing into its bank are relocated to the other bank, the
+ *       way the device reads them, before they are matched. The payload is decoded
+ *       back the way the device does and checked against the firmware before it is
+ *       written.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ota.h"
+
+#define BANK_MASK 0xFFF00000 // the banks are 1 MB apart
+#define HASH_BITS 16
+#define MAX_CHAIN 256 // candidates tried per position and image
+
+typedef struct
+{
+    uint8_t *data;
+    uint32_t length;
+    uint32_t size; // bytes allocated, for the payload only
+} buffer_t;
+
+// hash chains of the positions of an image, by their first OTA_MIN_MATCH bytes
+typedef struct
+{
+    int32_t head[1 << HASH_BITS];
+    int32_t *prev;
+} chain_t;
+
+// CRC-32/MPEG-2, the way the CRC peripheral computes it
+static uint32_t crc_mpeg2(const uint8_t *data, uint32_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        crc ^= (uint32_t)data[i] << 24;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+static bool read_file(const char *path, buffer_t *buffer)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    buffer->length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // padded with the erased value to a whole word, as the image is in flash
+    buffer->data = malloc(buffer->length + 4);
+    memset(buffer->data + buffer->length, 0xFF, 4);
+    if (fread(buffer->data, 1, buffer->length, file) != buffer->length)
+    {
+        perror(path);
+        fclose(file);
+        return false;
+    }
+
+    fclose(file);
+    return true;
+}
+
+static uint32_t get_word(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static void put_word(uint8_t *data, uint32_t word)
+{
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        data[i] = word >> (8 * i);
+    }
+}
+
+// Relocate the words of the running image pointing into its bank, as __ota_running() does
+static void relocate(buffer_t *running, uint32_t running_base, uint32_t base)
+{
+    for (uint32_t i = 0; i < running->length; i += 4)
+    {
+        uint32_t word = get_word(running->data + i);
+        if (word >= running_base && word < running_base + OTA_SLOT_SIZE)
+        {
+            put_word(running->data + i, word - running_base + base);
+        }
+    }
+}
+
+static uint32_t hash(const uint8_t *data)
+{
+    return (get_word(data) * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static void chain_init(chain_t *chain, uint32_t length)
+{
+    memset(chain->head, -1, sizeof(chain->head));
+    chain->prev = malloc(sizeof(int32_t) * (length + 1));
+}
+
+static void chain_insert(chain_t *chain, const buffer_t *buffer, uint32_t position)
+{
+    if (position + OTA_MIN_MATCH <= buffer->length)
+    {
+        uint32_t h = hash(buffer->data + position);
+        chain->prev[position] = chain->head[h];
+        chain->head[h] = position;
+    }
+}
+
+// Longest match of the image at position among the positions of a chain
+static uint32_t find_match(const chain_t *chain, const buffer_t *source, const buffer_t *image, uint32_t position,
+                           uint32_t *found)
+{
+    uint32_t best = 0, limit = image->length - position;
+    int32_t candidate = chain->head[hash(image->data + position)];
+
+    for (uint32_t tries = 0; candidate >= 0 && tries < MAX_CHAIN; tries++, candidate = chain->prev[candidate])
+    {
+        // a match in the image itself may overlap the bytes it produces
+        uint32_t max = (source == image) ? limit : source->length - candidate;
+        uint32_t length = 0;
+
+        max = (max < limit) ? max : limit;
+        while (length < max && source->data[candidate + length] == image->data[position + length])
+        {
+            length++;
+        }
+        if (length > best)
+        {
+            best = length;
+            *found = candidate;
+        }
+    }
+
+    return best;
+}
+
+// Make room for count more bytes of the payload
+static void reserve(buffer_t *out, uint32_t count)
+{
+    if (out->length + count > out->size)
+    {
+        out->size = (out->length + count) * 2;
+        out->data = realloc(out->data, out->size);
+    }
+}
+
+static void put_byte(buffer_t *out, uint8_t byte)
+{
+    reserve(out, 1);
+    out->data[out->length++] = byte;
+}
+
+static void put_varint(buffer_t *out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        put_byte(out, (value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    put_byte(out, value);
+}
+
+static void put_sequence(buffer_t *out, const uint8_t *literals, uint32_t count, uint32_t match, uint32_t reference)
+{
+    uint32_t code = (match == 0) ? 0 : match - (OTA_MIN_MATCH - 1);
+
+    put_byte(out, ((count < 15 ? count : 15) << 4) | (code < 15 ? code : 15));
+    if (count >= 15)
+    {
+        put_varint(out, count - 15);
+    }
+    reserve(out, count);
+    memcpy(out->data + out->length, literals, count);
+    out->length += count;
+
+    if (match != 0)
+    {
+        if (code >= 15)
+        {
+            put_varint(out, code - 15);
+        }
+        put_varint(out, reference);
+    }
+}
+
+static uint32_t varint_size(uint32_t value)
+{
+    uint32_t size = 1;
+
+    for (; value >= 0x80; value >>= 7)
+    {
+        size++;
+    }
+    return size;
+}
+
+// Bytes a match adds to the payload, its token included, which the literals alone would share
+static uint32_t match_cost(uint32_t match, uint32_t reference)
+{
+    uint32_t code = match - (OTA_MIN_MATCH - 1);
+
+    return 1 + ((code >= 15) ? varint_size(code - 15) : 0) + varint_size(reference);
+}
+
+// Greedy LZ of the image over itself, and over the running image for a delta. A match
+// is taken only if it is shorter than the literals it replaces, so the payload is never
+// much longer than the image, e.g. a far match of 4 bytes is left as literals.
+static void encode(const buffer_t *image, const buffer_t *running, buffer_t *out)
+{
+    static chain_t chain, running_chain;
+    uint32_t literal = 0, position = 0;
+
+    chain_init(&chain, image->length);
+    if (running != NULL)
+    {
+        chain_init(&running_chain, running->length);
+        for (uint32_t i = running->length; i-- > 0;)
+        {
+            chain_insert(&running_chain, running, i);
+        }
+    }
+
+    while (position < image->length)
+    {
+        uint32_t length = 0, found = 0, reference = 0;
+        int32_t gain = 0;
+
+        if (position + OTA_MIN_MATCH <= image->length)
+        {
+            length = find_match(&chain, image, image, position, &found);
+            reference = (position - found) << 1;
+            if (length >= OTA_MIN_MATCH)
+            {
+                gain = (int32_t)length - match_cost(length, reference);
+            }
+
+            uint32_t running_found = 0, running_length = 0;
+            if (running != NULL)
+            {
+                running_length = find_match(&running_chain, running, image, position, &running_found);
+            }
+            if (running_length >= OTA_MIN_MATCH)
+            {
+                int64_t offset = (int64_t)running_found - position;
+                uint32_t running_reference = ((uint32_t)((offset << 1) ^ (offset >> 63)) << 1) | 1;
+                int32_t running_gain = (int32_t)running_length - match_cost(running_length, running_reference);
+
+                if (running_gain > gain)
+                {
+                    length = running_length;
+                    reference = running_reference;
+                    gain = running_gain;
+                }
+            }
+        }
+
+        if (gain <= 0)
+        {
+            chain_insert(&chain, image, position++);
+            continue;
+        }
+
+        put_sequence(out, image->data + literal, position - literal, length, reference);
+        for (uint32_t end = position + length; position < end; position++)
+        {
+            chain_insert(&chain, image, position);
+        }
+        literal = position;
+    }
+
+    if (literal < position || image->length == 0)
+    {
+        put_sequence(out, image->data + literal, position - literal, 0, 0);
+    }
+}
+
+static bool get_varint(const buffer_t *in, uint32_t *head, uint32_t *value)
+{
+    *value = 0;
+    for (uint8_t shift = 0; shift < 32 && *head < in->length; shift += 7)
+    {
+        uint8_t byte = in->data[(*head)++];
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decode the payload the way __ota_decode() does
+static bool decode(const buffer_t *in, const buffer_t *running, buffer_t *image, uint32_t length)
+{
+    uint32_t head = 0, extra, reference, source;
+
+    image->length = 0;
+    while (image->length < length)
+    {
+        if (head >= in->length)
+        {
+            return false;
+        }
+
+        uint8_t token = in->data[head++];
+        uint32_t literals = token >> 4, match = token & 0x0F;
+
+        if (literals == 15)
+        {
+            if (!get_varint(in, &head, &extra))
+            {
+                return false;
+            }
+            literals += extra;
+        }
+        if (literals > in->length - head || literals > length - image->length)
+        {
+            return false;
+        }
+        memcpy(image->data + image->length, in->data + head, literals);
+        image->length += literals;
+        head += literals;
+
+        if (match == 0)
+        {
+            continue;
+        }
+        match += OTA_MIN_MATCH - 1;
+        if (match == 15 + OTA_MIN_MATCH - 1)
+        {
+            if (!get_varint(in, &head, &extra))
+            {
+                return false;
+            }
+            match += extra;
+        }
+        if (!get_varint(in, &head, &reference) || match > length - image->length)
+        {
+            return false;
+        }
+
+        if (reference & 1)
+        {
+            reference >>= 1;
+            source = image->length + ((reference & 1) ? ~(reference >> 1) : (reference >> 1));
+            if (running == NULL || source >= running->length || match > running->length - source)
+            {
+                return false;
+            }
+            memcpy(image->data + image->length, running->data + source, match);
+            image->length += match;
+        }
+        else
+        {
+            reference >>= 1;
+            if (reference == 0 || reference > image->length)
+            {
+                return false;
+            }
+            for (uint32_t i = 0; i < match; i++, image->length++)
+            {
+                image->data[image->length] = image->data[image->length - reference];
+            }
+        }
+    }
+
+    return head == in->length;
+}
+
+int main(int argc, char **argv)
+{
+    buffer_t image, running = {NULL, 0, 0}, payload, check;
+    ota_header_t header = {OTA_MAGIC, 0, 0, OTA_ENCODING_RAW, 0, 0};
+    int arg = 1;
+
+    if (arg + 1 < argc && strcmp(argv[arg], "-c") == 0)
+    {
+        header.encoding = OTA_ENCODING_COMPRESSED;
+        arg++;
+    }
+    else if (arg + 2 < argc && strcmp(argv[arg], "-d") == 0)
+    {
+        header.encoding = OTA_ENCODING_DELTA;
+        if (!read_file(argv[arg + 1], &running))
+        {
+            return 1;
+        }
+        arg += 2;
+    }
+    if (arg + 2 != argc)
+    {
+        fprintf(stderr, "usage: %s [-c | -d running.bin] firmware.bin update.bin\n", argv[0]);
+        return 1;
+    }
+    if (!read_file(argv[arg], &image))
+    {
+        return 1;
+    }
+    if (image.length < 8 || image.length > OTA_IMAGE_MAX_SIZE)
+    {
+        fprintf(stderr, "%s: %u bytes do not fit the slot\n", argv[arg], image.length);
+        return 1;
+    }
+
+    header.length = image.length;
+    header.crc = crc_mpeg2(image.data, image.length);
+
+    uint32_t base = get_word(image.data + 4) & BANK_MASK;
+    if (running.data != NULL)
+    {
+        uint32_t running_base = (running.length >= 8) ? get_word(running.data + 4) & BANK_MASK : 0;
+
+        if (running_base == base || running.length > OTA_IMAGE_MAX_SIZE)
+        {
+            fprintf(stderr, "%s: not a firmware of the other bank\n", argv[arg - 1]);
+            return 1;
+        }
+        header.base_length = running.length;
+        header.base_crc = crc_mpeg2(running.data, running.length);
+        relocate(&running, running_base, base);
+    }
+
+    // the payload grows as it is encoded, it is rarely longer than the image
+    payload.size = image.length + 16;
+    payload.data = malloc(payload.size);
+    payload.length = 0;
+    if (header.encoding == OTA_ENCODING_RAW)
+    {
+        memcpy(payload.data, image.data, image.length);
+        payload.length = image.length;
+    }
+    else
+    {
+        encode(&image, running.data ? &running : NULL, &payload);
+
+        check.data = malloc(image.length);
+        if (!decode(&payload, running.data ? &running : NULL, &check, image.length)
+            || memcmp(check.data, image.data, image.length) != 0)
+        {
+            fprintf(stderr, "the payload does not decode to the firmware\n");
+            return 1;
+        }
+    }
+
+    FILE *file = fopen(argv[arg + 1], "wb");
+    if (file == NULL || fwrite(&header, sizeof(header), 1, file) != 1
+        || fwrite(payload.data, 1, payload.length, file) != payload.length)
+    {
+        perror(argv[arg + 1]);
+        return 1;
+    }
+    fclose(file);
+
+    printf("firmware %u bytes for bank %u, payload %u bytes, %.2fx\n", image.length,
+           (base == OTA_BANK_2_ADDRESS) ? 2 : 1, payload.length, (double)image.length / payload.length);
+    return 0;
+}